@@ -0,0 +1,70 @@
+#ifndef SLAMTORCH_ALIGNED_BUFFER_H
+#define SLAMTORCH_ALIGNED_BUFFER_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Fixed-size array of trivial values aligned for NEON/AVX loads. Used for
+// structure-of-arrays storage that hot loops stream through.
+template <typename T>
+class AlignedBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "AlignedBuffer holds trivial values only");
+
+public:
+    static constexpr size_t kAlignment = 64;
+
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t size) { Allocate(size); }
+    ~AlignedBuffer() { Free(); }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+    AlignedBuffer(AlignedBuffer&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {
+    }
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        if (this != &other) {
+            Free();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    // Replaces the contents with size zeroed values.
+    void Allocate(size_t size) {
+        Free();
+        if (size == 0) return;
+        data_ = static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(kAlignment)));
+        size_ = size;
+        Zero();
+    }
+    void Zero() {
+        if (data_) {
+            memset(data_, 0, size_ * sizeof(T));
+        }
+    }
+
+    T* Data() { return data_; }
+    const T* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+private:
+    void Free() {
+        if (data_) {
+            ::operator delete(data_, std::align_val_t(kAlignment));
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif // SLAMTORCH_ALIGNED_BUFFER_H
@@ -1,4 +1,9 @@
 #include "DebugHud.h"
+#include <cstdio>
+
+namespace {
+constexpr int64_t kStageWindowNs = 1000000000;
+}
 
 void DebugHud::Update(const ArCoreSlam* slam,
                       int point_count,
@@ -25,7 +30,8 @@ void DebugHud::Update(const ArCoreSlam* slam,
                       bool depth_mesh_wireframe,
                       int depth_mesh_width,
                       int depth_mesh_height,
-                      float depth_mesh_valid_ratio) {
+                      float depth_mesh_valid_ratio,
+                      const FrameProfiler* profiler) {
     data_.point_count = point_count;
     data_.map_points = map_points;
     data_.bearing_landmarks = bearing_landmarks;
@@ -57,6 +63,22 @@ void DebugHud::Update(const ArCoreSlam* slam,
     data_.torch_enabled = false;
     data_.depth_enabled = false;
 
+    stage_timings_.clear();
+    if (profiler) {
+        profiler->ComputeStats(kStageWindowNs, data_.stage_stats);
+        for (int i = 0; i < FrameProfiler::kStageCount; ++i) {
+            const FrameProfiler::StageStats& stats = data_.stage_stats[i];
+            if (stats.count == 0) continue;
+            char line[96];
+            snprintf(line, sizeof(line), "%s%s %.1f/%.1f/%.1f ms",
+                     stage_timings_.empty() ? "" : "\n",
+                     FrameProfiler::GetStageName(static_cast<ProfileStage>(i)),
+                     stats.p50_ms, stats.p95_ms, stats.p99_ms);
+            stage_timings_ += line;
+        }
+    }
+    data_.stage_timings = stage_timings_.c_str();
+
     if (!slam) return;
 
     const ArTrackingState state = slam->GetTrackingState();
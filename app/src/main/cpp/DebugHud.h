@@ -1,7 +1,9 @@
 #ifndef SLAMTORCH_DEBUG_HUD_H
 #define SLAMTORCH_DEBUG_HUD_H
 
+#include <string>
 #include "ArCoreSlam.h"
+#include "FrameProfiler.h"
 
 struct DebugHudData {
     const char* tracking_state = "NONE";
@@ -34,6 +36,10 @@ struct DebugHudData {
     int depth_mesh_width = 0;
     int depth_mesh_height = 0;
     float depth_mesh_valid_ratio = 0.0f;
+    // Per-stage p50/p95/p99 over the last second, indexed by ProfileStage,
+    // and the same as one line per stage that ran.
+    FrameProfiler::StageStats stage_stats[FrameProfiler::kStageCount];
+    const char* stage_timings = "";
 };
 
 class DebugHud {
@@ -63,11 +69,13 @@ public:
                 bool depth_mesh_wireframe,
                 int depth_mesh_width,
                 int depth_mesh_height,
-                float depth_mesh_valid_ratio);
+                float depth_mesh_valid_ratio,
+                const FrameProfiler* profiler);
     const DebugHudData& GetData() const { return data_; }
 
 private:
     DebugHudData data_;
+    std::string stage_timings_;
 };
 
 #endif // SLAMTORCH_DEBUG_HUD_H
@@ -0,0 +1,109 @@
+#include "DepthBackProjector.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SLAMTORCH_BACKPROJECT_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SLAMTORCH_BACKPROJECT_SSE 1
+#endif
+
+namespace {
+// world[k] = (m[k] * rx + m[4 + k] * ry - m[8 + k]) * d + m[12 + k]
+template <bool kPerPointRayY>
+void ProjectSamples(const float* ray_x, const float* ray_y, float row_ray_y, const float* depth_m,
+                    int count, const float* m, float* out_xyz) {
+    int i = 0;
+#if defined(SLAMTORCH_BACKPROJECT_NEON)
+    float32x4_t row_base[3];
+    for (int k = 0; k < 3; ++k) {
+        row_base[k] = vdupq_n_f32(m[4 + k] * row_ray_y - m[8 + k]);
+    }
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t rx = vld1q_f32(ray_x + i);
+        const float32x4_t d = vld1q_f32(depth_m + i);
+        float32x4x3_t world;
+        for (int k = 0; k < 3; ++k) {
+            float32x4_t base = row_base[k];
+            if constexpr (kPerPointRayY) {
+                base = vmlaq_n_f32(vdupq_n_f32(-m[8 + k]), vld1q_f32(ray_y + i), m[4 + k]);
+            }
+            world.val[k] = vmlaq_f32(vdupq_n_f32(m[12 + k]), vmlaq_n_f32(base, rx, m[k]), d);
+        }
+        vst3q_f32(out_xyz + i * 3, world);
+    }
+#elif defined(SLAMTORCH_BACKPROJECT_SSE)
+    __m128 row_base[3];
+    for (int k = 0; k < 3; ++k) {
+        row_base[k] = _mm_set1_ps(m[4 + k] * row_ray_y - m[8 + k]);
+    }
+    for (; i + 4 <= count; i += 4) {
+        const __m128 rx = _mm_loadu_ps(ray_x + i);
+        const __m128 d = _mm_loadu_ps(depth_m + i);
+        __m128 world[3];
+        for (int k = 0; k < 3; ++k) {
+            __m128 base = row_base[k];
+            if constexpr (kPerPointRayY) {
+                base = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(ray_y + i), _mm_set1_ps(m[4 + k])),
+                                  _mm_set1_ps(m[8 + k]));
+            }
+            const __m128 dir = _mm_add_ps(_mm_mul_ps(rx, _mm_set1_ps(m[k])), base);
+            world[k] = _mm_add_ps(_mm_mul_ps(dir, d), _mm_set1_ps(m[12 + k]));
+        }
+        // Interleave x0..x3 / y0..y3 / z0..z3 into x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3.
+        const __m128 xy_lo = _mm_unpacklo_ps(world[0], world[1]);
+        const __m128 xy_hi = _mm_unpackhi_ps(world[0], world[1]);
+        const __m128 zx_lo = _mm_unpacklo_ps(world[2], world[0]);
+        const __m128 zx_hi = _mm_unpackhi_ps(world[2], world[0]);
+        const __m128 yz_lo = _mm_unpacklo_ps(world[1], world[2]);
+        const __m128 yz_hi = _mm_unpackhi_ps(world[1], world[2]);
+        _mm_storeu_ps(out_xyz + i * 3, _mm_shuffle_ps(xy_lo, zx_lo, _MM_SHUFFLE(3, 0, 1, 0)));
+        _mm_storeu_ps(out_xyz + i * 3 + 4, _mm_shuffle_ps(yz_lo, xy_hi, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_ps(out_xyz + i * 3 + 8, _mm_shuffle_ps(zx_hi, yz_hi, _MM_SHUFFLE(3, 2, 3, 0)));
+    }
+#endif
+    for (; i < count; ++i) {
+        const float rx = ray_x[i];
+        const float ry = kPerPointRayY ? ray_y[i] : row_ray_y;
+        const float d = depth_m[i];
+        for (int k = 0; k < 3; ++k) {
+            out_xyz[i * 3 + k] = (m[k] * rx + m[4 + k] * ry - m[8 + k]) * d + m[12 + k];
+        }
+    }
+}
+}
+
+DepthBackProjector::Intrinsics DepthBackProjector::ScaleToDepth(float fx, float fy, float cx, float cy,
+                                                                int image_width, int image_height,
+                                                                int depth_width, int depth_height) {
+    const float scale_x = (image_width > 0) ? (static_cast<float>(depth_width) / static_cast<float>(image_width)) : 1.0f;
+    const float scale_y = (image_height > 0) ? (static_cast<float>(depth_height) / static_cast<float>(image_height)) : 1.0f;
+    Intrinsics intrinsics;
+    intrinsics.fx = fx * scale_x;
+    intrinsics.fy = fy * scale_y;
+    intrinsics.cx = cx * scale_x;
+    intrinsics.cy = cy * scale_y;
+    return intrinsics;
+}
+
+int DepthBackProjector::SampleRow(const float* depth_row, const int* columns, int count,
+                                  float min_depth_m, float max_depth_m, float* out_depth_m) {
+    int valid = 0;
+    for (int i = 0; i < count; ++i) {
+        const float depth_m = depth_row[columns[i]];
+        const bool ok = depth_m > 0.0f && depth_m >= min_depth_m && depth_m <= max_depth_m;
+        out_depth_m[i] = ok ? depth_m : 0.0f;
+        valid += ok ? 1 : 0;
+    }
+    return valid;
+}
+
+void DepthBackProjector::ProjectRow(const float* ray_x, float ray_y, const float* depth_m, int count,
+                                    const float* world_from_camera, float* out_xyz) {
+    ProjectSamples<false>(ray_x, nullptr, ray_y, depth_m, count, world_from_camera, out_xyz);
+}
+
+void DepthBackProjector::ProjectPoints(const float* ray_x, const float* ray_y, const float* depth_m, int count,
+                                       const float* world_from_camera, float* out_xyz) {
+    ProjectSamples<true>(ray_x, ray_y, 0.0f, depth_m, count, world_from_camera, out_xyz);
+}
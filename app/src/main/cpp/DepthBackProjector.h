@@ -0,0 +1,38 @@
+#ifndef SLAMTORCH_DEPTH_BACK_PROJECTOR_H
+#define SLAMTORCH_DEPTH_BACK_PROJECTOR_H
+
+// Shared depth -> world back-projection. Pixel rays (x - cx) / fx and
+// (y - cy) / fy come from a DepthRayCache, so the kernel only needs a
+// multiply-add per output coordinate. It runs 4 samples at a time on NEON and
+// SSE2, with a scalar loop for the tail and for other targets.
+class DepthBackProjector {
+public:
+    struct Intrinsics {
+        float fx = 0.0f;
+        float fy = 0.0f;
+        float cx = 0.0f;
+        float cy = 0.0f;
+    };
+
+    // Rescales camera-image intrinsics to a depth image of another resolution.
+    static Intrinsics ScaleToDepth(float fx, float fy, float cx, float cy,
+                                   int image_width, int image_height,
+                                   int depth_width, int depth_height);
+
+    // Gathers a metric depth row (see DepthPreprocessor) at the given columns.
+    // Samples that are 0 or outside [min_depth_m, max_depth_m] are written as
+    // 0. Returns the number of valid samples.
+    static int SampleRow(const float* depth_row, const int* columns, int count,
+                         float min_depth_m, float max_depth_m, float* out_depth_m);
+
+    // Writes world xyz (3 floats per sample) for count samples of one depth
+    // row, with camera-space point (ray_x * d, ray_y * d, -d). Samples with
+    // depth 0 land on the camera centre; callers skip them.
+    static void ProjectRow(const float* ray_x, float ray_y, const float* depth_m, int count,
+                           const float* world_from_camera, float* out_xyz);
+    // Same as ProjectRow for scattered samples with their own ray_y.
+    static void ProjectPoints(const float* ray_x, const float* ray_y, const float* depth_m, int count,
+                              const float* world_from_camera, float* out_xyz);
+};
+
+#endif // SLAMTORCH_DEPTH_BACK_PROJECTOR_H
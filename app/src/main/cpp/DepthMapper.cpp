@@ -1,172 +1,928 @@
 #include "DepthMapper.h"
+#include "DepthBackProjector.h"
+#include "MarchingCubesTables.h"
+#include "OpenAddressing.h"
 #include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <limits>
 
 namespace {
-constexpr int kVoxelCount = DepthMapper::kGridDim * DepthMapper::kGridDim * DepthMapper::kGridDim;
-constexpr float kHalfExtent = DepthMapper::kGridDim * DepthMapper::kVoxelSize * 0.5f;
-constexpr float kRecenterDistance = kHalfExtent * 0.35f;
+constexpr float kRecenterFraction = 0.35f;
+constexpr int kBlockShift = 3;
+constexpr int kBlockMask = DepthMapper::kBlockDim - 1;
+static_assert((1 << kBlockShift) == DepthMapper::kBlockDim, "kBlockShift must match kBlockDim");
+
+inline int VoxelIndex(int vx, int vy, int vz) {
+    return (vx & kBlockMask) +
+           ((vy & kBlockMask) * DepthMapper::kBlockDim) +
+           ((vz & kBlockMask) * DepthMapper::kBlockDim * DepthMapper::kBlockDim);
+}
+
+// Visits the voxels pierced by the segment from -> to with a 3D-DDA
+// (Amanatides & Woo). Stops before the voxel holding `to` unless include_end is
+// set, or after max_steps voxels. Returns the number of voxels visited.
+template <typename Visit>
+int WalkVoxels(const float* from, const float* to, float inv_voxel_size, int max_steps,
+               bool include_end, Visit&& visit) {
+    int voxel[3];
+    int end_voxel[3];
+    int step[3];
+    float t_max[3];
+    float t_delta[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        const float pos = from[axis] * inv_voxel_size;
+        const float delta = (to[axis] - from[axis]) * inv_voxel_size;
+        voxel[axis] = static_cast<int>(std::floor(pos));
+        end_voxel[axis] = static_cast<int>(std::floor(to[axis] * inv_voxel_size));
+        if (delta > 0.0f) {
+            step[axis] = 1;
+            t_delta[axis] = 1.0f / delta;
+            t_max[axis] = (static_cast<float>(voxel[axis] + 1) - pos) * t_delta[axis];
+        } else if (delta < 0.0f) {
+            step[axis] = -1;
+            t_delta[axis] = -1.0f / delta;
+            t_max[axis] = (pos - static_cast<float>(voxel[axis])) * t_delta[axis];
+        } else {
+            step[axis] = 0;
+            t_delta[axis] = std::numeric_limits<float>::max();
+            t_max[axis] = std::numeric_limits<float>::max();
+        }
+    }
+
+    int steps = 0;
+    while (steps < max_steps) {
+        const bool at_end = voxel[0] == end_voxel[0] && voxel[1] == end_voxel[1] && voxel[2] == end_voxel[2];
+        if (at_end && !include_end) break;
+        visit(voxel[0], voxel[1], voxel[2]);
+        steps++;
+        if (at_end) break;
+
+        const int axis = (t_max[0] < t_max[1])
+            ? (t_max[0] < t_max[2] ? 0 : 2)
+            : (t_max[1] < t_max[2] ? 1 : 2);
+        if (t_max[axis] > 1.0f) break;
+        voxel[axis] += step[axis];
+        t_max[axis] += t_delta[axis];
+    }
+    return steps;
+}
+
+// Hands the accumulated changes to out, clipped to count, and starts over.
+void TakeChanged(std::vector<SlotRange>* changed, int count, std::vector<SlotRange>* out) {
+    MergeRanges(changed, DepthMapper::kChangedMergeGap, DepthMapper::kMaxChangedRanges);
+    if (out) {
+        out->clear();
+        for (const SlotRange& range : *changed) {
+            if (range.begin >= count) break;
+            out->push_back(SlotRange{range.begin, std::min(range.end, count)});
+        }
+    }
+    changed->clear();
+}
 }
 
-DepthMapper::DepthMapper()
-    : occupancy_(kVoxelCount, 0),
-      render_points_(kVoxelCount * 3, 0.0f) {}
+DepthMapper::DepthMapper(float voxel_size)
+    : voxel_size_(voxel_size > 0.0f ? voxel_size : kDefaultVoxelSize),
+      inv_voxel_size_(1.0f / (voxel_size > 0.0f ? voxel_size : kDefaultVoxelSize)),
+      table_(kInitialTableSize, -1),
+      table_mask_(kInitialTableSize - 1),
+      render_table_(kInitialRenderTableSize, -1),
+      render_table_mask_(kInitialRenderTableSize - 1) {
+    blocks_.reserve(kInitialTableSize / 2);
+    pending_hits_.reserve(4096 * 3);
+    SetWindowHalfExtent(kWindowHalfExtent);
+}
+
+void DepthMapper::SetWindowHalfExtent(float half_extent_m) {
+    const float block_size = voxel_size_ * static_cast<float>(kBlockDim);
+    window_half_blocks_ = std::max(1, static_cast<int>(std::ceil(half_extent_m / block_size)));
+    if (origin_set_) {
+        // Resizing is rare (settings change), so just start the map over.
+        origin_set_ = false;
+        ClearBlocks();
+        render_dirty_ = true;
+    }
+}
+
+void DepthMapper::SetFusionMode(FusionMode mode) {
+    if (mode == fusion_mode_) return;
+    fusion_mode_ = mode;
+    ClearBlocks();
+    render_dirty_ = true;
+}
 
 void DepthMapper::Reset() {
-    std::fill(occupancy_.begin(), occupancy_.end(), 0);
-    voxels_used_ = 0;
-    render_point_count_ = 0;
+    ClearBlocks();
     render_dirty_ = true;
     stats_ = Stats{};
     origin_set_ = false;
 }
 
+void DepthMapper::ClearBlocks() {
+    blocks_.clear();
+    std::fill(table_.begin(), table_.end(), -1);
+    voxels_used_ = 0;
+    render_point_count_ = 0;
+    std::fill(render_table_.begin(), render_table_.end(), -1);
+    render_changed_.clear();
+    tsdf_blocks_.clear();
+    mesh_vertex_count_ = 0;
+    mesh_live_vertices_ = 0;
+    mesh_wasted_vertices_ = 0;
+    mesh_changed_.clear();
+    mesh_dirty_ = true;
+}
+
+uint32_t DepthMapper::HashOwner(int owner) {
+    const uint32_t hash = static_cast<uint32_t>(owner) * 2654435761u;
+    return hash ^ (hash >> 15);
+}
+
+int DepthMapper::FindSlot(int bx, int by, int bz) const {
+    uint32_t slot = HashCell(bx, by, bz) & table_mask_;
+    while (true) {
+        const int32_t index = table_[slot];
+        if (index < 0) return -1;
+        const VoxelBlock& block = blocks_[index];
+        if (block.coord[0] == bx && block.coord[1] == by && block.coord[2] == bz) {
+            return static_cast<int>(slot);
+        }
+        slot = (slot + 1) & table_mask_;
+    }
+}
+
+int DepthMapper::FindBlock(int bx, int by, int bz) const {
+    const int slot = FindSlot(bx, by, bz);
+    return slot >= 0 ? table_[slot] : -1;
+}
+
+void DepthMapper::EraseSlot(uint32_t slot) {
+    BackwardShiftErase(&table_, table_mask_, slot, [this](int32_t index) {
+        const VoxelBlock& block = blocks_[index];
+        return HashCell(block.coord[0], block.coord[1], block.coord[2]);
+    });
+}
+
+void DepthMapper::RemoveBlock(int block_index) {
+    VoxelBlock& block = blocks_[block_index];
+    const int removed_coord[3] = {block.coord[0], block.coord[1], block.coord[2]};
+    const int slot = FindSlot(block.coord[0], block.coord[1], block.coord[2]);
+    if (slot < 0) return;
+    EraseSlot(static_cast<uint32_t>(slot));
+    if (block.occupied_count > 0) {
+        for (int v = 0; v < kBlockVoxels; ++v) {
+            if (block.log_odds[v] > kLogOddsOccupied) {
+                RemoveRenderPoint(block_index, v);
+            }
+        }
+        voxels_used_ -= block.occupied_count;
+    }
+
+    const int last = static_cast<int>(blocks_.size()) - 1;
+    if (block_index != last) {
+        const VoxelBlock& moved = blocks_[last];
+        const int moved_slot = FindSlot(moved.coord[0], moved.coord[1], moved.coord[2]);
+        blocks_[block_index] = moved;
+        if (moved_slot >= 0) {
+            table_[moved_slot] = block_index;
+        }
+        // The relocated block's points change owner, so re-key their entries.
+        const VoxelBlock& relocated = blocks_[block_index];
+        if (relocated.occupied_count > 0) {
+            for (int v = 0; v < kBlockVoxels; ++v) {
+                if (relocated.log_odds[v] <= kLogOddsOccupied) continue;
+                const int entry = FindRenderEntry(last * kBlockVoxels + v);
+                if (entry < 0) continue;
+                const int point = render_table_[entry];
+                EraseRenderEntry(static_cast<uint32_t>(entry));
+                render_owner_[point] = block_index * kBlockVoxels + v;
+                InsertRenderEntry(point);
+            }
+        }
+    }
+    blocks_.pop_back();
+
+    if (fusion_mode_ == FusionMode::TSDF) {
+        ReleaseBlockMesh(&tsdf_blocks_[block_index]);
+        if (block_index != last) {
+            tsdf_blocks_[block_index] = tsdf_blocks_[last];
+        }
+        tsdf_blocks_.pop_back();
+        // Cubes in the lower neighbours reached into the evicted block.
+        for (int n = 1; n < 8; ++n) {
+            const int neighbor = FindBlock(removed_coord[0] - (n & 1),
+                                           removed_coord[1] - ((n >> 1) & 1),
+                                           removed_coord[2] - ((n >> 2) & 1));
+            if (neighbor >= 0) {
+                tsdf_blocks_[neighbor].mesh_dirty = true;
+            }
+        }
+    }
+}
+
+void DepthMapper::InsertIntoTable(int block_index) {
+    const VoxelBlock& block = blocks_[block_index];
+    uint32_t slot = HashCell(block.coord[0], block.coord[1], block.coord[2]) & table_mask_;
+    while (table_[slot] >= 0) {
+        slot = (slot + 1) & table_mask_;
+    }
+    table_[slot] = block_index;
+}
+
+void DepthMapper::GrowTable() {
+    const size_t new_size = table_.size() * 2;
+    table_.assign(new_size, -1);
+    table_mask_ = static_cast<uint32_t>(new_size - 1);
+    for (int i = 0; i < static_cast<int>(blocks_.size()); ++i) {
+        InsertIntoTable(i);
+    }
+}
+
+int DepthMapper::FindOrAllocateBlock(int bx, int by, int bz) {
+    const int existing = FindBlock(bx, by, bz);
+    if (existing >= 0) return existing;
+    if (static_cast<int>(blocks_.size()) >= kMaxBlocks) return -1;
+
+    if ((blocks_.size() + 1) * 2 > table_.size()) {
+        GrowTable();
+    }
+
+    blocks_.emplace_back();
+    VoxelBlock& block = blocks_.back();
+    block.coord[0] = bx;
+    block.coord[1] = by;
+    block.coord[2] = bz;
+    block.occupied_count = 0;
+    memset(block.log_odds, 0, sizeof(block.log_odds));
+    if (fusion_mode_ == FusionMode::TSDF) {
+        tsdf_blocks_.emplace_back();
+        TsdfBlock& tsdf = tsdf_blocks_.back();
+        memset(tsdf.sdf, 0, sizeof(tsdf.sdf));
+        memset(tsdf.weight, 0, sizeof(tsdf.weight));
+        tsdf.mesh_dirty = false;
+        tsdf.mesh_offset = 0;
+        tsdf.mesh_capacity = 0;
+        tsdf.mesh_count = 0;
+    }
+
+    const int index = static_cast<int>(blocks_.size()) - 1;
+    InsertIntoTable(index);
+    return index;
+}
+
+bool DepthMapper::IsBlockInWindow(int bx, int by, int bz) const {
+    return std::abs(bx - window_center_[0]) <= window_half_blocks_ &&
+           std::abs(by - window_center_[1]) <= window_half_blocks_ &&
+           std::abs(bz - window_center_[2]) <= window_half_blocks_;
+}
+
+void DepthMapper::EvictLeavingBlocks(const int* old_center, const int* new_center) {
+    const int h = window_half_blocks_;
+    int lo_old[3];
+    int hi_old[3];
+    int lo_new[3];
+    int hi_new[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        lo_old[axis] = old_center[axis] - h;
+        hi_old[axis] = old_center[axis] + h;
+        lo_new[axis] = new_center[axis] - h;
+        hi_new[axis] = new_center[axis] + h;
+        if (lo_new[axis] > hi_old[axis] || hi_new[axis] < lo_old[axis]) {
+            // No overlap: the whole window leaves.
+            ClearBlocks();
+            render_dirty_ = true;
+            return;
+        }
+    }
+
+    // Walk the old window column by column and jump over the z run it shares
+    // with the new window, so only the leaving slabs are probed.
+    const int overlap_lo_x = std::max(lo_old[0], lo_new[0]);
+    const int overlap_hi_x = std::min(hi_old[0], hi_new[0]);
+    const int overlap_lo_y = std::max(lo_old[1], lo_new[1]);
+    const int overlap_hi_y = std::min(hi_old[1], hi_new[1]);
+    for (int bx = lo_old[0]; bx <= hi_old[0]; ++bx) {
+        const bool x_inside = bx >= overlap_lo_x && bx <= overlap_hi_x;
+        for (int by = lo_old[1]; by <= hi_old[1]; ++by) {
+            const bool y_inside = by >= overlap_lo_y && by <= overlap_hi_y;
+            for (int bz = lo_old[2]; bz <= hi_old[2]; ++bz) {
+                if (x_inside && y_inside) {
+                    if (bz >= lo_new[2] && bz <= hi_new[2]) {
+                        // Jump over the retained z run.
+                        bz = hi_new[2];
+                        continue;
+                    }
+                }
+                const int index = FindBlock(bx, by, bz);
+                if (index >= 0) {
+                    RemoveBlock(index);
+                }
+            }
+        }
+    }
+}
+
 void DepthMapper::RecenterIfNeeded(const float* world_from_camera) {
     if (!world_from_camera) return;
-    const float cam_x = world_from_camera[12];
-    const float cam_y = world_from_camera[13];
-    const float cam_z = world_from_camera[14];
+    const float block_size = voxel_size_ * static_cast<float>(kBlockDim);
+    const int cam_block[3] = {
+        static_cast<int>(std::floor(world_from_camera[12] / block_size)),
+        static_cast<int>(std::floor(world_from_camera[13] / block_size)),
+        static_cast<int>(std::floor(world_from_camera[14] / block_size))
+    };
     if (!origin_set_) {
-        origin_[0] = cam_x;
-        origin_[1] = cam_y;
-        origin_[2] = cam_z;
+        window_center_[0] = cam_block[0];
+        window_center_[1] = cam_block[1];
+        window_center_[2] = cam_block[2];
         origin_set_ = true;
         return;
     }
 
-    const float dx = cam_x - origin_[0];
-    const float dy = cam_y - origin_[1];
-    const float dz = cam_z - origin_[2];
-    if (std::fabs(dx) > kRecenterDistance ||
-        std::fabs(dy) > kRecenterDistance ||
-        std::fabs(dz) > kRecenterDistance) {
-        origin_[0] = cam_x;
-        origin_[1] = cam_y;
-        origin_[2] = cam_z;
-        std::fill(occupancy_.begin(), occupancy_.end(), 0);
-        voxels_used_ = 0;
-        render_dirty_ = true;
+    const int recenter_blocks = std::max(1, static_cast<int>(window_half_blocks_ * kRecenterFraction));
+    if (std::abs(cam_block[0] - window_center_[0]) > recenter_blocks ||
+        std::abs(cam_block[1] - window_center_[1]) > recenter_blocks ||
+        std::abs(cam_block[2] - window_center_[2]) > recenter_blocks) {
+        const int old_center[3] = {window_center_[0], window_center_[1], window_center_[2]};
+        EvictLeavingBlocks(old_center, cam_block);
+        window_center_[0] = cam_block[0];
+        window_center_[1] = cam_block[1];
+        window_center_[2] = cam_block[2];
     }
 }
 
-void DepthMapper::Update(const DepthFrame& frame,
-                         float fx, float fy, float cx, float cy,
-                         int image_width, int image_height,
-                         const float* world_from_camera) {
+void DepthMapper::Update(const DepthPreprocessor& depth, const DepthRayCache& rays, const float* world_from_camera) {
     stats_.points_fused_last_frame = 0;
+    stats_.voxels_freed_last_frame = 0;
+    stats_.rays_carved_last_frame = 0;
     stats_.min_depth_m = 0.0f;
     stats_.max_depth_m = 0.0f;
     stats_.voxels_used = voxels_used_;
+    stats_.blocks_used = static_cast<int>(blocks_.size());
 
-    if (!enabled_ || !frame.depth_data || !world_from_camera) {
+    if (!enabled_ || !depth.IsValid() || !world_from_camera) {
+        return;
+    }
+    if (rays.GetDepthWidth() != depth.GetWidth() || rays.GetDepthHeight() != depth.GetHeight()) {
         return;
     }
 
     RecenterIfNeeded(world_from_camera);
     if (!origin_set_) return;
 
-    const float scale_x = (image_width > 0) ? (static_cast<float>(frame.width) / static_cast<float>(image_width)) : 1.0f;
-    const float scale_y = (image_height > 0) ? (static_cast<float>(frame.height) / static_cast<float>(image_height)) : 1.0f;
-    const float fx_depth = fx * scale_x;
-    const float fy_depth = fy * scale_y;
-    const float cx_depth = cx * scale_x;
-    const float cy_depth = cy * scale_y;
+    // Each pyramid pixel averages the nearest surface in its footprint, so
+    // its ray goes through the footprint centre.
+    const DepthPreprocessor::Level& level = depth.GetLevel(kSampleLevel);
+    const int columns = level.width;
+    if (rays.GetGeneration() != ray_generation_) {
+        ray_generation_ = rays.GetGeneration();
+        const float center = 0.5f * static_cast<float>(level.scale - 1);
+        sample_columns_.resize(columns);
+        column_rays_.resize(columns);
+        row_depths_.resize(columns);
+        row_rays_.resize(level.height);
+        for (int i = 0; i < columns; ++i) {
+            sample_columns_[i] = i;
+            column_rays_[i] = rays.DepthColumnRay(static_cast<float>(i * level.scale) + center);
+        }
+        for (int y = 0; y < level.height; ++y) {
+            row_rays_[y] = rays.DepthRowRay(static_cast<float>(y * level.scale) + center);
+        }
+    }
 
-    const int stride = 4;
     float min_depth = 0.0f;
     float max_depth = 0.0f;
 
-    for (int y = 0; y < frame.height; y += stride) {
-        const uint8_t* row = reinterpret_cast<const uint8_t*>(frame.depth_data) + frame.row_stride * y;
-        const uint8_t* conf_row = frame.confidence_data
-            ? (reinterpret_cast<const uint8_t*>(frame.confidence_data) + frame.confidence_row_stride * y)
-            : nullptr;
-        for (int x = 0; x < frame.width; x += stride) {
-            const uint16_t* depth_pixel = reinterpret_cast<const uint16_t*>(row + frame.pixel_stride * x);
-            const uint16_t depth_mm = *depth_pixel;
-            if (depth_mm == 0) continue;
-            const float depth_m = static_cast<float>(depth_mm) * 0.001f;
-            if (depth_m < kMinDepthM || depth_m > kMaxDepthM) continue;
-
-            if (conf_row && frame.confidence_pixel_stride > 0) {
-                const uint8_t confidence = *(conf_row + frame.confidence_pixel_stride * x);
-                if (confidence < kConfidenceThreshold) continue;
-            }
+    pending_hits_.clear();
 
+    for (int y = 0; y < level.height; ++y) {
+        const int valid = DepthBackProjector::SampleRow(level.depth_m + static_cast<size_t>(y) * columns,
+                                                        sample_columns_.data(), columns,
+                                                        kMinDepthM, kMaxDepthM, row_depths_.data());
+        if (valid == 0) continue;
+
+        // Project the whole row, then compact the valid samples in place.
+        const size_t row_start = pending_hits_.size();
+        pending_hits_.resize(row_start + columns * 3);
+        float* out = pending_hits_.data() + row_start;
+        DepthBackProjector::ProjectRow(column_rays_.data(), row_rays_[y],
+                                       row_depths_.data(), columns, world_from_camera, out);
+        int kept = 0;
+        for (int i = 0; i < columns; ++i) {
+            const float depth_m = row_depths_[i];
+            if (depth_m <= 0.0f) continue;
             if (min_depth == 0.0f || depth_m < min_depth) min_depth = depth_m;
             if (depth_m > max_depth) max_depth = depth_m;
-
-            const float x_cam = (static_cast<float>(x) - cx_depth) * depth_m / fx_depth;
-            const float y_cam = (static_cast<float>(y) - cy_depth) * depth_m / fy_depth;
-            const float z_cam = -depth_m;
-
-            const float world_x = world_from_camera[0] * x_cam +
-                                  world_from_camera[4] * y_cam +
-                                  world_from_camera[8] * z_cam +
-                                  world_from_camera[12];
-            const float world_y = world_from_camera[1] * x_cam +
-                                  world_from_camera[5] * y_cam +
-                                  world_from_camera[9] * z_cam +
-                                  world_from_camera[13];
-            const float world_z = world_from_camera[2] * x_cam +
-                                  world_from_camera[6] * y_cam +
-                                  world_from_camera[10] * z_cam +
-                                  world_from_camera[14];
-
-            const float local_x = world_x - origin_[0] + kHalfExtent;
-            const float local_y = world_y - origin_[1] + kHalfExtent;
-            const float local_z = world_z - origin_[2] + kHalfExtent;
-            const int gx = static_cast<int>(local_x / kVoxelSize);
-            const int gy = static_cast<int>(local_y / kVoxelSize);
-            const int gz = static_cast<int>(local_z / kVoxelSize);
-            if (gx < 0 || gy < 0 || gz < 0 || gx >= kGridDim || gy >= kGridDim || gz >= kGridDim) {
-                continue;
-            }
-
-            const int idx = gx + (gy * kGridDim) + (gz * kGridDim * kGridDim);
-            if (occupancy_[idx] == 0) {
-                voxels_used_++;
+            if (kept != i) {
+                out[kept * 3 + 0] = out[i * 3 + 0];
+                out[kept * 3 + 1] = out[i * 3 + 1];
+                out[kept * 3 + 2] = out[i * 3 + 2];
             }
-            const int next = std::min<int>(kOccupancyMax, occupancy_[idx] + kOccupancyIncrement);
-            occupancy_[idx] = static_cast<uint8_t>(next);
-            stats_.points_fused_last_frame++;
-            render_dirty_ = true;
+            kept++;
         }
+        pending_hits_.resize(row_start + kept * 3);
+    }
+
+    if (fusion_mode_ == FusionMode::TSDF) {
+        IntegrateTsdf(world_from_camera + 12);
+    } else {
+        // Carve before integrating hits so a surface observed this frame is
+        // never erased by a neighbouring ray that grazes it.
+        CarveFreeSpace(world_from_camera + 12);
+        IntegrateHits();
     }
 
     stats_.voxels_used = voxels_used_;
+    stats_.blocks_used = static_cast<int>(blocks_.size());
     stats_.min_depth_m = min_depth;
     stats_.max_depth_m = max_depth;
 }
 
-void DepthMapper::RebuildRenderPoints() {
-    render_point_count_ = 0;
-    for (int z = 0; z < kGridDim; ++z) {
-        for (int y = 0; y < kGridDim; ++y) {
-            for (int x = 0; x < kGridDim; ++x) {
-                const int idx = x + (y * kGridDim) + (z * kGridDim * kGridDim);
-                if (occupancy_[idx] == 0) continue;
-                const float world_x = origin_[0] + (static_cast<float>(x) + 0.5f) * kVoxelSize - kHalfExtent;
-                const float world_y = origin_[1] + (static_cast<float>(y) + 0.5f) * kVoxelSize - kHalfExtent;
-                const float world_z = origin_[2] + (static_cast<float>(z) + 0.5f) * kVoxelSize - kHalfExtent;
-                const int out_idx = render_point_count_ * 3;
-                render_points_[out_idx + 0] = world_x;
-                render_points_[out_idx + 1] = world_y;
-                render_points_[out_idx + 2] = world_z;
-                render_point_count_++;
+int DepthMapper::LookupBlockCached(int bx, int by, int bz, bool allocate, BlockCache* cache) {
+    if (cache->valid && cache->coord[0] == bx && cache->coord[1] == by && cache->coord[2] == bz) {
+        return cache->index;
+    }
+    if (!IsBlockInWindow(bx, by, bz)) {
+        cache->index = -1;
+    } else {
+        cache->index = allocate ? FindOrAllocateBlock(bx, by, bz) : FindBlock(bx, by, bz);
+    }
+    cache->valid = true;
+    cache->coord[0] = bx;
+    cache->coord[1] = by;
+    cache->coord[2] = bz;
+    return cache->index;
+}
+
+void DepthMapper::ApplyLogOdds(int block_index, int voxel_index, int delta) {
+    VoxelBlock& block = blocks_[block_index];
+    const int prev = block.log_odds[voxel_index];
+    const int next = std::max<int>(kLogOddsMin, std::min<int>(kLogOddsMax, prev + delta));
+    if (next == prev) return;
+    block.log_odds[voxel_index] = static_cast<int8_t>(next);
+
+    const bool was_occupied = prev > kLogOddsOccupied;
+    const bool is_occupied = next > kLogOddsOccupied;
+    if (is_occupied && !was_occupied) {
+        block.occupied_count++;
+        voxels_used_++;
+        AddRenderPoint(block_index, voxel_index);
+    } else if (was_occupied && !is_occupied) {
+        block.occupied_count--;
+        voxels_used_--;
+        RemoveRenderPoint(block_index, voxel_index);
+        stats_.voxels_freed_last_frame++;
+    }
+}
+
+void DepthMapper::IntegrateHits() {
+    // Consecutive samples usually land in the same block, so the cache skips
+    // the window test and hash probe most of the time.
+    BlockCache cache;
+    const int hit_count = static_cast<int>(pending_hits_.size() / 3);
+    for (int i = 0; i < hit_count; ++i) {
+        const float* hit = pending_hits_.data() + i * 3;
+        const int vx = static_cast<int>(std::floor(hit[0] * inv_voxel_size_));
+        const int vy = static_cast<int>(std::floor(hit[1] * inv_voxel_size_));
+        const int vz = static_cast<int>(std::floor(hit[2] * inv_voxel_size_));
+        const int block_index = LookupBlockCached(vx >> kBlockShift, vy >> kBlockShift, vz >> kBlockShift,
+                                                  true, &cache);
+        if (block_index < 0) continue;
+        ApplyLogOdds(block_index, VoxelIndex(vx, vy, vz), kLogOddsHit);
+        stats_.points_fused_last_frame++;
+    }
+}
+
+void DepthMapper::CarveFreeSpace(const float* camera_position) {
+    const int ray_count = static_cast<int>(pending_hits_.size() / 3);
+    if (ray_count == 0 || max_carve_distance_m_ <= 0.0f) return;
+
+    // Rays are visited starting from a rotating cursor so that, when the step
+    // budget runs out, the rays skipped this frame are carved first next frame.
+    int steps_left = kMaxCarveStepsPerFrame;
+    const int start = ray_cursor_ % ray_count;
+    BlockCache cache;
+    int carved = 0;
+    for (; carved < ray_count && steps_left > 0; ++carved) {
+        const float* hit = pending_hits_.data() + ((start + carved) % ray_count) * 3;
+        const float dir[3] = {
+            hit[0] - camera_position[0],
+            hit[1] - camera_position[1],
+            hit[2] - camera_position[2]
+        };
+        const float length = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+        if (length < voxel_size_) continue;
+        const float back = std::min(length, max_carve_distance_m_) / length;
+        const float from[3] = {
+            hit[0] - dir[0] * back,
+            hit[1] - dir[1] * back,
+            hit[2] - dir[2] * back
+        };
+
+        steps_left -= WalkVoxels(from, hit, inv_voxel_size_, steps_left, false,
+                                 [&](int vx, int vy, int vz) {
+            const int block_index = LookupBlockCached(vx >> kBlockShift, vy >> kBlockShift, vz >> kBlockShift,
+                                                      false, &cache);
+            if (block_index >= 0) {
+                ApplyLogOdds(block_index, VoxelIndex(vx, vy, vz), kLogOddsMiss);
+            }
+        });
+    }
+    ray_cursor_ = (start + carved) % ray_count;
+    stats_.rays_carved_last_frame = carved;
+}
+
+void DepthMapper::IntegrateTsdf(const float* camera_position) {
+    const int ray_count = static_cast<int>(pending_hits_.size() / 3);
+    if (ray_count == 0) return;
+
+    const float truncation = kTruncationVoxels * voxel_size_;
+    const float inv_truncation = 1.0f / truncation;
+    int steps_left = kMaxTsdfStepsPerFrame;
+    const int start = ray_cursor_ % ray_count;
+    BlockCache cache;
+    int integrated = 0;
+    for (; integrated < ray_count && steps_left > 0; ++integrated) {
+        const float* hit = pending_hits_.data() + ((start + integrated) % ray_count) * 3;
+        float dir[3] = {
+            hit[0] - camera_position[0],
+            hit[1] - camera_position[1],
+            hit[2] - camera_position[2]
+        };
+        const float length = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+        if (length <= truncation) continue;
+        const float inv_length = 1.0f / length;
+        dir[0] *= inv_length;
+        dir[1] *= inv_length;
+        dir[2] *= inv_length;
+        const float from[3] = {
+            hit[0] - dir[0] * truncation,
+            hit[1] - dir[1] * truncation,
+            hit[2] - dir[2] * truncation
+        };
+        const float to[3] = {
+            hit[0] + dir[0] * truncation,
+            hit[1] + dir[1] * truncation,
+            hit[2] + dir[2] * truncation
+        };
+
+        steps_left -= WalkVoxels(from, to, inv_voxel_size_, steps_left, true,
+                                 [&](int vx, int vy, int vz) {
+            // Projective distance: depth of the hit minus depth of the voxel
+            // centre along this ray.
+            const float center[3] = {
+                (static_cast<float>(vx) + 0.5f) * voxel_size_ - camera_position[0],
+                (static_cast<float>(vy) + 0.5f) * voxel_size_ - camera_position[1],
+                (static_cast<float>(vz) + 0.5f) * voxel_size_ - camera_position[2]
+            };
+            const float sdf = length - (center[0] * dir[0] + center[1] * dir[1] + center[2] * dir[2]);
+            if (sdf < -truncation) return;
+            const float normalized = std::min(1.0f, sdf * inv_truncation);
+
+            const int block_index = LookupBlockCached(vx >> kBlockShift, vy >> kBlockShift, vz >> kBlockShift,
+                                                      true, &cache);
+            if (block_index < 0) return;
+            const int voxel_index = VoxelIndex(vx, vy, vz);
+            TsdfBlock& tsdf = tsdf_blocks_[block_index];
+            const int weight = tsdf.weight[voxel_index];
+            const float prev = static_cast<float>(tsdf.sdf[voxel_index]) / static_cast<float>(kSdfScale);
+            const float fused = (prev * static_cast<float>(weight) + normalized) / static_cast<float>(weight + 1);
+            tsdf.sdf[voxel_index] = static_cast<int16_t>(std::lround(fused * static_cast<float>(kSdfScale)));
+            tsdf.weight[voxel_index] = static_cast<uint8_t>(std::min(weight + 1, kMaxTsdfWeight));
+            if (weight == 0) {
+                blocks_[block_index].occupied_count++;
+                voxels_used_++;
             }
+            MarkMeshDirty(block_index, voxel_index);
+        });
+    }
+    ray_cursor_ = (start + integrated) % ray_count;
+    stats_.points_fused_last_frame = integrated;
+}
+
+void DepthMapper::MarkMeshDirty(int block_index, int voxel_index) {
+    tsdf_blocks_[block_index].mesh_dirty = true;
+    const int lx = voxel_index & kBlockMask;
+    const int ly = (voxel_index >> kBlockShift) & kBlockMask;
+    const int lz = voxel_index >> (2 * kBlockShift);
+    if (lx != 0 && ly != 0 && lz != 0) return;
+
+    // Voxels on a block's lower faces are also corners of cubes owned by the
+    // neighbouring blocks below them.
+    const VoxelBlock& block = blocks_[block_index];
+    for (int n = 1; n < 8; ++n) {
+        const int dx = n & 1;
+        const int dy = (n >> 1) & 1;
+        const int dz = (n >> 2) & 1;
+        if ((dx && lx != 0) || (dy && ly != 0) || (dz && lz != 0)) continue;
+        const int neighbor = FindBlock(block.coord[0] - dx, block.coord[1] - dy, block.coord[2] - dz);
+        if (neighbor >= 0) {
+            tsdf_blocks_[neighbor].mesh_dirty = true;
         }
     }
-    render_dirty_ = false;
 }
 
-const float* DepthMapper::GetRenderPoints(int* out_count, bool* out_dirty) {
-    const bool was_dirty = render_dirty_;
-    if (render_dirty_) {
-        RebuildRenderPoints();
+void DepthMapper::ExtractBlockMesh(int block_index) {
+    const VoxelBlock& block = blocks_[block_index];
+    TsdfBlock& tsdf = tsdf_blocks_[block_index];
+    tsdf.mesh_dirty = false;
+    mesh_scratch_.clear();
+
+    // Cubes on the upper faces take corners from the +x/+y/+z neighbours.
+    const TsdfBlock* neighbors[8];
+    neighbors[0] = &tsdf;
+    for (int n = 1; n < 8; ++n) {
+        const int index = FindBlock(block.coord[0] + (n & 1),
+                                    block.coord[1] + ((n >> 1) & 1),
+                                    block.coord[2] + ((n >> 2) & 1));
+        neighbors[n] = index >= 0 ? &tsdf_blocks_[index] : nullptr;
+    }
+
+    const float inv_scale = 1.0f / static_cast<float>(kSdfScale);
+    const int base[3] = {
+        block.coord[0] * kBlockDim,
+        block.coord[1] * kBlockDim,
+        block.coord[2] * kBlockDim
+    };
+    for (int z = 0; z < kBlockDim; ++z) {
+        for (int y = 0; y < kBlockDim; ++y) {
+            for (int x = 0; x < kBlockDim; ++x) {
+                float values[8];
+                bool observed = true;
+                float min_value = 1.0f;
+                float max_value = -1.0f;
+                int cube_index = 0;
+                for (int c = 0; c < 8 && observed; ++c) {
+                    const int cx = x + kMarchingCubesCornerOffsets[c][0];
+                    const int cy = y + kMarchingCubesCornerOffsets[c][1];
+                    const int cz = z + kMarchingCubesCornerOffsets[c][2];
+                    const TsdfBlock* source = neighbors[(cx >> kBlockShift) |
+                                                        ((cy >> kBlockShift) << 1) |
+                                                        ((cz >> kBlockShift) << 2)];
+                    if (!source) {
+                        observed = false;
+                        break;
+                    }
+                    const int index = VoxelIndex(cx, cy, cz);
+                    if (source->weight[index] == 0) {
+                        observed = false;
+                        break;
+                    }
+                    values[c] = static_cast<float>(source->sdf[index]) * inv_scale;
+                    min_value = std::min(min_value, values[c]);
+                    max_value = std::max(max_value, values[c]);
+                    if (values[c] < 0.0f) cube_index |= 1 << c;
+                }
+                if (!observed || cube_index == 0 || cube_index == 255) continue;
+                // A jump of more than the truncation band across one cube is an
+                // occlusion edge, not a surface.
+                if (max_value - min_value > 1.0f) continue;
+
+                float edge_points[12][3];
+                int edge_mask = 0;
+                const int8_t* triangles = kMarchingCubesTriangles[cube_index];
+                for (int t = 0; triangles[t] >= 0; t += 3) {
+                    float corners[3][3];
+                    for (int k = 0; k < 3; ++k) {
+                        const int edge = triangles[t + k];
+                        if (!(edge_mask & (1 << edge))) {
+                            const int a = kMarchingCubesEdgeCorners[edge][0];
+                            const int b = kMarchingCubesEdgeCorners[edge][1];
+                            const float s = values[a] / (values[a] - values[b]);
+                            for (int axis = 0; axis < 3; ++axis) {
+                                const float pa = kMarchingCubesCornerOffsets[a][axis];
+                                const float pb = kMarchingCubesCornerOffsets[b][axis];
+                                const int local = axis == 0 ? x : (axis == 1 ? y : z);
+                                edge_points[edge][axis] =
+                                    (static_cast<float>(base[axis] + local) + pa + s * (pb - pa) + 0.5f) * voxel_size_;
+                            }
+                            edge_mask |= 1 << edge;
+                        }
+                        corners[k][0] = edge_points[edge][0];
+                        corners[k][1] = edge_points[edge][1];
+                        corners[k][2] = edge_points[edge][2];
+                    }
+
+                    const float u[3] = {
+                        corners[1][0] - corners[0][0],
+                        corners[1][1] - corners[0][1],
+                        corners[1][2] - corners[0][2]
+                    };
+                    const float v[3] = {
+                        corners[2][0] - corners[0][0],
+                        corners[2][1] - corners[0][1],
+                        corners[2][2] - corners[0][2]
+                    };
+                    float normal[3] = {
+                        u[1] * v[2] - u[2] * v[1],
+                        u[2] * v[0] - u[0] * v[2],
+                        u[0] * v[1] - u[1] * v[0]
+                    };
+                    const float len = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                    if (len < 1e-12f) continue;
+                    normal[0] /= len;
+                    normal[1] /= len;
+                    normal[2] /= len;
+                    for (int k = 0; k < 3; ++k) {
+                        mesh_scratch_.insert(mesh_scratch_.end(), corners[k], corners[k] + 3);
+                        mesh_scratch_.insert(mesh_scratch_.end(), normal, normal + 3);
+                    }
+                }
+            }
+        }
+    }
+    PlaceBlockMesh(&tsdf);
+}
+
+void DepthMapper::PlaceBlockMesh(TsdfBlock* tsdf) {
+    const int count = static_cast<int>(mesh_scratch_.size()) / kMeshFloatsPerVertex;
+    // Vertices up to here hold old triangles or garbage and are zeroed.
+    int stale_end = tsdf->mesh_count;
+    if (count > tsdf->mesh_capacity) {
+        ReleaseBlockMesh(tsdf);
+        // Half again as much, in whole triangles, so a growing surface is
+        // usually rewritten in place.
+        tsdf->mesh_offset = mesh_vertex_count_;
+        tsdf->mesh_capacity = count + count / 6 * 3;
+        mesh_vertex_count_ += tsdf->mesh_capacity;
+        const size_t needed = static_cast<size_t>(mesh_vertex_count_) * kMeshFloatsPerVertex;
+        if (mesh_vertices_.size() < needed) {
+            mesh_vertices_.resize(needed + needed / 2);
+        }
+        stale_end = tsdf->mesh_capacity;
+    }
+    float* span = mesh_vertices_.data() + static_cast<size_t>(tsdf->mesh_offset) * kMeshFloatsPerVertex;
+    if (count > 0) {
+        memcpy(span, mesh_scratch_.data(), mesh_scratch_.size() * sizeof(float));
+    }
+    if (stale_end > count) {
+        memset(span + static_cast<size_t>(count) * kMeshFloatsPerVertex, 0,
+               static_cast<size_t>(stale_end - count) * kMeshFloatsPerVertex * sizeof(float));
+    }
+    mesh_live_vertices_ += count - tsdf->mesh_count;
+    tsdf->mesh_count = count;
+    MarkMeshChanged(tsdf->mesh_offset, tsdf->mesh_offset + std::max(count, stale_end));
+}
+
+void DepthMapper::ReleaseBlockMesh(TsdfBlock* tsdf) {
+    if (tsdf->mesh_capacity == 0) return;
+    mesh_live_vertices_ -= tsdf->mesh_count;
+    if (tsdf->mesh_offset + tsdf->mesh_capacity == mesh_vertex_count_) {
+        // The last span just shortens the array.
+        mesh_vertex_count_ = tsdf->mesh_offset;
+        mesh_dirty_ = true;
+    } else {
+        memset(mesh_vertices_.data() + static_cast<size_t>(tsdf->mesh_offset) * kMeshFloatsPerVertex, 0,
+               static_cast<size_t>(tsdf->mesh_count) * kMeshFloatsPerVertex * sizeof(float));
+        MarkMeshChanged(tsdf->mesh_offset, tsdf->mesh_offset + tsdf->mesh_count);
+        mesh_wasted_vertices_ += tsdf->mesh_capacity;
+    }
+    tsdf->mesh_offset = 0;
+    tsdf->mesh_capacity = 0;
+    tsdf->mesh_count = 0;
+}
+
+void DepthMapper::CompactMesh() {
+    mesh_scratch_.resize(static_cast<size_t>(mesh_vertex_count_ - mesh_wasted_vertices_) * kMeshFloatsPerVertex);
+    int offset = 0;
+    for (TsdfBlock& tsdf : tsdf_blocks_) {
+        if (tsdf.mesh_capacity == 0) continue;
+        memcpy(mesh_scratch_.data() + static_cast<size_t>(offset) * kMeshFloatsPerVertex,
+               mesh_vertices_.data() + static_cast<size_t>(tsdf.mesh_offset) * kMeshFloatsPerVertex,
+               static_cast<size_t>(tsdf.mesh_capacity) * kMeshFloatsPerVertex * sizeof(float));
+        tsdf.mesh_offset = offset;
+        offset += tsdf.mesh_capacity;
+    }
+    if (offset > 0) {
+        memcpy(mesh_vertices_.data(), mesh_scratch_.data(),
+               static_cast<size_t>(offset) * kMeshFloatsPerVertex * sizeof(float));
+    }
+    mesh_vertex_count_ = offset;
+    mesh_wasted_vertices_ = 0;
+    mesh_changed_.assign(1, SlotRange{0, offset});
+    mesh_dirty_ = true;
+}
+
+void DepthMapper::MarkMeshChanged(int begin, int end) {
+    if (begin >= end) return;
+    mesh_changed_.push_back(SlotRange{begin, end});
+    mesh_dirty_ = true;
+}
+
+const float* DepthMapper::GetMeshVertices(int* out_vertex_count, bool* out_dirty,
+                                          std::vector<SlotRange>* out_changed) {
+    if (fusion_mode_ != FusionMode::TSDF) {
+        if (out_vertex_count) *out_vertex_count = 0;
+        if (out_dirty) *out_dirty = false;
+        if (out_changed) out_changed->clear();
+        return nullptr;
+    }
+
+    for (int i = 0; i < static_cast<int>(tsdf_blocks_.size()); ++i) {
+        if (tsdf_blocks_[i].mesh_dirty) {
+            ExtractBlockMesh(i);
+        }
+    }
+    if (mesh_wasted_vertices_ * 2 > mesh_vertex_count_) {
+        CompactMesh();
+    }
+    stats_.mesh_triangles = mesh_live_vertices_ / 3;
+
+    if (out_vertex_count) *out_vertex_count = mesh_vertex_count_;
+    if (out_dirty) *out_dirty = mesh_dirty_;
+    TakeChanged(&mesh_changed_, mesh_vertex_count_, out_changed);
+    mesh_dirty_ = false;
+    return mesh_vertices_.data();
+}
+
+void DepthMapper::MarkRenderChanged(int slot) {
+    render_changed_.push_back(SlotRange{slot, slot + 1});
+    render_dirty_ = true;
+}
+
+int DepthMapper::FindRenderEntry(int owner) const {
+    uint32_t entry = HashOwner(owner) & render_table_mask_;
+    while (true) {
+        const int32_t slot = render_table_[entry];
+        if (slot < 0) return -1;
+        if (render_owner_[slot] == owner) return static_cast<int>(entry);
+        entry = (entry + 1) & render_table_mask_;
     }
+}
+
+void DepthMapper::InsertRenderEntry(int slot) {
+    uint32_t entry = HashOwner(render_owner_[slot]) & render_table_mask_;
+    while (render_table_[entry] >= 0) {
+        entry = (entry + 1) & render_table_mask_;
+    }
+    render_table_[entry] = slot;
+}
+
+void DepthMapper::EraseRenderEntry(uint32_t entry) {
+    BackwardShiftErase(&render_table_, render_table_mask_, entry,
+                       [this](int32_t slot) { return HashOwner(render_owner_[slot]); });
+}
+
+void DepthMapper::GrowRenderTable() {
+    const size_t new_size = render_table_.size() * 2;
+    render_table_.assign(new_size, -1);
+    render_table_mask_ = static_cast<uint32_t>(new_size - 1);
+    for (int slot = 0; slot < render_point_count_; ++slot) {
+        InsertRenderEntry(slot);
+    }
+}
+
+void DepthMapper::AddRenderPoint(int block_index, int voxel_index) {
+    VoxelBlock& block = blocks_[block_index];
+    const int slot = render_point_count_;
+    if (static_cast<int>(render_owner_.size()) <= slot) {
+        const size_t grown = std::max<size_t>(4096, render_owner_.size() * 2);
+        render_owner_.resize(grown);
+        render_points_.resize(grown * 3);
+    }
+    if (static_cast<size_t>(slot + 1) * 2 > render_table_.size()) {
+        GrowRenderTable();
+    }
+
+    const int lx = voxel_index & kBlockMask;
+    const int ly = (voxel_index >> kBlockShift) & kBlockMask;
+    const int lz = voxel_index >> (2 * kBlockShift);
+    float* out = render_points_.data() + slot * 3;
+    out[0] = (static_cast<float>(block.coord[0] * kBlockDim + lx) + 0.5f) * voxel_size_;
+    out[1] = (static_cast<float>(block.coord[1] * kBlockDim + ly) + 0.5f) * voxel_size_;
+    out[2] = (static_cast<float>(block.coord[2] * kBlockDim + lz) + 0.5f) * voxel_size_;
+    render_owner_[slot] = block_index * kBlockVoxels + voxel_index;
+    InsertRenderEntry(slot);
+    render_point_count_++;
+    MarkRenderChanged(slot);
+}
+
+void DepthMapper::RemoveRenderPoint(int block_index, int voxel_index) {
+    const int entry = FindRenderEntry(block_index * kBlockVoxels + voxel_index);
+    if (entry < 0) return;
+    const int slot = render_table_[entry];
+    EraseRenderEntry(static_cast<uint32_t>(entry));
+
+    const int last = render_point_count_ - 1;
+    if (slot != last) {
+        const int owner = render_owner_[last];
+        const int moved_entry = FindRenderEntry(owner);
+        memcpy(render_points_.data() + slot * 3, render_points_.data() + last * 3, sizeof(float) * 3);
+        render_owner_[slot] = owner;
+        if (moved_entry >= 0) {
+            render_table_[moved_entry] = slot;
+        }
+        MarkRenderChanged(slot);
+    }
+    render_point_count_--;
+    render_dirty_ = true;
+}
+
+const float* DepthMapper::GetRenderPoints(int* out_count, bool* out_dirty,
+                                          std::vector<SlotRange>* out_changed) {
     if (out_count) *out_count = render_point_count_;
-    if (out_dirty) *out_dirty = was_dirty;
+    if (out_dirty) *out_dirty = render_dirty_;
+    TakeChanged(&render_changed_, render_point_count_, out_changed);
+    render_dirty_ = false;
     return render_points_.data();
 }
@@ -1,54 +1,213 @@
 #ifndef SLAMTORCH_DEPTH_MAPPER_H
 #define SLAMTORCH_DEPTH_MAPPER_H
 
-#include "DepthFrame.h"
+#include "DepthPreprocessor.h"
+#include "DepthRayCache.h"
+#include "SlotRange.h"
 #include <cstdint>
 #include <vector>
 
+// Sparse voxel map fused from depth frames. In OCCUPANCY mode each depth
+// sample adds log-odds hit evidence at its endpoint and, within a per-frame
+// step budget, miss evidence along the ray in front of it so stale surfaces
+// fade out. In TSDF mode samples update a truncated signed distance and weight
+// in a band around the surface, and a triangle mesh is extracted with marching
+// cubes from the blocks touched since the last extraction.
+//
+// Voxels live in 8^3 blocks that are allocated on first hit and looked up
+// through an open-addressing hash table keyed by integer block coordinate, so
+// memory follows observed surface rather than mapped volume. Only blocks inside
+// a cube window around the camera are kept; when the camera walks far enough
+// the window scrolls and just the blocks that fall out of it are evicted.
 class DepthMapper {
 public:
+    enum class FusionMode { OCCUPANCY, TSDF };
+
     struct Stats {
         int voxels_used = 0;
+        int blocks_used = 0;
         int points_fused_last_frame = 0;
+        int voxels_freed_last_frame = 0;
+        int rays_carved_last_frame = 0;
+        int mesh_triangles = 0;
         float min_depth_m = 0.0f;
         float max_depth_m = 0.0f;
     };
 
-    static constexpr int kGridDim = 96;
-    static constexpr float kVoxelSize = 0.10f;
+    static constexpr int kBlockDim = 8;
+    static constexpr int kBlockVoxels = kBlockDim * kBlockDim * kBlockDim;
+    static constexpr float kDefaultVoxelSize = 0.05f;
+    static constexpr float kWindowHalfExtent = 4.8f;
+    static constexpr int kMaxBlocks = 32768;
+    static constexpr int kMeshFloatsPerVertex = 6;
+    // Changed points or vertices are reported as at most kMaxChangedRanges
+    // ranges, merged from kChangedMergeGap apart.
+    static constexpr int kMaxChangedRanges = 16;
+    static constexpr int kChangedMergeGap = 64;
 
-    DepthMapper();
+    explicit DepthMapper(float voxel_size = kDefaultVoxelSize);
 
     void Reset();
     void SetEnabled(bool enabled) { enabled_ = enabled; }
     bool IsEnabled() const { return enabled_; }
+    float GetVoxelSize() const { return voxel_size_; }
+    void SetWindowHalfExtent(float half_extent_m);
+    // Free space is only carved along the last max_distance_m of each ray;
+    // zero disables carving.
+    void SetMaxCarveDistance(float max_distance_m) { max_carve_distance_m_ = max_distance_m; }
+    // Switching modes starts the map over.
+    void SetFusionMode(FusionMode mode);
+    FusionMode GetFusionMode() const { return fusion_mode_; }
 
-    void Update(const DepthFrame& frame,
-                float fx, float fy, float cx, float cy,
-                int image_width, int image_height,
-                const float* world_from_camera);
+    // Samples the preprocessed depth at pyramid level kSampleLevel. rays must
+    // have been updated for this frame's depth resolution.
+    void Update(const DepthPreprocessor& depth, const DepthRayCache& rays, const float* world_from_camera);
 
-    const float* GetRenderPoints(int* out_count, bool* out_dirty);
+    // Render points are patched in place as voxels become occupied or freed.
+    // out_changed receives the sorted ranges (at most kMaxChangedRanges, all
+    // below out_count) that need re-uploading; points past out_count are stale
+    // and must be ignored.
+    const float* GetRenderPoints(int* out_count, bool* out_dirty,
+                                 std::vector<SlotRange>* out_changed = nullptr);
+    // TSDF mode only: non-indexed triangles, kMeshFloatsPerVertex floats
+    // (position, normal) per vertex. Re-meshes dirty blocks before returning.
+    // Each block keeps its own span of vertices, so out_changed only covers the
+    // blocks re-meshed or freed since the last call; unused vertices are zero
+    // and draw as degenerate triangles.
+    const float* GetMeshVertices(int* out_vertex_count, bool* out_dirty,
+                                 std::vector<SlotRange>* out_changed = nullptr);
     const Stats& GetStats() const { return stats_; }
 
 private:
+    struct VoxelBlock {
+        int coord[3];
+        int occupied_count;
+        // Fixed-point log-odds (0.1 per unit); 0 is unknown, > kLogOddsOccupied
+        // counts as occupied.
+        int8_t log_odds[kBlockVoxels];
+    };
+
+    // Per-block TSDF data, kept in tsdf_blocks_ parallel to blocks_ and only
+    // allocated in TSDF mode.
+    struct TsdfBlock {
+        // Signed distance normalised by the truncation band, scaled to
+        // +-kSdfScale. Positive is in front of the surface.
+        int16_t sdf[kBlockVoxels];
+        uint8_t weight[kBlockVoxels];
+        bool mesh_dirty;
+        // Vertices [mesh_offset, mesh_offset + mesh_capacity) of mesh_vertices_
+        // belong to this block; those past mesh_count are zero.
+        int mesh_offset;
+        int mesh_capacity;
+        int mesh_count;
+    };
+
     void RecenterIfNeeded(const float* world_from_camera);
-    void RebuildRenderPoints();
+
+    struct BlockCache {
+        bool valid = false;
+        int index = -1;
+        int coord[3] = {0, 0, 0};
+    };
+
+    int LookupBlockCached(int bx, int by, int bz, bool allocate, BlockCache* cache);
+    void ApplyLogOdds(int block_index, int voxel_index, int delta);
+    void IntegrateHits();
+    void CarveFreeSpace(const float* camera_position);
+    void IntegrateTsdf(const float* camera_position);
+    void MarkMeshDirty(int block_index, int voxel_index);
+    void ExtractBlockMesh(int block_index);
+    void PlaceBlockMesh(TsdfBlock* tsdf);
+    void ReleaseBlockMesh(TsdfBlock* tsdf);
+    void CompactMesh();
+    void MarkMeshChanged(int begin, int end);
+    void AddRenderPoint(int block_index, int voxel_index);
+    void RemoveRenderPoint(int block_index, int voxel_index);
+    void MarkRenderChanged(int slot);
+    int FindRenderEntry(int owner) const;
+    void InsertRenderEntry(int slot);
+    void EraseRenderEntry(uint32_t entry);
+    void GrowRenderTable();
+    void ClearBlocks();
+    void EvictLeavingBlocks(const int* old_center, const int* new_center);
+    void RemoveBlock(int block_index);
+    bool IsBlockInWindow(int bx, int by, int bz) const;
+    int FindSlot(int bx, int by, int bz) const;
+    int FindBlock(int bx, int by, int bz) const;
+    void EraseSlot(uint32_t slot);
+    int FindOrAllocateBlock(int bx, int by, int bz);
+    void InsertIntoTable(int block_index);
+    void GrowTable();
+    static uint32_t HashOwner(int owner);
+
     static constexpr float kMinDepthM = 0.2f;
     static constexpr float kMaxDepthM = 6.0f;
-    static constexpr uint8_t kOccupancyIncrement = 8;
-    static constexpr uint8_t kOccupancyMax = 255;
-    static constexpr int kConfidenceThreshold = 128;
+    static constexpr int kLogOddsHit = 9;
+    static constexpr int kLogOddsMiss = -4;
+    static constexpr int kLogOddsMin = -20;
+    static constexpr int kLogOddsMax = 35;
+    static constexpr int kLogOddsOccupied = 0;
+    static constexpr float kDefaultMaxCarveDistance = 2.0f;
+    static constexpr int kMaxCarveStepsPerFrame = 32768;
+    static constexpr float kTruncationVoxels = 3.0f;
+    static constexpr int kSdfScale = 32767;
+    static constexpr int kMaxTsdfWeight = 64;
+    static constexpr int kMaxTsdfStepsPerFrame = 32768;
+    // One averaged sample per 4x4 depth pixels.
+    static constexpr int kSampleLevel = 2;
+    static constexpr int kInitialTableSize = 1024;
+    static constexpr int kInitialRenderTableSize = 8192;
 
+    float voxel_size_ = kDefaultVoxelSize;
+    float inv_voxel_size_ = 1.0f / kDefaultVoxelSize;
     bool enabled_ = true;
     bool origin_set_ = false;
-    float origin_[3] = {0.0f, 0.0f, 0.0f};
+    int window_center_[3] = {0, 0, 0};
+    int window_half_blocks_ = 1;
     int voxels_used_ = 0;
     bool render_dirty_ = false;
+    float max_carve_distance_m_ = kDefaultMaxCarveDistance;
+    FusionMode fusion_mode_ = FusionMode::OCCUPANCY;
+    // Where the next frame's ray batch starts when a step budget cut it short.
+    int ray_cursor_ = 0;
+    // World-space endpoints of this frame's accepted samples (xyz).
+    std::vector<float> pending_hits_;
+    // Pyramid columns sampled per row, column and row rays (refreshed when the
+    // ray cache generation changes) and this row's depths.
+    std::vector<int> sample_columns_;
+    std::vector<float> column_rays_;
+    std::vector<float> row_rays_;
+    std::vector<float> row_depths_;
+    int ray_generation_ = -1;
+
+    std::vector<VoxelBlock> blocks_;
+    // Slot -> index into blocks_, -1 when empty. Size is a power of two and
+    // kept at most half full so linear probes stay short.
+    std::vector<int32_t> table_;
+    uint32_t table_mask_ = 0;
 
-    std::vector<uint8_t> occupancy_;
     std::vector<float> render_points_;
+    // Slot -> block_index * kBlockVoxels + voxel_index, used by swap-remove to
+    // fix up the voxel whose point moves into the freed slot.
+    std::vector<int32_t> render_owner_;
+    // Entry -> render slot, -1 when empty, keyed by the slot's owner. Only
+    // occupied voxels have an entry, so finding a voxel's point costs memory
+    // per point rather than per voxel. Kept at most half full like table_.
+    std::vector<int32_t> render_table_;
+    uint32_t render_table_mask_ = 0;
     int render_point_count_ = 0;
+    std::vector<SlotRange> render_changed_;
+
+    std::vector<TsdfBlock> tsdf_blocks_;
+    // Block spans back to back. Spans a block outgrew or gave up are zeroed
+    // and counted as wasted until CompactMesh() packs the live ones again.
+    std::vector<float> mesh_vertices_;
+    std::vector<float> mesh_scratch_;
+    int mesh_vertex_count_ = 0;
+    int mesh_live_vertices_ = 0;
+    int mesh_wasted_vertices_ = 0;
+    std::vector<SlotRange> mesh_changed_;
+    bool mesh_dirty_ = false;
 
     Stats stats_;
 };
@@ -0,0 +1,151 @@
+#include "DepthMeshBuilder.h"
+#include "DepthBackProjector.h"
+#include <algorithm>
+#include <cmath>
+
+void DepthMeshBuilder::Initialize(int grid_width, int grid_height) {
+    grid_width_ = std::max(2, grid_width);
+    grid_height_ = std::max(2, grid_height);
+    vertices_.assign(static_cast<size_t>(grid_width_) * grid_height_, Vertex{});
+    ray_generation_ = -1;
+    Clear();
+}
+
+void DepthMeshBuilder::Update(const DepthPreprocessor& depth,
+                              const DepthRayCache& rays,
+                              const float* world_from_camera,
+                              float min_depth_m,
+                              float max_depth_m) {
+    if (vertices_.empty() || !depth.IsValid() ||
+        rays.GetDepthWidth() != depth.GetWidth() || rays.GetDepthHeight() != depth.GetHeight()) {
+        has_mesh_ = false;
+        valid_ratio_ = 0.0f;
+        return;
+    }
+
+    const DepthPreprocessor::Level& level = depth.GetLevel(0);
+    if (rays.GetGeneration() != ray_generation_) {
+        ray_generation_ = rays.GetGeneration();
+        const float step_x = (level.width - 1) / static_cast<float>(grid_width_ - 1);
+        const float step_y = (level.height - 1) / static_cast<float>(grid_height_ - 1);
+        sample_columns_.resize(static_cast<size_t>(grid_width_));
+        sample_rows_.resize(static_cast<size_t>(grid_height_));
+        column_rays_.resize(static_cast<size_t>(grid_width_));
+        row_depths_.resize(static_cast<size_t>(grid_width_));
+        row_points_.resize(static_cast<size_t>(grid_width_) * 3);
+        for (int x = 0; x < grid_width_; ++x) {
+            sample_columns_[x] = static_cast<int>(std::round(x * step_x));
+            column_rays_[x] = rays.GetColumnRays()[sample_columns_[x]];
+        }
+        for (int y = 0; y < grid_height_; ++y) {
+            sample_rows_[y] = static_cast<int>(std::round(y * step_y));
+        }
+    }
+
+    int valid_count = 0;
+    const int vertex_count = grid_width_ * grid_height_;
+
+    for (int y = 0; y < grid_height_; ++y) {
+        const int sample_y = sample_rows_[y];
+        valid_count += DepthBackProjector::SampleRow(level.depth_m + static_cast<size_t>(sample_y) * level.width,
+                                                     sample_columns_.data(), grid_width_,
+                                                     min_depth_m, max_depth_m, row_depths_.data());
+        DepthBackProjector::ProjectRow(column_rays_.data(), rays.GetRowRays()[sample_y],
+                                       row_depths_.data(), grid_width_, world_from_camera, row_points_.data());
+
+        for (int x = 0; x < grid_width_; ++x) {
+            Vertex& vtx = vertices_[static_cast<size_t>(y * grid_width_ + x)];
+            if (row_depths_[x] <= 0.0f) {
+                vtx.position[0] = 0.0f;
+                vtx.position[1] = 0.0f;
+                vtx.position[2] = 0.0f;
+                vtx.normal[0] = 0.0f;
+                vtx.normal[1] = 1.0f;
+                vtx.normal[2] = 0.0f;
+                vtx.alpha = 0.0f;
+                vtx.padding = 0.0f;
+                continue;
+            }
+            vtx.position[0] = row_points_[x * 3 + 0];
+            vtx.position[1] = row_points_[x * 3 + 1];
+            vtx.position[2] = row_points_[x * 3 + 2];
+            vtx.alpha = 1.0f;
+            vtx.padding = 0.0f;
+        }
+    }
+
+    for (int y = 0; y < grid_height_; ++y) {
+        for (int x = 0; x < grid_width_; ++x) {
+            const int index = y * grid_width_ + x;
+            Vertex& vtx = vertices_[static_cast<size_t>(index)];
+            if (vtx.alpha < 0.5f) {
+                vtx.normal[0] = 0.0f;
+                vtx.normal[1] = 1.0f;
+                vtx.normal[2] = 0.0f;
+                continue;
+            }
+
+            const int right_index = index + 1;
+            const int down_index = index + grid_width_;
+            if (x >= grid_width_ - 1 || y >= grid_height_ - 1) {
+                vtx.normal[0] = 0.0f;
+                vtx.normal[1] = 1.0f;
+                vtx.normal[2] = 0.0f;
+                continue;
+            }
+
+            const Vertex& right = vertices_[static_cast<size_t>(right_index)];
+            const Vertex& down = vertices_[static_cast<size_t>(down_index)];
+            if (right.alpha < 0.5f || down.alpha < 0.5f) {
+                vtx.normal[0] = 0.0f;
+                vtx.normal[1] = 1.0f;
+                vtx.normal[2] = 0.0f;
+                continue;
+            }
+
+            float vx[3] = {
+                right.position[0] - vtx.position[0],
+                right.position[1] - vtx.position[1],
+                right.position[2] - vtx.position[2]
+            };
+            float vy[3] = {
+                down.position[0] - vtx.position[0],
+                down.position[1] - vtx.position[1],
+                down.position[2] - vtx.position[2]
+            };
+
+            float normal[3] = {
+                vx[1] * vy[2] - vx[2] * vy[1],
+                vx[2] * vy[0] - vx[0] * vy[2],
+                vx[0] * vy[1] - vx[1] * vy[0]
+            };
+            Normalize(normal);
+            vtx.normal[0] = normal[0];
+            vtx.normal[1] = normal[1];
+            vtx.normal[2] = normal[2];
+        }
+    }
+
+    valid_ratio_ = vertex_count > 0
+        ? static_cast<float>(valid_count) / static_cast<float>(vertex_count)
+        : 0.0f;
+    has_mesh_ = valid_count > 0;
+}
+
+void DepthMeshBuilder::Clear() {
+    valid_ratio_ = 0.0f;
+    has_mesh_ = false;
+}
+
+void DepthMeshBuilder::Normalize(float* v) {
+    const float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len > 1e-5f) {
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
+    } else {
+        v[0] = 0.0f;
+        v[1] = 1.0f;
+        v[2] = 0.0f;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SLAMTORCH_DEPTH_MESH_BUILDER_H
+#define SLAMTORCH_DEPTH_MESH_BUILDER_H
+
+#include <vector>
+#include "DepthPreprocessor.h"
+#include "DepthRayCache.h"
+
+// CPU side of the live depth mesh: back-projects a regular grid of depth
+// samples to world space and computes per-vertex normals. Needs no GL context,
+// so it runs on the frame pipeline worker; DepthMeshRenderer uploads the result.
+class DepthMeshBuilder {
+public:
+    struct Vertex {
+        float position[3];
+        float normal[3];
+        float alpha;
+        float padding; // Keep 4-float alignment.
+    };
+
+    void Initialize(int grid_width, int grid_height);
+    void Update(const DepthPreprocessor& depth,
+                const DepthRayCache& rays,
+                const float* world_from_camera,
+                float min_depth_m,
+                float max_depth_m);
+    void Clear();
+
+    const Vertex* GetVertices() const { return vertices_.data(); }
+    int GetVertexCount() const { return static_cast<int>(vertices_.size()); }
+    float GetValidRatio() const { return valid_ratio_; }
+    int GetGridWidth() const { return grid_width_; }
+    int GetGridHeight() const { return grid_height_; }
+    bool HasMesh() const { return has_mesh_; }
+
+private:
+    static void Normalize(float* v);
+
+    std::vector<Vertex> vertices_;
+
+    // Per-row back-projection scratch, one entry per grid column. Sample
+    // positions and their rays follow the ray cache generation.
+    std::vector<int> sample_columns_;
+    std::vector<int> sample_rows_;
+    std::vector<float> column_rays_;
+    std::vector<float> row_depths_;
+    std::vector<float> row_points_;
+    int ray_generation_ = -1;
+
+    int grid_width_ = 0;
+    int grid_height_ = 0;
+    float valid_ratio_ = 0.0f;
+    bool has_mesh_ = false;
+};
+
+#endif // SLAMTORCH_DEPTH_MESH_BUILDER_H
@@ -1,7 +1,6 @@
 #include "DepthMeshRenderer.h"
 #include "AndroidOut.h"
 #include <algorithm>
-#include <cmath>
 #include <cstddef>
 
 namespace {
@@ -74,7 +73,6 @@ void DepthMeshRenderer::Initialize(int grid_width, int grid_height) {
     grid_height_ = std::max(2, grid_height);
 
     const int vertex_count = grid_width_ * grid_height_;
-    vertices_.resize(static_cast<size_t>(vertex_count));
 
     triangle_indices_.reserve(static_cast<size_t>((grid_width_ - 1) * (grid_height_ - 1) * 6));
     for (int y = 0; y < grid_height_ - 1; ++y) {
@@ -172,7 +170,7 @@ void DepthMeshRenderer::Initialize(int grid_width, int grid_height) {
 
     glGenBuffers(1, &vertex_buffer_);
     glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
 
     glGenBuffers(1, &triangle_index_buffer_);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, triangle_index_buffer_);
@@ -191,168 +189,15 @@ void DepthMeshRenderer::Initialize(int grid_width, int grid_height) {
     aout << "DepthMeshRenderer initialized: " << grid_width_ << "x" << grid_height_ << std::endl;
 }
 
-void DepthMeshRenderer::Update(const DepthFrame& depth_frame,
-                               int camera_image_width,
-                               int camera_image_height,
-                               float fx,
-                               float fy,
-                               float cx,
-                               float cy,
-                               const float* world_from_camera,
-                               float min_depth_m,
-                               float max_depth_m) {
-    if (!initialized_ || depth_frame.width <= 0 || depth_frame.height <= 0 ||
-        camera_image_width <= 0 || camera_image_height <= 0 || !depth_frame.depth_data) {
+void DepthMeshRenderer::Upload(const DepthMeshBuilder::Vertex* vertices, int vertex_count) {
+    if (!initialized_ || !vertices || vertex_count != grid_width_ * grid_height_) {
         has_mesh_ = false;
-        valid_ratio_ = 0.0f;
         return;
     }
-
-    const float scale_x = static_cast<float>(depth_frame.width) / static_cast<float>(camera_image_width);
-    const float scale_y = static_cast<float>(depth_frame.height) / static_cast<float>(camera_image_height);
-    const float fx_depth = fx * scale_x;
-    const float fy_depth = fy * scale_y;
-    const float cx_depth = cx * scale_x;
-    const float cy_depth = cy * scale_y;
-
-    const float step_x = (depth_frame.width - 1) / static_cast<float>(grid_width_ - 1);
-    const float step_y = (depth_frame.height - 1) / static_cast<float>(grid_height_ - 1);
-
-    int valid_count = 0;
-    const int vertex_count = grid_width_ * grid_height_;
-
-    for (int y = 0; y < grid_height_; ++y) {
-        const int sample_y = static_cast<int>(std::round(y * step_y));
-        const uint8_t* depth_row = reinterpret_cast<const uint8_t*>(depth_frame.depth_data) +
-                                   depth_frame.row_stride * sample_y;
-        const uint8_t* conf_row = depth_frame.confidence_data
-            ? depth_frame.confidence_data + depth_frame.confidence_row_stride * sample_y
-            : nullptr;
-
-        for (int x = 0; x < grid_width_; ++x) {
-            const int sample_x = static_cast<int>(std::round(x * step_x));
-            const uint16_t* depth_pixel = reinterpret_cast<const uint16_t*>(
-                depth_row + depth_frame.pixel_stride * sample_x);
-            const uint16_t depth_mm = *depth_pixel;
-
-            const int vertex_index = y * grid_width_ + x;
-            Vertex& vtx = vertices_[static_cast<size_t>(vertex_index)];
-
-            bool valid = depth_mm != 0;
-            float depth_m = static_cast<float>(depth_mm) * 0.001f;
-
-            if (valid) {
-                if (depth_m < min_depth_m || depth_m > max_depth_m) {
-                    valid = false;
-                }
-            }
-
-            if (valid && conf_row) {
-                const uint8_t* conf_pixel = conf_row + depth_frame.confidence_pixel_stride * sample_x;
-                const uint8_t confidence = *conf_pixel;
-                if (confidence < 128) {
-                    valid = false;
-                }
-            }
-
-            if (!valid) {
-                vtx.position[0] = 0.0f;
-                vtx.position[1] = 0.0f;
-                vtx.position[2] = 0.0f;
-                vtx.normal[0] = 0.0f;
-                vtx.normal[1] = 1.0f;
-                vtx.normal[2] = 0.0f;
-                vtx.alpha = 0.0f;
-                vtx.padding = 0.0f;
-                continue;
-            }
-
-            const float x_cam = (static_cast<float>(sample_x) - cx_depth) * depth_m / fx_depth;
-            const float y_cam = (static_cast<float>(sample_y) - cy_depth) * depth_m / fy_depth;
-            const float z_cam = -depth_m;
-
-            const float world_x = world_from_camera[0] * x_cam +
-                                  world_from_camera[4] * y_cam +
-                                  world_from_camera[8] * z_cam +
-                                  world_from_camera[12];
-            const float world_y = world_from_camera[1] * x_cam +
-                                  world_from_camera[5] * y_cam +
-                                  world_from_camera[9] * z_cam +
-                                  world_from_camera[13];
-            const float world_z = world_from_camera[2] * x_cam +
-                                  world_from_camera[6] * y_cam +
-                                  world_from_camera[10] * z_cam +
-                                  world_from_camera[14];
-
-            vtx.position[0] = world_x;
-            vtx.position[1] = world_y;
-            vtx.position[2] = world_z;
-            vtx.alpha = 1.0f;
-            vtx.padding = 0.0f;
-            valid_count++;
-        }
-    }
-
-    for (int y = 0; y < grid_height_; ++y) {
-        for (int x = 0; x < grid_width_; ++x) {
-            const int index = y * grid_width_ + x;
-            Vertex& vtx = vertices_[static_cast<size_t>(index)];
-            if (vtx.alpha < 0.5f) {
-                vtx.normal[0] = 0.0f;
-                vtx.normal[1] = 1.0f;
-                vtx.normal[2] = 0.0f;
-                continue;
-            }
-
-            const int right_index = index + 1;
-            const int down_index = index + grid_width_;
-            if (x >= grid_width_ - 1 || y >= grid_height_ - 1) {
-                vtx.normal[0] = 0.0f;
-                vtx.normal[1] = 1.0f;
-                vtx.normal[2] = 0.0f;
-                continue;
-            }
-
-            const Vertex& right = vertices_[static_cast<size_t>(right_index)];
-            const Vertex& down = vertices_[static_cast<size_t>(down_index)];
-            if (right.alpha < 0.5f || down.alpha < 0.5f) {
-                vtx.normal[0] = 0.0f;
-                vtx.normal[1] = 1.0f;
-                vtx.normal[2] = 0.0f;
-                continue;
-            }
-
-            float vx[3] = {
-                right.position[0] - vtx.position[0],
-                right.position[1] - vtx.position[1],
-                right.position[2] - vtx.position[2]
-            };
-            float vy[3] = {
-                down.position[0] - vtx.position[0],
-                down.position[1] - vtx.position[1],
-                down.position[2] - vtx.position[2]
-            };
-
-            float normal[3] = {
-                vx[1] * vy[2] - vx[2] * vy[1],
-                vx[2] * vy[0] - vx[0] * vy[2],
-                vx[0] * vy[1] - vx[1] * vy[0]
-            };
-            Normalize(normal);
-            vtx.normal[0] = normal[0];
-            vtx.normal[1] = normal[1];
-            vtx.normal[2] = normal[2];
-        }
-    }
-
     glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices_.size() * sizeof(Vertex), vertices_.data());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count * sizeof(Vertex), vertices);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    valid_ratio_ = vertex_count > 0
-        ? static_cast<float>(valid_count) / static_cast<float>(vertex_count)
-        : 0.0f;
-    has_mesh_ = valid_count > 0;
+    has_mesh_ = true;
 }
 
 void DepthMeshRenderer::Draw(const float* view_matrix, const float* projection_matrix, bool wireframe) const {
@@ -398,7 +243,6 @@ void DepthMeshRenderer::Draw(const float* view_matrix, const float* projection_m
 }
 
 void DepthMeshRenderer::Clear() {
-    valid_ratio_ = 0.0f;
     has_mesh_ = false;
 }
 
@@ -412,16 +256,3 @@ void DepthMeshRenderer::MultiplyMatrix(float* out, const float* a, const float*
         }
     }
 }
-
-void DepthMeshRenderer::Normalize(float* v) {
-    const float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
-    if (len > 1e-5f) {
-        v[0] /= len;
-        v[1] /= len;
-        v[2] /= len;
-    } else {
-        v[0] = 0.0f;
-        v[1] = 1.0f;
-        v[2] = 0.0f;
-    }
-}
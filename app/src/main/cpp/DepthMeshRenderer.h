@@ -3,7 +3,7 @@
 
 #include <GLES3/gl3.h>
 #include <vector>
-#include "DepthFrame.h"
+#include "DepthMeshBuilder.h"
 
 class DepthMeshRenderer {
 public:
@@ -11,34 +11,19 @@ public:
     ~DepthMeshRenderer();
 
     void Initialize(int grid_width, int grid_height);
-    void Update(const DepthFrame& depth_frame,
-                int camera_image_width,
-                int camera_image_height,
-                float fx,
-                float fy,
-                float cx,
-                float cy,
-                const float* world_from_camera,
-                float min_depth_m,
-                float max_depth_m);
+    // Uploads a grid built by DepthMeshBuilder with the same dimensions.
+    void Upload(const DepthMeshBuilder::Vertex* vertices, int vertex_count);
     void Draw(const float* view_matrix, const float* projection_matrix, bool wireframe) const;
     void Clear();
 
-    float GetValidRatio() const { return valid_ratio_; }
     int GetGridWidth() const { return grid_width_; }
     int GetGridHeight() const { return grid_height_; }
     bool HasMesh() const { return has_mesh_; }
 
 private:
-    struct Vertex {
-        float position[3];
-        float normal[3];
-        float alpha;
-        float padding; // Keep 4-float alignment.
-    };
+    using Vertex = DepthMeshBuilder::Vertex;
 
     static void MultiplyMatrix(float* out, const float* a, const float* b);
-    static void Normalize(float* v);
 
     GLuint shader_program_ = 0;
     GLuint vertex_buffer_ = 0;
@@ -50,7 +35,6 @@ private:
     GLint color_uniform_ = -1;
     GLint alpha_uniform_ = -1;
 
-    std::vector<Vertex> vertices_;
     std::vector<uint16_t> triangle_indices_;
     std::vector<uint16_t> line_indices_;
 
@@ -59,7 +43,6 @@ private:
     int triangle_index_count_ = 0;
     int line_index_count_ = 0;
 
-    float valid_ratio_ = 0.0f;
     bool initialized_ = false;
     bool has_mesh_ = false;
 };
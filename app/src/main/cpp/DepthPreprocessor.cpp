@@ -0,0 +1,112 @@
+#include "DepthPreprocessor.h"
+#include <algorithm>
+
+namespace {
+constexpr float kDefaultVisMinM = 0.2f;
+constexpr float kDefaultVisMaxM = 6.0f;
+// Within a 2x2 block, samples more than this factor behind the nearest one
+// belong to another surface and are left out of the average.
+constexpr float kDownsampleDepthRatio = 1.1f;
+}
+
+void DepthPreprocessor::Clear() {
+    valid_ = false;
+    has_visualization_ = false;
+    min_depth_m_ = 0.0f;
+    max_depth_m_ = 0.0f;
+}
+
+void DepthPreprocessor::Process(const DepthFrame& frame, bool build_visualization) {
+    if (!frame.depth_data || frame.width <= 0 || frame.height <= 0) {
+        Clear();
+        return;
+    }
+
+    const float vis_min = (min_depth_m_ > 0.0f) ? min_depth_m_ : kDefaultVisMinM;
+    const float vis_max = (max_depth_m_ > vis_min) ? max_depth_m_ : kDefaultVisMaxM;
+    const float inv_range = 1.0f / std::max(0.001f, vis_max - vis_min);
+
+    for (int level = 0; level < kPyramidLevels; ++level) {
+        Level& info = levels_[level];
+        info.width = frame.width >> level;
+        info.height = frame.height >> level;
+        info.scale = 1 << level;
+        storage_[level].resize(static_cast<size_t>(info.width) * info.height);
+        info.depth_m = storage_[level].data();
+    }
+    const int width = frame.width;
+    if (build_visualization) {
+        visualization_.resize(static_cast<size_t>(width) * frame.height);
+    }
+
+    const uint8_t* confidence = (frame.confidence_data && frame.confidence_pixel_stride > 0)
+        ? frame.confidence_data
+        : nullptr;
+    float min_depth = 0.0f;
+    float max_depth = 0.0f;
+    for (int y = 0; y < frame.height; ++y) {
+        const uint8_t* row = reinterpret_cast<const uint8_t*>(frame.depth_data) + frame.row_stride * y;
+        const uint8_t* conf_row = confidence ? confidence + frame.confidence_row_stride * y : nullptr;
+        float* dst = storage_[0].data() + static_cast<size_t>(y) * width;
+        uint8_t* vis = build_visualization ? visualization_.data() + static_cast<size_t>(y) * width : nullptr;
+        for (int x = 0; x < width; ++x) {
+            const uint16_t depth_mm = *reinterpret_cast<const uint16_t*>(row + frame.pixel_stride * x);
+            float depth_m = static_cast<float>(depth_mm) * 0.001f;
+            if (conf_row && conf_row[frame.confidence_pixel_stride * x] < confidence_threshold_) {
+                depth_m = 0.0f;
+            }
+            dst[x] = depth_m;
+            if (depth_m <= 0.0f) {
+                if (vis) vis[x] = 0;
+                continue;
+            }
+            if (min_depth == 0.0f || depth_m < min_depth) min_depth = depth_m;
+            if (depth_m > max_depth) max_depth = depth_m;
+            if (vis) {
+                const float normalized = 1.0f - std::min(1.0f, std::max(0.0f, (depth_m - vis_min) * inv_range));
+                vis[x] = static_cast<uint8_t>(normalized * 255.0f);
+            }
+        }
+
+        // A pyramid row is complete as soon as both of its source rows are.
+        int source_row = y;
+        for (int level = 1; level < kPyramidLevels && (source_row & 1); ++level) {
+            source_row >>= 1;
+            if (source_row >= levels_[level].height) break;
+            DownsampleRow(level, source_row);
+        }
+    }
+
+    min_depth_m_ = min_depth;
+    max_depth_m_ = max_depth;
+    has_visualization_ = build_visualization;
+    valid_ = true;
+}
+
+void DepthPreprocessor::DownsampleRow(int level, int row) {
+    const Level& src = levels_[level - 1];
+    const float* top = src.depth_m + static_cast<size_t>(row * 2) * src.width;
+    const float* bottom = top + src.width;
+    float* dst = storage_[level].data() + static_cast<size_t>(row) * levels_[level].width;
+    for (int x = 0; x < levels_[level].width; ++x) {
+        const float samples[4] = {top[2 * x], top[2 * x + 1], bottom[2 * x], bottom[2 * x + 1]};
+        float nearest = 0.0f;
+        for (float d : samples) {
+            if (d > 0.0f && (nearest == 0.0f || d < nearest)) nearest = d;
+        }
+        if (nearest == 0.0f) {
+            dst[x] = 0.0f;
+            continue;
+        }
+        const float limit = nearest * kDownsampleDepthRatio;
+        float sum = 0.0f;
+        int count = 0;
+        for (float d : samples) {
+            if (d > 0.0f && d <= limit) {
+                sum += d;
+                count++;
+            }
+        }
+        dst[x] = sum / static_cast<float>(count);
+    }
+}
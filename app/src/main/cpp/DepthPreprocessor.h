@@ -0,0 +1,55 @@
+#ifndef SLAMTORCH_DEPTH_PREPROCESSOR_H
+#define SLAMTORCH_DEPTH_PREPROCESSOR_H
+
+#include "DepthFrame.h"
+#include <cstdint>
+#include <vector>
+
+// Walks each acquired depth frame once and keeps everything the depth
+// consumers need, so the ArImage can be released straight away:
+// - a metric float image (metres, 0 where missing or low confidence),
+// - a 2x-per-level pyramid of it built from the same row stream,
+// - the min/max valid depth,
+// - optionally the 8-bit debug visualization.
+class DepthPreprocessor {
+public:
+    static constexpr int kPyramidLevels = 3;
+    static constexpr int kDefaultConfidenceThreshold = 128;
+
+    struct Level {
+        int width = 0;
+        int height = 0;
+        // Level-0 pixels per pixel of this level.
+        int scale = 1;
+        const float* depth_m = nullptr;
+    };
+
+    void Process(const DepthFrame& frame, bool build_visualization);
+    void Clear();
+
+    bool IsValid() const { return valid_; }
+    const Level& GetLevel(int level) const { return levels_[level]; }
+    int GetWidth() const { return levels_[0].width; }
+    int GetHeight() const { return levels_[0].height; }
+    float GetMinDepth() const { return min_depth_m_; }
+    float GetMaxDepth() const { return max_depth_m_; }
+    // Near is bright. Scaled with the previous frame's depth range so it can be
+    // written in the same pass that measures this frame's range.
+    const uint8_t* GetVisualization() const { return has_visualization_ ? visualization_.data() : nullptr; }
+
+    void SetConfidenceThreshold(int threshold) { confidence_threshold_ = threshold; }
+
+private:
+    void DownsampleRow(int level, int row);
+
+    Level levels_[kPyramidLevels];
+    std::vector<float> storage_[kPyramidLevels];
+    std::vector<uint8_t> visualization_;
+    int confidence_threshold_ = kDefaultConfidenceThreshold;
+    float min_depth_m_ = 0.0f;
+    float max_depth_m_ = 0.0f;
+    bool valid_ = false;
+    bool has_visualization_ = false;
+};
+
+#endif // SLAMTORCH_DEPTH_PREPROCESSOR_H
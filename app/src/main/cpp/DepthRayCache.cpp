@@ -0,0 +1,52 @@
+#include "DepthRayCache.h"
+
+bool DepthRayCache::Update(float fx, float fy, float cx, float cy,
+                           int image_width, int image_height,
+                           int depth_width, int depth_height) {
+    if (fx == fx_ && fy == fy_ && cx == cx_ && cy == cy_ &&
+        image_width == image_width_ && image_height == image_height_ &&
+        depth_width == depth_width_ && depth_height == depth_height_) {
+        return false;
+    }
+    if (fx <= 0.0f || fy <= 0.0f) {
+        return false;
+    }
+
+    fx_ = fx;
+    fy_ = fy;
+    cx_ = cx;
+    cy_ = cy;
+    inv_fx_ = 1.0f / fx;
+    inv_fy_ = 1.0f / fy;
+    image_width_ = image_width;
+    image_height_ = image_height;
+    depth_width_ = depth_width;
+    depth_height_ = depth_height;
+    generation_++;
+    if (!IsValid()) {
+        depth_scale_x_ = 0.0f;
+        depth_scale_y_ = 0.0f;
+        column_rays_.clear();
+        row_rays_.clear();
+        return true;
+    }
+
+    const DepthBackProjector::Intrinsics depth = DepthBackProjector::ScaleToDepth(
+        fx, fy, cx, cy, image_width, image_height, depth_width, depth_height);
+    depth_scale_x_ = depth.fx / fx;
+    depth_scale_y_ = depth.fy / fy;
+
+    depth_cx_ = depth.cx;
+    depth_cy_ = depth.cy;
+    inv_depth_fx_ = 1.0f / depth.fx;
+    inv_depth_fy_ = 1.0f / depth.fy;
+    column_rays_.resize(depth_width);
+    row_rays_.resize(depth_height);
+    for (int x = 0; x < depth_width; ++x) {
+        column_rays_[x] = DepthColumnRay(static_cast<float>(x));
+    }
+    for (int y = 0; y < depth_height; ++y) {
+        row_rays_[y] = DepthRowRay(static_cast<float>(y));
+    }
+    return true;
+}
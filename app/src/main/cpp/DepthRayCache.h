@@ -0,0 +1,61 @@
+#ifndef SLAMTORCH_DEPTH_RAY_CACHE_H
+#define SLAMTORCH_DEPTH_RAY_CACHE_H
+
+#include "DepthBackProjector.h"
+#include <vector>
+
+// Back-projection rays for the depth image, rebuilt only when the depth
+// resolution or the camera intrinsics change. The pinhole model is separable,
+// so pixel (x, y) has ray (GetColumnRays()[x], GetRowRays()[y], -1) and a
+// sample with depth d sits at that ray scaled by d.
+class DepthRayCache {
+public:
+    // fx..cy are camera-image intrinsics. A zero depth size keeps only the
+    // camera rays. Returns true when anything changed.
+    bool Update(float fx, float fy, float cx, float cy,
+                int image_width, int image_height,
+                int depth_width, int depth_height);
+
+    bool IsValid() const { return depth_width_ > 0 && depth_height_ > 0; }
+    // Bumped on every rebuild so consumers can refresh derived tables.
+    int GetGeneration() const { return generation_; }
+    int GetDepthWidth() const { return depth_width_; }
+    int GetDepthHeight() const { return depth_height_; }
+    const float* GetColumnRays() const { return column_rays_.data(); }
+    const float* GetRowRays() const { return row_rays_.data(); }
+    // Rays at fractional depth-pixel coordinates, e.g. pyramid pixel centres.
+    float DepthColumnRay(float x) const { return (x - depth_cx_) * inv_depth_fx_; }
+    float DepthRowRay(float y) const { return (y - depth_cy_) * inv_depth_fy_; }
+
+    // Camera-image pixel -> depth pixel.
+    float GetDepthScaleX() const { return depth_scale_x_; }
+    float GetDepthScaleY() const { return depth_scale_y_; }
+    // Ray through a sub-pixel camera-image point, e.g. a feature track.
+    void CameraRay(float u, float v, float* out_ray_x, float* out_ray_y) const {
+        *out_ray_x = (u - cx_) * inv_fx_;
+        *out_ray_y = (v - cy_) * inv_fy_;
+    }
+
+private:
+    float fx_ = 0.0f;
+    float fy_ = 0.0f;
+    float cx_ = 0.0f;
+    float cy_ = 0.0f;
+    float inv_fx_ = 0.0f;
+    float inv_fy_ = 0.0f;
+    int image_width_ = 0;
+    int image_height_ = 0;
+    int depth_width_ = 0;
+    int depth_height_ = 0;
+    float depth_scale_x_ = 0.0f;
+    float depth_scale_y_ = 0.0f;
+    float depth_cx_ = 0.0f;
+    float depth_cy_ = 0.0f;
+    float inv_depth_fx_ = 0.0f;
+    float inv_depth_fy_ = 0.0f;
+    int generation_ = 0;
+    std::vector<float> column_rays_;
+    std::vector<float> row_rays_;
+};
+
+#endif // SLAMTORCH_DEPTH_RAY_CACHE_H
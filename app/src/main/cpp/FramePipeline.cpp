@@ -0,0 +1,497 @@
+#include "FramePipeline.h"
+#include "DepthBackProjector.h"
+#include "Log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr int kMaxTracks = 800;
+constexpr int kPyramidLevels = 3;
+// Optical-flow helpers next to the pipeline's own thread, on the big cores.
+constexpr int kFlowWorkers = 2;
+constexpr int kMinStableCount = 20;
+constexpr float kMaxTrackError = 5.0f;
+constexpr float kDepthMeshMinM = 0.2f;
+constexpr float kDepthMeshMaxM = 6.0f;
+// Smallest map buffers the render thread allocates, in points and vertices.
+constexpr int kMinMapPointCapacity = 16384;
+constexpr int kMinMapMeshCapacity = 3 * 8192;
+
+// Accumulates one frame's changes into the ranges the render thread still
+// needs. When count outgrows capacity, the render thread reallocates its
+// buffer and gets every item again.
+void AddPending(const std::vector<SlotRange>& changed, int count, int min_capacity,
+                int* capacity, std::vector<SlotRange>* pending) {
+    if (count > *capacity) {
+        *capacity = std::max(count + count / 2, min_capacity);
+        pending->assign(1, SlotRange{0, *capacity});
+        return;
+    }
+    pending->insert(pending->end(), changed.begin(), changed.end());
+    MergeRanges(pending, DepthMapper::kChangedMergeGap, DepthMapper::kMaxChangedRanges);
+}
+
+// Copies the pending ranges below count, stride floats per item, back to back.
+void PackRanges(const float* data, int count, int stride, const std::vector<SlotRange>& pending,
+                std::vector<SlotRange>* out_ranges, std::vector<float>* out_data) {
+    out_ranges->clear();
+    out_data->clear();
+    for (const SlotRange& range : pending) {
+        const int end = std::min(range.end, count);
+        if (range.begin >= end) continue;
+        out_ranges->push_back(SlotRange{range.begin, end});
+        out_data->insert(out_data->end(), data + static_cast<size_t>(range.begin) * stride,
+                         data + static_cast<size_t>(end) * stride);
+    }
+}
+}
+
+void FramePipeline::Packet::SetDepth(const DepthFrame& frame) {
+    has_depth = false;
+    has_confidence = false;
+    if (!frame.depth_data || frame.width <= 0 || frame.height <= 0) return;
+
+    depth_width = frame.width;
+    depth_height = frame.height;
+    depth.resize(static_cast<size_t>(depth_width) * depth_height);
+    for (int y = 0; y < depth_height; ++y) {
+        const uint8_t* row = reinterpret_cast<const uint8_t*>(frame.depth_data) + frame.row_stride * y;
+        uint16_t* dst = depth.data() + static_cast<size_t>(y) * depth_width;
+        if (frame.pixel_stride == sizeof(uint16_t)) {
+            memcpy(dst, row, depth_width * sizeof(uint16_t));
+            continue;
+        }
+        for (int x = 0; x < depth_width; ++x) {
+            memcpy(&dst[x], row + frame.pixel_stride * x, sizeof(uint16_t));
+        }
+    }
+
+    if (frame.confidence_data && frame.confidence_pixel_stride > 0) {
+        confidence.resize(depth.size());
+        for (int y = 0; y < depth_height; ++y) {
+            const uint8_t* row = frame.confidence_data + frame.confidence_row_stride * y;
+            uint8_t* dst = confidence.data() + static_cast<size_t>(y) * depth_width;
+            for (int x = 0; x < depth_width; ++x) {
+                dst[x] = row[frame.confidence_pixel_stride * x];
+            }
+        }
+        has_confidence = true;
+    }
+    has_depth = true;
+}
+
+void FramePipeline::Packet::SetPoints(const float* data, int count) {
+    point_count = data ? std::max(0, count) : 0;
+    points.assign(data, data + static_cast<size_t>(point_count) * 4);
+}
+
+void FramePipeline::Packet::ToSessionFrame(SessionFrame* out) const {
+    *out = SessionFrame{};
+    out->timestamp_ns = timestamp_ns;
+    memcpy(out->world_from_camera, world_from_camera, sizeof(world_from_camera));
+    out->fx = fx;
+    out->fy = fy;
+    out->cx = cx;
+    out->cy = cy;
+    out->image_width = image_width;
+    out->image_height = image_height;
+    if (has_image) {
+        out->image = image.data();
+        out->y_width = y_width;
+        out->y_height = y_height;
+    }
+    if (has_depth) {
+        out->depth = depth.data();
+        out->confidence = has_confidence ? confidence.data() : nullptr;
+        out->depth_width = depth_width;
+        out->depth_height = depth_height;
+    }
+    if (point_count > 0) {
+        out->points = points.data();
+        out->point_count = point_count;
+    }
+    if (settings.map_enabled) out->flags |= SessionRecording::kFlagMapEnabled;
+    if (settings.fusion_mode == DepthMapper::FusionMode::TSDF) out->flags |= SessionRecording::kFlagTsdf;
+    if (settings.depth_mesh_enabled) out->flags |= SessionRecording::kFlagDepthMesh;
+}
+
+void FramePipeline::Packet::FromSessionFrame(const SessionFrame& frame) {
+    timestamp_ns = frame.timestamp_ns;
+    memcpy(world_from_camera, frame.world_from_camera, sizeof(world_from_camera));
+    fx = frame.fx;
+    fy = frame.fy;
+    cx = frame.cx;
+    cy = frame.cy;
+    image_width = frame.image_width;
+    image_height = frame.image_height;
+
+    has_image = frame.image != nullptr;
+    if (has_image) {
+        y_width = frame.y_width;
+        y_height = frame.y_height;
+        image.assign(frame.image, frame.image + static_cast<size_t>(y_width) * y_height);
+    }
+
+    has_depth = frame.depth != nullptr;
+    has_confidence = has_depth && frame.confidence != nullptr;
+    if (has_depth) {
+        depth_width = frame.depth_width;
+        depth_height = frame.depth_height;
+        const size_t pixels = static_cast<size_t>(depth_width) * depth_height;
+        depth.assign(frame.depth, frame.depth + pixels);
+        if (has_confidence) {
+            confidence.assign(frame.confidence, frame.confidence + pixels);
+        }
+    }
+
+    SetPoints(frame.points, frame.point_count);
+
+    settings.map_enabled = (frame.flags & SessionRecording::kFlagMapEnabled) != 0;
+    settings.fusion_mode = (frame.flags & SessionRecording::kFlagTsdf) != 0
+        ? DepthMapper::FusionMode::TSDF
+        : DepthMapper::FusionMode::OCCUPANCY;
+    settings.depth_mesh_enabled = (frame.flags & SessionRecording::kFlagDepthMesh) != 0;
+    settings.build_visualization = false;
+}
+
+FramePipeline::FramePipeline(int depth_mesh_width, int depth_mesh_height, bool threaded,
+                             FrameProfiler* profiler)
+    : landmarks_(kMaxLandmarks),
+      optical_flow_(kMaxTracks, kPyramidLevels),
+      profiler_(profiler) {
+    depth_mesh_builder_.Initialize(depth_mesh_width, depth_mesh_height);
+    optical_flow_.SetWorkerCount(kFlowWorkers, true);
+    optical_flow_.SetForwardBackwardCheck(true);
+    if (threaded) {
+        worker_ = std::thread(&FramePipeline::Run, this);
+        LogPrint(LogLevel::INFO, "FramePipeline worker started");
+    }
+}
+
+FramePipeline::~FramePipeline() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void FramePipeline::SubmitPacket() {
+    packets_.Publish();
+    if (!worker_.joinable()) {
+        Process(*packets_.Acquire());
+        return;
+    }
+    // Taking the lock orders the publish before the worker's predicate check,
+    // so a worker about to sleep cannot miss it.
+    { std::lock_guard<std::mutex> lock(wake_mutex_); }
+    wake_.notify_one();
+}
+
+void FramePipeline::Run() {
+    if (profiler_) {
+        profiler_->NameCurrentThread("worker");
+    }
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_.wait(lock, [this] { return stop_ || packets_.HasUnread(); });
+            if (stop_) return;
+        }
+        const Packet* packet = packets_.Acquire();
+        if (packet) {
+            Process(*packet);
+        }
+    }
+}
+
+void FramePipeline::StartRecording(const std::string& path, bool compress) {
+    {
+        std::lock_guard<std::mutex> lock(recording_mutex_);
+        recording_path_ = path;
+        recording_compress_ = compress;
+    }
+    recording_requests_.fetch_add(1, std::memory_order_release);
+}
+
+void FramePipeline::ApplyRecording() {
+    std::string path;
+    bool compress = false;
+    {
+        std::lock_guard<std::mutex> lock(recording_mutex_);
+        path = recording_path_;
+        compress = recording_compress_;
+    }
+    recorder_.Close();
+    if (!path.empty()) {
+        recorder_.Open(path, compress);
+    }
+}
+
+void FramePipeline::ApplyClear() {
+    landmarks_.Clear();
+    optical_flow_.Reset();
+    depth_mapper_.Reset();
+    depth_mesh_builder_.Clear();
+    pending_map_reset_ = true;
+}
+
+void FramePipeline::Process(const Packet& packet) {
+    // Once the render thread has taken the last result, nothing is pending.
+    if (!results_.HasUnread()) {
+        pending_map_reset_ = false;
+        pending_points_dirty_ = false;
+        pending_mesh_dirty_ = false;
+        pending_point_ranges_.clear();
+        pending_mesh_ranges_.clear();
+        landmarks_.ClearDirty();
+    }
+
+    const int clears = clear_requests_.load(std::memory_order_relaxed);
+    if (clears != clears_handled_) {
+        clears_handled_ = clears;
+        ApplyClear();
+    }
+
+    const int recording_requests = recording_requests_.load(std::memory_order_acquire);
+    if (recording_requests != recording_requests_handled_) {
+        recording_requests_handled_ = recording_requests;
+        ApplyRecording();
+    }
+    if (recorder_.IsOpen()) {
+        ScopedStage stage(profiler_, ProfileStage::RECORDING);
+        SessionFrame frame;
+        packet.ToSessionFrame(&frame);
+        recorder_.WriteFrame(frame);
+    }
+
+    PreprocessDepth(packet);
+
+    Result& result = results_.GetWriteBuffer();
+    UpdateTracking(packet, &result);
+    UpdateMap(packet, &result);
+    results_.Publish();
+}
+
+void FramePipeline::PreprocessDepth(const Packet& packet) {
+    ScopedStage stage(profiler_, ProfileStage::DEPTH_PREPROCESS);
+    if (packet.has_depth) {
+        DepthFrame frame;
+        frame.depth_data = packet.depth.data();
+        frame.width = packet.depth_width;
+        frame.height = packet.depth_height;
+        frame.row_stride = packet.depth_width * static_cast<int>(sizeof(uint16_t));
+        frame.pixel_stride = sizeof(uint16_t);
+        if (packet.has_confidence) {
+            frame.confidence_data = packet.confidence.data();
+            frame.confidence_row_stride = packet.depth_width;
+            frame.confidence_pixel_stride = 1;
+        }
+        depth_preprocessor_.Process(frame, packet.settings.build_visualization);
+    } else {
+        depth_preprocessor_.Clear();
+    }
+
+    // Without depth, keep the cached depth size so the tables survive.
+    const bool depth_ok = depth_preprocessor_.IsValid();
+    depth_ray_cache_.Update(packet.fx, packet.fy, packet.cx, packet.cy,
+                            packet.image_width, packet.image_height,
+                            depth_ok ? depth_preprocessor_.GetWidth() : depth_ray_cache_.GetDepthWidth(),
+                            depth_ok ? depth_preprocessor_.GetHeight() : depth_ray_cache_.GetDepthHeight());
+}
+
+void FramePipeline::UpdateTracking(const Packet& packet, Result* result) {
+    landmarks_.BeginFrame();
+
+    result->tracking_updated = packet.has_image;
+    if (packet.has_image) {
+        ScopedStage stage(profiler_, ProfileStage::OPTICAL_FLOW);
+        optical_flow_.Update(packet.image.data(), packet.y_width, packet.y_height);
+        result->feature_count = optical_flow_.GetTrackCount();
+    }
+
+    ScopedStage stage(profiler_, ProfileStage::LANDMARKS);
+    if (packet.has_image) {
+        const bool depth_ok = depth_preprocessor_.IsValid();
+        const DepthPreprocessor::Level& depth = depth_preprocessor_.GetLevel(0);
+
+        const OpticalFlowTracker::Track* tracks = optical_flow_.GetTracks();
+        const int track_count = optical_flow_.GetTrackCount();
+        int stable_tracks = 0;
+        float total_track_age = 0.0f;
+        int depth_attempts = 0;
+        int depth_hits = 0;
+        const float depth_scale_x = depth_ray_cache_.GetDepthScaleX();
+        const float depth_scale_y = depth_ray_cache_.GetDepthScaleY();
+        // Tracks with depth are collected and back-projected as one batch,
+        // then associated with the landmarks as one batch.
+        track_ray_x_.clear();
+        track_ray_y_.clear();
+        track_depth_m_.clear();
+        track_observations_.clear();
+
+        for (int i = 0; i < track_count; ++i) {
+            const auto& track = tracks[i];
+            if (!track.active) continue;
+            total_track_age += static_cast<float>(track.age);
+
+            if (track.stable_count < kMinStableCount) continue;
+            if (track.error > kMaxTrackError) continue;
+
+            stable_tracks++;
+
+            float ray_x = 0.0f;
+            float ray_y = 0.0f;
+            depth_ray_cache_.CameraRay(track.x, track.y, &ray_x, &ray_y);
+            const float bearing_len = std::sqrt(ray_x * ray_x + ray_y * ray_y + 1.0f);
+            LandmarkMap::Observation observation;
+            observation.track_id = track.id;
+            observation.bearing[0] = ray_x / bearing_len;
+            observation.bearing[1] = ray_y / bearing_len;
+            observation.bearing[2] = -1.0f / bearing_len;
+
+            if (!depth_ok) {
+                observation.confidence = 0.4f + 0.4f * (track.stable_count / 30.0f);
+                track_observations_.push_back(observation);
+                continue;
+            }
+
+            const int px = static_cast<int>(track.x * depth_scale_x);
+            const int py = static_cast<int>(track.y * depth_scale_y);
+            if (px < 0 || py < 0 || px >= depth.width || py >= depth.height) {
+                continue;
+            }
+
+            const float depth_m = depth.depth_m[py * depth.width + px];
+            depth_attempts++;
+            if (depth_m <= 0.0f) continue;
+            depth_hits++;
+
+            track_ray_x_.push_back(ray_x);
+            track_ray_y_.push_back(ray_y);
+            track_depth_m_.push_back(depth_m);
+            observation.confidence = 0.5f + 0.5f * (track.stable_count / 30.0f);
+            observation.has_metric_depth = true;
+            track_observations_.push_back(observation);
+        }
+
+        // With depth every observation is metric, in the same order as the rays.
+        const int metric_count = static_cast<int>(track_depth_m_.size());
+        if (metric_count > 0) {
+            track_world_points_.resize(static_cast<size_t>(metric_count) * 3);
+            DepthBackProjector::ProjectPoints(track_ray_x_.data(), track_ray_y_.data(),
+                                              track_depth_m_.data(), metric_count,
+                                              packet.world_from_camera, track_world_points_.data());
+            for (int i = 0; i < metric_count; ++i) {
+                std::copy(&track_world_points_[i * 3], &track_world_points_[i * 3] + 3,
+                          track_observations_[i].world_pos);
+            }
+        }
+        landmarks_.AddObservations(track_observations_.data(),
+                                   static_cast<int>(track_observations_.size()), nullptr);
+
+        result->stable_tracks = stable_tracks;
+        result->avg_track_age = track_count > 0
+            ? (total_track_age / static_cast<float>(track_count))
+            : 0.0f;
+        result->depth_hit_rate = depth_attempts > 0
+            ? (100.0f * static_cast<float>(depth_hits) / static_cast<float>(depth_attempts))
+            : 0.0f;
+        result->bearing_landmarks = landmarks_.GetBearingCount();
+        result->metric_landmarks = landmarks_.GetMetricCount();
+    }
+
+    result->landmark_count = landmarks_.GetPointCount();
+    result->landmark_frame = landmarks_.GetFrameIndex();
+    memcpy(result->landmark_world_from_camera, packet.world_from_camera, sizeof(packet.world_from_camera));
+    landmarks_.CollectDirty(&result->landmark_ranges, &result->landmark_vertices);
+}
+
+void FramePipeline::UpdateMap(const Packet& packet, Result* result) {
+    const bool depth_ok = depth_preprocessor_.IsValid();
+    result->depth_valid = depth_ok;
+    result->depth_width = depth_ok ? depth_preprocessor_.GetWidth() : 0;
+    result->depth_height = depth_ok ? depth_preprocessor_.GetHeight() : 0;
+    result->depth_min_m = depth_ok ? depth_preprocessor_.GetMinDepth() : 0.0f;
+    result->depth_max_m = depth_ok ? depth_preprocessor_.GetMaxDepth() : 0.0f;
+
+    const uint8_t* visualization = depth_ok ? depth_preprocessor_.GetVisualization() : nullptr;
+    result->has_visualization = visualization != nullptr;
+    if (visualization) {
+        result->visualization.assign(visualization,
+                                     visualization + static_cast<size_t>(result->depth_width) * result->depth_height);
+    }
+
+    result->depth_mesh_updated = depth_ok && packet.settings.depth_mesh_enabled;
+    result->depth_mesh_valid = false;
+    result->depth_mesh_valid_ratio = 0.0f;
+    if (result->depth_mesh_updated) {
+        ScopedStage stage(profiler_, ProfileStage::DEPTH_MESH);
+        const float min_depth_mesh = std::max(kDepthMeshMinM, result->depth_min_m > 0.0f ? result->depth_min_m : kDepthMeshMinM);
+        const float max_depth_mesh = std::min(kDepthMeshMaxM, result->depth_max_m > 0.0f ? result->depth_max_m : kDepthMeshMaxM);
+        depth_mesh_builder_.Update(depth_preprocessor_, depth_ray_cache_, packet.world_from_camera,
+                                   min_depth_mesh, max_depth_mesh);
+        result->depth_mesh_valid = depth_mesh_builder_.HasMesh();
+        result->depth_mesh_valid_ratio = depth_mesh_builder_.GetValidRatio();
+        if (result->depth_mesh_valid) {
+            result->depth_mesh_vertices.assign(depth_mesh_builder_.GetVertices(),
+                                               depth_mesh_builder_.GetVertices() + depth_mesh_builder_.GetVertexCount());
+        }
+    }
+
+    depth_mapper_.SetEnabled(packet.settings.map_enabled);
+    result->map_updated = depth_ok && packet.settings.map_enabled;
+    if (result->map_updated) {
+        ScopedStage stage(profiler_, ProfileStage::DEPTH_FUSION);
+        if (depth_mapper_.GetFusionMode() != packet.settings.fusion_mode) {
+            depth_mapper_.SetFusionMode(packet.settings.fusion_mode);
+            pending_map_reset_ = true;
+        }
+        depth_mapper_.Update(depth_preprocessor_, depth_ray_cache_, packet.world_from_camera);
+        const auto& stats = depth_mapper_.GetStats();
+        result->voxels_used = stats.voxels_used;
+        total_points_fused_ += stats.points_fused_last_frame;
+    }
+
+    // Collected even on frames without an update, so changes from skipped
+    // results still reach the renderer.
+    ScopedStage stage(profiler_, ProfileStage::MAP_OUTPUT);
+    // After a reset the render thread starts from empty buffers.
+    if (pending_map_reset_) {
+        pending_point_ranges_.assign(1, SlotRange{0, map_point_capacity_});
+        pending_mesh_ranges_.assign(1, SlotRange{0, map_mesh_capacity_});
+    }
+
+    bool dirty = false;
+    int render_count = 0;
+    const float* points = depth_mapper_.GetRenderPoints(&render_count, &dirty, &map_changed_);
+    if (dirty) {
+        pending_points_dirty_ = true;
+        AddPending(map_changed_, render_count, kMinMapPointCapacity, &map_point_capacity_,
+                   &pending_point_ranges_);
+    }
+    result->map_point_count = render_count;
+    result->map_point_capacity = map_point_capacity_;
+    PackRanges(points, render_count, 3, pending_point_ranges_, &result->map_point_ranges, &result->map_points);
+
+    int mesh_vertex_count = 0;
+    bool mesh_dirty = false;
+    const float* mesh = depth_mapper_.GetMeshVertices(&mesh_vertex_count, &mesh_dirty, &map_changed_);
+    if (mesh_dirty) {
+        pending_mesh_dirty_ = true;
+        AddPending(map_changed_, mesh_vertex_count, kMinMapMeshCapacity, &map_mesh_capacity_,
+                   &pending_mesh_ranges_);
+    }
+    result->map_mesh_vertex_count = mesh_vertex_count;
+    result->map_mesh_capacity = map_mesh_capacity_;
+    PackRanges(mesh, mesh_vertex_count, DepthMapper::kMeshFloatsPerVertex, pending_mesh_ranges_,
+               &result->map_mesh_ranges, &result->map_mesh);
+    result->total_points_fused = total_points_fused_;
+    result->map_reset = pending_map_reset_;
+    result->map_points_dirty = pending_points_dirty_;
+    result->map_mesh_dirty = pending_mesh_dirty_;
+}
@@ -0,0 +1,220 @@
+#ifndef SLAMTORCH_FRAME_PIPELINE_H
+#define SLAMTORCH_FRAME_PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DepthFrame.h"
+#include "DepthMapper.h"
+#include "DepthMeshBuilder.h"
+#include "DepthPreprocessor.h"
+#include "DepthRayCache.h"
+#include "FrameProfiler.h"
+#include "LandmarkMap.h"
+#include "OpticalFlowTracker.h"
+#include "SessionRecording.h"
+#include "SlotRange.h"
+#include "TripleBuffer.h"
+
+// Moves tracking and fusion off the render thread. Each frame the render
+// thread copies its inputs into a packet and submits it; a worker thread runs
+// optical flow, landmark association, depth preprocessing, mapping and the
+// live depth mesh, then publishes a result that the render thread picks up
+// for the next draw. Packets and results are exchanged through triple
+// buffers, so neither thread ever waits for the other: a slow frame on the
+// worker only means the render thread skips ahead to the newest packet.
+class FramePipeline {
+public:
+    struct Settings {
+        bool map_enabled = true;
+        DepthMapper::FusionMode fusion_mode = DepthMapper::FusionMode::OCCUPANCY;
+        bool depth_mesh_enabled = false;
+        bool build_visualization = false;
+    };
+
+    // Everything the worker needs from one AR frame; owns its pixel copies.
+    struct Packet {
+        int64_t timestamp_ns = 0;
+        float world_from_camera[16] = {};
+        // Camera intrinsics and the image size they refer to.
+        float fx = 0.0f;
+        float fy = 0.0f;
+        float cx = 0.0f;
+        float cy = 0.0f;
+        int image_width = 0;
+        int image_height = 0;
+
+        // Tightly packed Y plane.
+        std::vector<uint8_t> image;
+        int y_width = 0;
+        int y_height = 0;
+        bool has_image = false;
+
+        // Tightly packed depth (mm) and optional confidence.
+        std::vector<uint16_t> depth;
+        std::vector<uint8_t> confidence;
+        int depth_width = 0;
+        int depth_height = 0;
+        bool has_depth = false;
+        bool has_confidence = false;
+
+        // ARCore feature points, xyz + confidence in world space. Only
+        // recorded; the worker does not consume them.
+        std::vector<float> points;
+        int point_count = 0;
+
+        Settings settings;
+
+        // Copies an acquired frame so its ArImages can be released at once.
+        void SetDepth(const DepthFrame& frame);
+        void ClearDepth() { has_depth = false; }
+        void SetPoints(const float* data, int count);
+
+        // The returned frame points into this packet.
+        void ToSessionFrame(SessionFrame* out) const;
+        void FromSessionFrame(const SessionFrame& frame);
+    };
+
+    struct Result {
+        // Tracking; only refreshed when the packet carried an image.
+        bool tracking_updated = false;
+        int feature_count = 0;
+        int stable_tracks = 0;
+        float avg_track_age = 0.0f;
+        float depth_hit_rate = 0.0f;
+        int bearing_landmarks = 0;
+        int metric_landmarks = 0;
+        // Landmarks are patched in place: the slot ranges changed since the
+        // render thread's last pickup, and their vertices back to back.
+        int landmark_count = 0;
+        std::vector<SlotRange> landmark_ranges;
+        std::vector<LandmarkMap::Vertex> landmark_vertices;
+        // Bearing-only landmarks are drawn relative to this packet's pose.
+        float landmark_world_from_camera[16] = {};
+        int landmark_frame = 0;
+
+        bool depth_valid = false;
+        int depth_width = 0;
+        int depth_height = 0;
+        float depth_min_m = 0.0f;
+        float depth_max_m = 0.0f;
+        std::vector<uint8_t> visualization;
+        bool has_visualization = false;
+
+        // Live depth mesh; only rebuilt when enabled and depth is valid.
+        bool depth_mesh_updated = false;
+        bool depth_mesh_valid = false;
+        std::vector<DepthMeshBuilder::Vertex> depth_mesh_vertices;
+        float depth_mesh_valid_ratio = 0.0f;
+
+        // Map. Changes are accumulated over results the render thread never
+        // picked up, so the newest one always carries everything it missed.
+        bool map_updated = false;
+        int voxels_used = 0;
+        // Running total; the render thread derives per-second rates from it.
+        int64_t total_points_fused = 0;
+        bool map_reset = false;
+        // Points and mesh vertices are patched in place like landmarks: the
+        // ranges changed since the last pickup, and their floats back to back.
+        // The capacity is what the render thread's buffer must hold; whenever
+        // it grows, the ranges cover every point.
+        bool map_points_dirty = false;
+        int map_point_count = 0;
+        int map_point_capacity = 0;
+        std::vector<SlotRange> map_point_ranges;
+        std::vector<float> map_points;
+        bool map_mesh_dirty = false;
+        int map_mesh_vertex_count = 0;
+        int map_mesh_capacity = 0;
+        std::vector<SlotRange> map_mesh_ranges;
+        std::vector<float> map_mesh;
+    };
+
+    static constexpr int kMaxLandmarks = 20000;
+
+    // Without a worker thread, SubmitPacket() processes the packet before
+    // returning, so replays are deterministic and run as fast as the CPU allows.
+    // Stage timings go to profiler when one is given.
+    FramePipeline(int depth_mesh_width, int depth_mesh_height, bool threaded = true,
+                  FrameProfiler* profiler = nullptr);
+    ~FramePipeline();
+
+    // Render thread: fill the packet returned by GetPacket(), then submit it.
+    Packet& GetPacket() { return packets_.GetWriteBuffer(); }
+    void SubmitPacket();
+    // Render thread: the newest result since the last call, or nullptr.
+    const Result* AcquireResult() { return results_.Acquire(); }
+
+    // Any thread: tracking and maps are reset before the next packet.
+    void RequestClear() { clear_requests_.fetch_add(1, std::memory_order_relaxed); }
+
+    // Any thread: from the next packet on, every packet the worker processes
+    // is appended to a session file. Packets the worker skipped are not.
+    void StartRecording(const std::string& path, bool compress);
+    void StopRecording() { StartRecording(std::string(), false); }
+
+private:
+    void Run();
+    void Process(const Packet& packet);
+    void ApplyClear();
+    void ApplyRecording();
+    void PreprocessDepth(const Packet& packet);
+    void UpdateTracking(const Packet& packet, Result* result);
+    void UpdateMap(const Packet& packet, Result* result);
+
+    LandmarkMap landmarks_;
+    OpticalFlowTracker optical_flow_;
+    DepthPreprocessor depth_preprocessor_;
+    DepthRayCache depth_ray_cache_;
+    DepthMapper depth_mapper_;
+    DepthMeshBuilder depth_mesh_builder_;
+
+    FrameProfiler* profiler_ = nullptr;
+
+    TripleBuffer<Packet> packets_;
+    TripleBuffer<Result> results_;
+
+    // Only used to wake the worker; packets themselves are lock-free.
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::thread worker_;
+
+    std::atomic<int> clear_requests_{0};
+    int clears_handled_ = 0;
+
+    // Path and compression are guarded by recording_mutex_; the counter lets
+    // the worker skip the lock when nothing changed. An empty path stops.
+    std::mutex recording_mutex_;
+    std::string recording_path_;
+    bool recording_compress_ = false;
+    std::atomic<int> recording_requests_{0};
+    int recording_requests_handled_ = 0;
+    SessionWriter recorder_;
+
+    // Map changes since the render thread last picked up a result, and the
+    // buffer capacities it has allocated by then.
+    bool pending_map_reset_ = false;
+    bool pending_points_dirty_ = false;
+    bool pending_mesh_dirty_ = false;
+    std::vector<SlotRange> pending_point_ranges_;
+    std::vector<SlotRange> pending_mesh_ranges_;
+    std::vector<SlotRange> map_changed_;
+    int map_point_capacity_ = 0;
+    int map_mesh_capacity_ = 0;
+    int64_t total_points_fused_ = 0;
+
+    // Stable tracks this frame; those with depth are back-projected in one batch.
+    std::vector<float> track_ray_x_;
+    std::vector<float> track_ray_y_;
+    std::vector<float> track_depth_m_;
+    std::vector<float> track_world_points_;
+    std::vector<LandmarkMap::Observation> track_observations_;
+};
+
+#endif // SLAMTORCH_FRAME_PIPELINE_H
@@ -0,0 +1,150 @@
+#include "FrameProfiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+constexpr uint64_t kCapacityMask = FrameProfiler::kCapacity - 1;
+static_assert((FrameProfiler::kCapacity & kCapacityMask) == 0, "capacity must be a power of two");
+
+const char* const kStageNames[FrameProfiler::kStageCount] = {
+    "frame",
+    "ar_update",
+    "image_copy",
+    "depth_copy",
+    "result_upload",
+    "draw",
+    "depth_preprocess",
+    "optical_flow",
+    "landmarks",
+    "depth_mesh",
+    "depth_fusion",
+    "map_output",
+    "recording",
+};
+
+std::atomic<int> next_thread_id{0};
+
+float Percentile(const std::vector<int64_t>& sorted, float fraction) {
+    const size_t rank = static_cast<size_t>(fraction * static_cast<float>(sorted.size() - 1) + 0.5f);
+    return static_cast<float>(sorted[std::min(rank, sorted.size() - 1)]) * 1e-6f;
+}
+}
+
+FrameProfiler::FrameProfiler() {
+    for (auto& name : thread_names_) {
+        name.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+int64_t FrameProfiler::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int FrameProfiler::CurrentThread() {
+    static thread_local int id = next_thread_id.fetch_add(1, std::memory_order_relaxed) % kMaxThreads;
+    return id;
+}
+
+const char* FrameProfiler::GetStageName(ProfileStage stage) {
+    const int index = static_cast<int>(stage);
+    return index >= 0 && index < kStageCount ? kStageNames[index] : "unknown";
+}
+
+void FrameProfiler::NameCurrentThread(const char* name) {
+    thread_names_[CurrentThread()].store(name, std::memory_order_relaxed);
+}
+
+void FrameProfiler::Record(ProfileStage stage, int64_t start_ns, int64_t end_ns) {
+    const uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[index & kCapacityMask];
+    // Invalidate first so readers never pair the old sequence with new data.
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.end_ns.store(end_ns, std::memory_order_relaxed);
+    slot.stage_thread.store(static_cast<uint32_t>(stage) | (static_cast<uint32_t>(CurrentThread()) << 8),
+                            std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+void FrameProfiler::Snapshot(std::vector<Event>* out) const {
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    const uint64_t begin = head > static_cast<uint64_t>(kCapacity) ? head - kCapacity : 0;
+    for (uint64_t index = begin; index < head; ++index) {
+        const Slot& slot = slots_[index & kCapacityMask];
+        if (slot.sequence.load(std::memory_order_acquire) != index + 1) continue;
+        Event event;
+        event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+        event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+        const uint32_t stage_thread = slot.stage_thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != index + 1) continue;
+        event.stage = static_cast<ProfileStage>(stage_thread & 0xff);
+        event.thread = static_cast<int>(stage_thread >> 8);
+        out->push_back(event);
+    }
+}
+
+void FrameProfiler::ComputeStats(int64_t window_ns, StageStats* out_stats) const {
+    std::vector<Event> events;
+    events.reserve(kCapacity);
+    Snapshot(&events);
+
+    const int64_t since = NowNs() - window_ns;
+    std::vector<int64_t> durations[kStageCount];
+    for (const Event& event : events) {
+        if (event.end_ns < since) continue;
+        durations[static_cast<int>(event.stage)].push_back(event.end_ns - event.start_ns);
+    }
+    for (int stage = 0; stage < kStageCount; ++stage) {
+        std::vector<int64_t>& values = durations[stage];
+        StageStats& stats = out_stats[stage];
+        stats = StageStats{};
+        if (values.empty()) continue;
+        std::sort(values.begin(), values.end());
+        stats.count = static_cast<int>(values.size());
+        stats.p50_ms = Percentile(values, 0.50f);
+        stats.p95_ms = Percentile(values, 0.95f);
+        stats.p99_ms = Percentile(values, 0.99f);
+    }
+}
+
+bool FrameProfiler::ExportChromeTrace(const std::string& path) const {
+    std::vector<Event> events;
+    events.reserve(kCapacity);
+    Snapshot(&events);
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        LogPrint(LogLevel::ERROR, "FrameProfiler: cannot write %s", path.c_str());
+        return false;
+    }
+    int64_t origin_ns = events.empty() ? 0 : events.front().start_ns;
+    for (const Event& event : events) {
+        origin_ns = std::min(origin_ns, event.start_ns);
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (int thread = 0; thread < kMaxThreads; ++thread) {
+        const char* name = thread_names_[thread].load(std::memory_order_relaxed);
+        if (!name) continue;
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", thread, name);
+        first = false;
+    }
+    // Complete events in microseconds, relative to the oldest event.
+    for (const Event& event : events) {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", GetStageName(event.stage), event.thread,
+                static_cast<double>(event.start_ns - origin_ns) * 1e-3,
+                static_cast<double>(event.end_ns - event.start_ns) * 1e-3);
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+    const bool ok = fclose(file) == 0;
+    LogPrint(LogLevel::INFO, "FrameProfiler: wrote %zu events to %s", events.size(), path.c_str());
+    return ok;
+}
@@ -0,0 +1,112 @@
+#ifndef SLAMTORCH_FRAME_PROFILER_H
+#define SLAMTORCH_FRAME_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-stage frame timing. Any thread records (stage, start, end) into a
+// fixed lock-free ring buffer; the newest kCapacity records are kept. Readers
+// take a snapshot for percentiles or a Chrome trace (also loads in Perfetto)
+// without stopping the writers.
+enum class ProfileStage : uint8_t {
+    FRAME,
+    AR_UPDATE,
+    IMAGE_COPY,
+    DEPTH_COPY,
+    RESULT_UPLOAD,
+    DRAW,
+    DEPTH_PREPROCESS,
+    OPTICAL_FLOW,
+    LANDMARKS,
+    DEPTH_MESH,
+    DEPTH_FUSION,
+    MAP_OUTPUT,
+    RECORDING,
+    COUNT
+};
+
+class FrameProfiler {
+public:
+    static constexpr int kStageCount = static_cast<int>(ProfileStage::COUNT);
+    static constexpr int kCapacity = 8192;
+    static constexpr int kMaxThreads = 8;
+
+    struct Event {
+        ProfileStage stage = ProfileStage::FRAME;
+        int thread = 0;
+        int64_t start_ns = 0;
+        int64_t end_ns = 0;
+    };
+
+    struct StageStats {
+        int count = 0;
+        float p50_ms = 0.0f;
+        float p95_ms = 0.0f;
+        float p99_ms = 0.0f;
+    };
+
+    FrameProfiler();
+
+    void SetEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Names the calling thread in trace exports.
+    void NameCurrentThread(const char* name);
+
+    void Record(ProfileStage stage, int64_t start_ns, int64_t end_ns);
+
+    // Appends the events still in the buffer in the order they were recorded.
+    // Events being overwritten while the snapshot runs are skipped.
+    void Snapshot(std::vector<Event>* out) const;
+
+    // Percentiles over the events that ended in the last window_ns, indexed
+    // by stage.
+    void ComputeStats(int64_t window_ns, StageStats* out_stats) const;
+
+    bool ExportChromeTrace(const std::string& path) const;
+
+    static const char* GetStageName(ProfileStage stage);
+    static int64_t NowNs();
+
+private:
+    struct Slot {
+        // Index + 1 of the event in the slot, 0 while it is being written.
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<int64_t> start_ns{0};
+        std::atomic<int64_t> end_ns{0};
+        std::atomic<uint32_t> stage_thread{0};
+    };
+
+    static int CurrentThread();
+
+    Slot slots_[kCapacity];
+    std::atomic<uint64_t> head_{0};
+    std::atomic<bool> enabled_{true};
+    std::atomic<const char*> thread_names_[kMaxThreads];
+};
+
+// Records the enclosing scope; a null profiler makes it a no-op.
+class ScopedStage {
+public:
+    ScopedStage(FrameProfiler* profiler, ProfileStage stage)
+        : profiler_(profiler && profiler->IsEnabled() ? profiler : nullptr),
+          stage_(stage),
+          start_ns_(profiler_ ? FrameProfiler::NowNs() : 0) {
+    }
+    ~ScopedStage() {
+        if (profiler_) {
+            profiler_->Record(stage_, start_ns_, FrameProfiler::NowNs());
+        }
+    }
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+
+private:
+    FrameProfiler* profiler_;
+    ProfileStage stage_;
+    int64_t start_ns_;
+};
+
+#endif // SLAMTORCH_FRAME_PROFILER_H
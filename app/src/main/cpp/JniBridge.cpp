@@ -1,5 +1,6 @@
 #include <jni.h>
 #include <android/log.h>
+#include <string>
 #include "Renderer.h"
 
 // Global pointer to renderer (set by main loop)
@@ -88,6 +89,37 @@ Java_com_example_slamtorch_MainActivity_nativeSetMapEnabled(JNIEnv* env, jobject
     g_renderer->SetMapEnabled(enabled == JNI_TRUE);
 }
 
+JNIEXPORT void JNICALL
+Java_com_example_slamtorch_MainActivity_nativeSetMapTsdfEnabled(JNIEnv* env, jobject /* this */, jboolean enabled) {
+    if (!g_renderer) return;
+    g_renderer->SetMapFusionMode(enabled == JNI_TRUE ? DepthMapper::FusionMode::TSDF
+                                                     : DepthMapper::FusionMode::OCCUPANCY);
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_slamtorch_MainActivity_nativeSetRecording(JNIEnv* env, jobject /* this */, jstring path) {
+    if (!g_renderer) return;
+    std::string recording_path;
+    if (path) {
+        const char* chars = env->GetStringUTFChars(path, nullptr);
+        if (chars) {
+            recording_path = chars;
+            env->ReleaseStringUTFChars(path, chars);
+        }
+    }
+    g_renderer->SetRecording(recording_path);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_slamtorch_MainActivity_nativeExportTrace(JNIEnv* env, jobject /* this */, jstring path) {
+    if (!g_renderer || !path) return JNI_FALSE;
+    const char* chars = env->GetStringUTFChars(path, nullptr);
+    if (!chars) return JNI_FALSE;
+    const bool ok = g_renderer->ExportTrace(chars);
+    env->ReleaseStringUTFChars(path, chars);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
 JNIEXPORT void JNICALL
 Java_com_example_slamtorch_MainActivity_nativeSetDebugEnabled(JNIEnv* env, jobject /* this */, jboolean enabled) {
     if (!g_renderer) return;
@@ -114,7 +146,7 @@ Java_com_example_slamtorch_MainActivity_nativeGetDebugStats(JNIEnv* env, jobject
     }
     if (!constructor) {
         constructor = env->GetMethodID(statsClass, "<init>",
-            "(Ljava/lang/String;IIIIIIFFFLjava/lang/String;ZZZLjava/lang/String;IIFFIIZZLjava/lang/String;ZLjava/lang/String;ZIIF)V");
+            "(Ljava/lang/String;IIIIIIFFFLjava/lang/String;ZZZLjava/lang/String;IIFFIIZZLjava/lang/String;ZLjava/lang/String;ZIIFLjava/lang/String;)V");
         if (!constructor) {
             __android_log_print(ANDROID_LOG_ERROR, "SlamTorch", "Failed to find DebugStats constructor");
             return nullptr;
@@ -129,6 +161,7 @@ Java_com_example_slamtorch_MainActivity_nativeGetDebugStats(JNIEnv* env, jobject
     // Create DebugStats object
     jstring depthMode = env->NewStringUTF(stats.depth_mode);
     jstring depthMeshMode = env->NewStringUTF(stats.depth_mesh_mode);
+    jstring stageTimings = env->NewStringUTF(stats.stage_timings);
 
     jobject result = env->NewObject(statsClass, constructor,
         trackingState, stats.point_count, stats.map_points, stats.bearing_landmarks,
@@ -138,12 +171,13 @@ Java_com_example_slamtorch_MainActivity_nativeGetDebugStats(JNIEnv* env, jobject
         depthMode, stats.depth_width, stats.depth_height, stats.depth_min_m, stats.depth_max_m,
         stats.voxels_used, stats.points_fused_per_second, stats.map_enabled, stats.depth_overlay_enabled,
         failureReason, stats.planes_enabled, depthMeshMode, stats.depth_mesh_wireframe,
-        stats.depth_mesh_width, stats.depth_mesh_height, stats.depth_mesh_valid_ratio);
+        stats.depth_mesh_width, stats.depth_mesh_height, stats.depth_mesh_valid_ratio, stageTimings);
     
     env->DeleteLocalRef(trackingState);
     env->DeleteLocalRef(torchMode);
     env->DeleteLocalRef(depthMode);
     env->DeleteLocalRef(depthMeshMode);
+    env->DeleteLocalRef(stageTimings);
     env->DeleteLocalRef(failureReason);
     return result;
 }
@@ -1,362 +1,500 @@
 #include "LandmarkMap.h"
-#include "AndroidOut.h"
-#include <android/log.h>
+#include "Log.h"
+#include "OpenAddressing.h"
 #include <algorithm>
 #include <cmath>
-#include <cstring>
 
-namespace {
-const char* kVertexShader = R"(
-    #version 300 es
-    precision highp float;
-    layout(location = 0) in vec3 a_Position;
-    layout(location = 1) in vec4 a_Color;
-    uniform mat4 u_MVP;
-    out vec4 v_Color;
-    void main() {
-        gl_Position = u_MVP * vec4(a_Position, 1.0);
-        gl_PointSize = 6.0;
-        v_Color = a_Color;
-    }
-)";
-
-const char* kFragmentShader = R"(
-    #version 300 es
-    precision mediump float;
-    in vec4 v_Color;
-    out vec4 FragColor;
-    void main() {
-        vec2 coord = gl_PointCoord - vec2(0.5);
-        if (length(coord) > 0.5) discard;
-        FragColor = v_Color;
-    }
-)";
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SLAMTORCH_LANDMARK_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SLAMTORCH_LANDMARK_SSE 1
+#endif
 
+namespace {
 constexpr float kDedupeDistance = 0.05f;
-constexpr int kMaxAge = 300;
-constexpr float kMinConfidence = 0.05f;
 constexpr float kBearingDotThreshold = 0.995f;
-constexpr float kFakeDepthBase = 2.0f;
-constexpr float kFakeDepthGrowth = 0.05f;
-constexpr float kFakeDepthMax = 6.0f;
+// A tracked metric observation further than this from its landmark has
+// likely slipped onto another surface and is associated afresh.
+constexpr float kTrackGateDistance = 0.2f;
+// Dirty runs this close merge into one range.
+constexpr int kDirtyMergeGap = 16;
+
+// out[i] = |(xs[i], ys[i], zs[i]) - p|^2, 4 candidates at a time.
+void SquaredDistances(const float* xs, const float* ys, const float* zs, int count,
+                      const float* p, float* out) {
+    int i = 0;
+#if defined(SLAMTORCH_LANDMARK_NEON)
+    const float32x4_t px = vdupq_n_f32(p[0]);
+    const float32x4_t py = vdupq_n_f32(p[1]);
+    const float32x4_t pz = vdupq_n_f32(p[2]);
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t dx = vsubq_f32(vld1q_f32(xs + i), px);
+        const float32x4_t dy = vsubq_f32(vld1q_f32(ys + i), py);
+        const float32x4_t dz = vsubq_f32(vld1q_f32(zs + i), pz);
+        vst1q_f32(out + i, vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz));
+    }
+#elif defined(SLAMTORCH_LANDMARK_SSE)
+    const __m128 px = _mm_set1_ps(p[0]);
+    const __m128 py = _mm_set1_ps(p[1]);
+    const __m128 pz = _mm_set1_ps(p[2]);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), px);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), py);
+        const __m128 dz = _mm_sub_ps(_mm_loadu_ps(zs + i), pz);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                          _mm_mul_ps(dz, dz)));
+    }
+#endif
+    for (; i < count; ++i) {
+        const float dx = xs[i] - p[0];
+        const float dy = ys[i] - p[1];
+        const float dz = zs[i] - p[2];
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
 }
 
-LandmarkMap::LandmarkMap(int max_points)
-    : max_points_(max_points) {
-    landmarks_ = new Landmark[max_points_];
-    vertex_buffer_ = new Vertex[max_points_];
-    memset(landmarks_, 0, sizeof(Landmark) * max_points_);
-    memset(vertex_buffer_, 0, sizeof(Vertex) * max_points_);
-    InitGL();
-    __android_log_print(ANDROID_LOG_INFO, "SlamTorch", "LandmarkMap initialized: max=%d", max_points_);
+// out[i] = (xs[i], ys[i], zs[i]) . d, 4 candidates at a time.
+void DotProducts(const float* xs, const float* ys, const float* zs, int count,
+                 const float* d, float* out) {
+    int i = 0;
+#if defined(SLAMTORCH_LANDMARK_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t dot = vmulq_n_f32(vld1q_f32(xs + i), d[0]);
+        dot = vmlaq_n_f32(dot, vld1q_f32(ys + i), d[1]);
+        dot = vmlaq_n_f32(dot, vld1q_f32(zs + i), d[2]);
+        vst1q_f32(out + i, dot);
+    }
+#elif defined(SLAMTORCH_LANDMARK_SSE)
+    const __m128 dx = _mm_set1_ps(d[0]);
+    const __m128 dy = _mm_set1_ps(d[1]);
+    const __m128 dz = _mm_set1_ps(d[2]);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs + i), dx),
+                                                 _mm_mul_ps(_mm_loadu_ps(ys + i), dy)),
+                                      _mm_mul_ps(_mm_loadu_ps(zs + i), dz));
+        _mm_storeu_ps(out + i, dot);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = xs[i] * d[0] + ys[i] * d[1] + zs[i] * d[2];
+    }
+}
 }
 
-LandmarkMap::~LandmarkMap() {
-    CleanupGL();
-    delete[] landmarks_;
-    delete[] vertex_buffer_;
+LandmarkMap::LandmarkMap(int max_points)
+    : max_points_(max_points),
+      metric_index_(max_points, kDedupeDistance),
+      // Unit vectors with dot > t are closer than sqrt(2 - 2t).
+      bearing_index_(max_points, std::sqrt(2.0f * (1.0f - kBearingDotThreshold))) {
+    const size_t size = static_cast<size_t>(max_points_);
+    x_.Allocate(size);
+    y_.Allocate(size);
+    z_.Allocate(size);
+    bearing_x_.Allocate(size);
+    bearing_y_.Allocate(size);
+    bearing_z_.Allocate(size);
+    confidence_.Allocate(size);
+    seen_confidence_.Allocate(size);
+    last_seen_.Allocate(size);
+    seen_count_.Allocate(size);
+    birth_frame_.Allocate(size);
+    flags_.Allocate(size);
+    dirty_.Allocate(size);
+    track_id_.Allocate(size);
+    uint32_t table_size = 64;
+    while (table_size < size * 2) {
+        table_size <<= 1;
+    }
+    track_table_.assign(table_size, -1);
+    track_table_mask_ = table_size - 1;
+    claim_batch_.assign(static_cast<size_t>(max_points_), -1);
+    claim_observation_.assign(static_cast<size_t>(max_points_), -1);
+    LogPrint(LogLevel::INFO, "LandmarkMap initialized: max=%d", max_points_);
 }
 
 void LandmarkMap::BeginFrame() {
     frame_index_++;
+    // Landmarks not seen for a while fade out and leave the indices. The
+    // renderer applies the same fade, so only the final drop to 0 is dirty.
+    const int stale_before = frame_index_ - kStaleFrames;
+    const int* last_seen = last_seen_.Data();
+    float* confidence = confidence_.Data();
     for (int i = 0; i < point_count_; ++i) {
-        Landmark& lm = landmarks_[i];
-        if (frame_index_ - lm.last_seen > 30) {
-            lm.confidence *= 0.99f;
-            if (lm.confidence < kMinConfidence) {
-                lm.confidence = 0.0f;
-            }
+        if (last_seen[i] >= stale_before || confidence[i] <= 0.0f) continue;
+        confidence[i] *= kStaleDecay;
+        if (confidence[i] < kMinConfidence) {
+            confidence[i] = 0.0f;
+            Reindex(i);
+            MarkDirty(i);
         }
-        lm.age = std::min(lm.age + 1, kMaxAge);
     }
 }
 
-void LandmarkMap::AddMetricObservation(const float* world_pos, const float* bearing, float confidence) {
-    if (!world_pos) return;
-    if (!bearing) return;
-    if (confidence <= 0.0f) return;
-
-    const float dx_thresh = kDedupeDistance * kDedupeDistance;
-    int best_index = -1;
-    float best_dist = dx_thresh;
-
-    for (int i = 0; i < point_count_; ++i) {
-        Landmark& lm = landmarks_[i];
-        if (lm.confidence <= 0.0f || !lm.has_metric_depth) continue;
-        const float dx = lm.x - world_pos[0];
-        const float dy = lm.y - world_pos[1];
-        const float dz = lm.z - world_pos[2];
-        const float dist = dx * dx + dy * dy + dz * dz;
-        if (dist < best_dist) {
-            best_dist = dist;
-            best_index = i;
+void LandmarkMap::AddObservations(const Observation* observations, int count, int* out_landmarks) {
+    if (!observations || count <= 0) return;
+    batch_id_++;
+    batch_matches_.assign(static_cast<size_t>(count), Match());
+    batch_order_.clear();
+    for (int i = 0; i < count; ++i) {
+        if (out_landmarks) {
+            out_landmarks[i] = -1;
+        }
+        if (observations[i].confidence <= 0.0f) continue;
+        batch_matches_[i] = FindTrackMatch(observations[i]);
+        if (batch_matches_[i].landmark < 0) {
+            batch_matches_[i] = FindMatch(observations[i], false);
         }
+        batch_order_.push_back(i);
     }
 
-    if (best_index >= 0) {
-        Landmark& lm = landmarks_[best_index];
-        const float blend = 0.2f;
-        lm.x = lm.x * (1.0f - blend) + world_pos[0] * blend;
-        lm.y = lm.y * (1.0f - blend) + world_pos[1] * blend;
-        lm.z = lm.z * (1.0f - blend) + world_pos[2] * blend;
-        lm.bearing[0] = lm.bearing[0] * (1.0f - blend) + bearing[0] * blend;
-        lm.bearing[1] = lm.bearing[1] * (1.0f - blend) + bearing[1] * blend;
-        lm.bearing[2] = lm.bearing[2] * (1.0f - blend) + bearing[2] * blend;
-        lm.confidence = std::min(1.0f, lm.confidence + confidence * 0.2f);
-        lm.last_seen = frame_index_;
-        lm.seen_count++;
-        return;
+    // Best matches claim their landmark first. An observation whose landmark
+    // was already claimed falls back to its best unclaimed one.
+    std::sort(batch_order_.begin(), batch_order_.end(), [this](int a, int b) {
+        const Match& match_a = batch_matches_[a];
+        const Match& match_b = batch_matches_[b];
+        if ((match_a.landmark >= 0) != (match_b.landmark >= 0)) return match_a.landmark >= 0;
+        if (match_a.score != match_b.score) return match_a.score < match_b.score;
+        return a < b;
+    });
+    for (int i : batch_order_) {
+        Match& match = batch_matches_[i];
+        if (match.landmark < 0) break;
+        if (IsClaimed(match.landmark)) {
+            match = FindMatch(observations[i], true);
+            if (match.landmark < 0) continue;
+        }
+        claim_batch_[match.landmark] = batch_id_;
+        claim_observation_[match.landmark] = i;
     }
 
-    int bearing_index = -1;
-    float best_dot = kBearingDotThreshold;
-    for (int i = 0; i < point_count_; ++i) {
-        Landmark& lm = landmarks_[i];
-        if (lm.confidence <= 0.0f || lm.has_metric_depth) continue;
-        const float dot = lm.bearing[0] * bearing[0] +
-                          lm.bearing[1] * bearing[1] +
-                          lm.bearing[2] * bearing[2];
-        if (dot > best_dot) {
-            best_dot = dot;
-            bearing_index = i;
+    // Updates go first so a new landmark never lands in a claimed slot before
+    // its update. A slot the ring reuses within the batch loses its claimant.
+    for (int i = 0; i < count; ++i) {
+        const Match& match = batch_matches_[i];
+        if (observations[i].confidence <= 0.0f || match.landmark < 0) continue;
+        ApplyMatch(observations[i], match);
+        if (out_landmarks) {
+            out_landmarks[i] = match.landmark;
         }
     }
-
-    if (bearing_index >= 0) {
-        Landmark& lm = landmarks_[bearing_index];
-        lm.x = world_pos[0];
-        lm.y = world_pos[1];
-        lm.z = world_pos[2];
-        lm.has_metric_depth = true;
-        lm.confidence = std::min(1.0f, lm.confidence + confidence * 0.3f);
-        lm.last_seen = frame_index_;
-        lm.seen_count++;
-        return;
+    for (int i = 0; i < count; ++i) {
+        if (observations[i].confidence <= 0.0f || batch_matches_[i].landmark >= 0) continue;
+        const int slot = CreateLandmark(observations[i]);
+        if (out_landmarks) {
+            if (IsClaimed(slot)) {
+                out_landmarks[claim_observation_[slot]] = -1;
+            }
+            out_landmarks[i] = slot;
+        }
+        claim_batch_[slot] = batch_id_;
+        claim_observation_[slot] = i;
     }
+}
 
-    int idx = write_index_;
-    landmarks_[idx].x = world_pos[0];
-    landmarks_[idx].y = world_pos[1];
-    landmarks_[idx].z = world_pos[2];
-    landmarks_[idx].bearing[0] = bearing[0];
-    landmarks_[idx].bearing[1] = bearing[1];
-    landmarks_[idx].bearing[2] = bearing[2];
-    landmarks_[idx].confidence = std::min(1.0f, confidence);
-    landmarks_[idx].age = 0;
-    landmarks_[idx].last_seen = frame_index_;
-    landmarks_[idx].seen_count = 1;
-    landmarks_[idx].has_metric_depth = true;
-
-    write_index_ = (write_index_ + 1) % max_points_;
-    if (point_count_ < max_points_) {
-        point_count_++;
-    }
+void LandmarkMap::AddMetricObservation(const float* world_pos, const float* bearing, float confidence) {
+    if (!world_pos) return;
+    if (!bearing) return;
+    Observation observation;
+    std::copy(world_pos, world_pos + 3, observation.world_pos);
+    std::copy(bearing, bearing + 3, observation.bearing);
+    observation.confidence = confidence;
+    observation.has_metric_depth = true;
+    AddObservations(&observation, 1, nullptr);
 }
 
 void LandmarkMap::AddBearingObservation(const float* bearing, float confidence) {
     if (!bearing) return;
-    if (confidence <= 0.0f) return;
+    Observation observation;
+    std::copy(bearing, bearing + 3, observation.bearing);
+    observation.confidence = confidence;
+    observation.has_metric_depth = false;
+    AddObservations(&observation, 1, nullptr);
+}
 
-    int best_index = -1;
-    float best_dot = kBearingDotThreshold;
-    for (int i = 0; i < point_count_; ++i) {
-        Landmark& lm = landmarks_[i];
-        if (lm.confidence <= 0.0f || lm.has_metric_depth) continue;
-        const float dot = lm.bearing[0] * bearing[0] +
-                          lm.bearing[1] * bearing[1] +
-                          lm.bearing[2] * bearing[2];
-        if (dot > best_dot) {
-            best_dot = dot;
-            best_index = i;
-        }
+LandmarkMap::Match LandmarkMap::FindTrackMatch(const Observation& observation) const {
+    Match match;
+    if (observation.track_id == 0) return match;
+    const int entry = FindTrackEntry(observation.track_id);
+    if (entry < 0) return match;
+    const int i = track_table_[entry];
+    const bool metric = (flags_[i] & kFlagMetric) != 0;
+    if (observation.has_metric_depth && metric) {
+        const float dx = x_[i] - observation.world_pos[0];
+        const float dy = y_[i] - observation.world_pos[1];
+        const float dz = z_[i] - observation.world_pos[2];
+        if (dx * dx + dy * dy + dz * dz > kTrackGateDistance * kTrackGateDistance) return match;
     }
+    // Ahead of every spatial match, so the track keeps its landmark.
+    match.landmark = i;
+    match.score = -1.0f;
+    match.promote = observation.has_metric_depth && !metric;
+    return match;
+}
 
-    if (best_index >= 0) {
-        Landmark& lm = landmarks_[best_index];
-        const float blend = 0.2f;
-        lm.bearing[0] = lm.bearing[0] * (1.0f - blend) + bearing[0] * blend;
-        lm.bearing[1] = lm.bearing[1] * (1.0f - blend) + bearing[1] * blend;
-        lm.bearing[2] = lm.bearing[2] * (1.0f - blend) + bearing[2] * blend;
-        lm.confidence = std::min(1.0f, lm.confidence + confidence * 0.2f);
-        lm.last_seen = frame_index_;
-        lm.seen_count++;
-        return;
+LandmarkMap::Match LandmarkMap::FindMatch(const Observation& observation, bool skip_claimed) {
+    Match match;
+    if (observation.has_metric_depth) {
+        match.landmark = FindNearestMetric(observation.world_pos, skip_claimed, &match.score);
+        if (match.landmark >= 0) return match;
+        match.promote = true;
     }
+    match.landmark = FindNearestBearing(observation.bearing, skip_claimed, &match.score);
+    return match;
+}
 
-    int idx = write_index_;
-    landmarks_[idx] = Landmark();
-    landmarks_[idx].bearing[0] = bearing[0];
-    landmarks_[idx].bearing[1] = bearing[1];
-    landmarks_[idx].bearing[2] = bearing[2];
-    landmarks_[idx].confidence = std::min(1.0f, confidence);
-    landmarks_[idx].age = 0;
-    landmarks_[idx].last_seen = frame_index_;
-    landmarks_[idx].seen_count = 1;
-    landmarks_[idx].has_metric_depth = false;
-
-    write_index_ = (write_index_ + 1) % max_points_;
-    if (point_count_ < max_points_) {
-        point_count_++;
+int LandmarkMap::FindNearestMetric(const float* world_pos, bool skip_claimed, float* out_score) {
+    candidates_.clear();
+    candidate_x_.clear();
+    candidate_y_.clear();
+    candidate_z_.clear();
+    metric_index_.ForEachNear(world_pos, [&](int i) {
+        if (skip_claimed && IsClaimed(i)) return;
+        candidates_.push_back(i);
+        candidate_x_.push_back(x_[i]);
+        candidate_y_.push_back(y_[i]);
+        candidate_z_.push_back(z_[i]);
+    });
+    const int count = static_cast<int>(candidates_.size());
+    candidate_values_.resize(candidates_.size());
+    SquaredDistances(candidate_x_.data(), candidate_y_.data(), candidate_z_.data(), count,
+                     world_pos, candidate_values_.data());
+
+    const float max_dist = kDedupeDistance * kDedupeDistance;
+    int best = -1;
+    float best_dist = max_dist;
+    for (int i = 0; i < count; ++i) {
+        if (candidate_values_[i] < best_dist) {
+            best_dist = candidate_values_[i];
+            best = i;
+        }
     }
+    if (best < 0) return -1;
+    *out_score = best_dist / max_dist;
+    return candidates_[best];
 }
 
-int LandmarkMap::GetMetricCount() const {
-    int count = 0;
-    for (int i = 0; i < point_count_; ++i) {
-        const Landmark& lm = landmarks_[i];
-        if (lm.confidence > 0.0f && lm.has_metric_depth) {
-            count++;
+int LandmarkMap::FindNearestBearing(const float* bearing, bool skip_claimed, float* out_score) {
+    candidates_.clear();
+    candidate_x_.clear();
+    candidate_y_.clear();
+    candidate_z_.clear();
+    bearing_index_.ForEachNear(bearing, [&](int i) {
+        if (skip_claimed && IsClaimed(i)) return;
+        candidates_.push_back(i);
+        candidate_x_.push_back(bearing_x_[i]);
+        candidate_y_.push_back(bearing_y_[i]);
+        candidate_z_.push_back(bearing_z_[i]);
+    });
+    const int count = static_cast<int>(candidates_.size());
+    candidate_values_.resize(candidates_.size());
+    DotProducts(candidate_x_.data(), candidate_y_.data(), candidate_z_.data(), count,
+                bearing, candidate_values_.data());
+
+    int best = -1;
+    float best_dot = kBearingDotThreshold;
+    for (int i = 0; i < count; ++i) {
+        if (candidate_values_[i] > best_dot) {
+            best_dot = candidate_values_[i];
+            best = i;
         }
     }
-    return count;
+    if (best < 0) return -1;
+    *out_score = (1.0f - best_dot) / (1.0f - kBearingDotThreshold);
+    return candidates_[best];
 }
 
-int LandmarkMap::GetBearingCount() const {
-    int count = 0;
-    for (int i = 0; i < point_count_; ++i) {
-        const Landmark& lm = landmarks_[i];
-        if (lm.confidence > 0.0f && !lm.has_metric_depth) {
-            count++;
+void LandmarkMap::ApplyMatch(const Observation& observation, const Match& match) {
+    const int i = match.landmark;
+    const float* world_pos = observation.world_pos;
+    const float* bearing = observation.bearing;
+    const float blend = 0.2f;
+    if (match.promote) {
+        x_[i] = world_pos[0];
+        y_[i] = world_pos[1];
+        z_[i] = world_pos[2];
+        flags_[i] |= kFlagMetric;
+        confidence_[i] = std::min(1.0f, confidence_[i] + observation.confidence * 0.3f);
+    } else {
+        if (observation.has_metric_depth) {
+            x_[i] = x_[i] * (1.0f - blend) + world_pos[0] * blend;
+            y_[i] = y_[i] * (1.0f - blend) + world_pos[1] * blend;
+            z_[i] = z_[i] * (1.0f - blend) + world_pos[2] * blend;
         }
+        bearing_x_[i] = bearing_x_[i] * (1.0f - blend) + bearing[0] * blend;
+        bearing_y_[i] = bearing_y_[i] * (1.0f - blend) + bearing[1] * blend;
+        bearing_z_[i] = bearing_z_[i] * (1.0f - blend) + bearing[2] * blend;
+        confidence_[i] = std::min(1.0f, confidence_[i] + observation.confidence * 0.2f);
+    }
+    seen_confidence_[i] = confidence_[i];
+    last_seen_[i] = frame_index_;
+    seen_count_[i]++;
+    Reindex(i);
+    MarkDirty(i);
+    if (observation.track_id != 0) {
+        LinkTrack(i, observation.track_id);
     }
-    return count;
 }
 
-void LandmarkMap::InitGL() {
-    GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert_shader, 1, &kVertexShader, nullptr);
-    glCompileShader(vert_shader);
-
-    GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag_shader, 1, &kFragmentShader, nullptr);
-    glCompileShader(frag_shader);
-
-    program_ = glCreateProgram();
-    glAttachShader(program_, vert_shader);
-    glAttachShader(program_, frag_shader);
-    glLinkProgram(program_);
+int LandmarkMap::CreateLandmark(const Observation& observation) {
+    const int i = AllocateSlot();
+    const bool metric = observation.has_metric_depth;
+    x_[i] = metric ? observation.world_pos[0] : 0.0f;
+    y_[i] = metric ? observation.world_pos[1] : 0.0f;
+    z_[i] = metric ? observation.world_pos[2] : 0.0f;
+    bearing_x_[i] = observation.bearing[0];
+    bearing_y_[i] = observation.bearing[1];
+    bearing_z_[i] = observation.bearing[2];
+    confidence_[i] = std::min(1.0f, observation.confidence);
+    seen_confidence_[i] = confidence_[i];
+    birth_frame_[i] = frame_index_;
+    last_seen_[i] = frame_index_;
+    seen_count_[i] = 1;
+    flags_[i] = metric ? kFlagMetric : 0;
+    Reindex(i);
+    MarkDirty(i);
+    if (observation.track_id != 0) {
+        LinkTrack(i, observation.track_id);
+    }
+    return i;
+}
 
-    glDeleteShader(vert_shader);
-    glDeleteShader(frag_shader);
+int LandmarkMap::FindTrackLandmark(uint32_t track_id) const {
+    if (track_id == 0) return -1;
+    const int entry = FindTrackEntry(track_id);
+    return entry >= 0 ? track_table_[entry] : -1;
+}
 
-    mvp_uniform_ = glGetUniformLocation(program_, "u_MVP");
+int LandmarkMap::FindTrackEntry(uint32_t track_id) const {
+    uint32_t entry = HashTrack(track_id) & track_table_mask_;
+    while (true) {
+        const int index = track_table_[entry];
+        if (index < 0) return -1;
+        if (track_id_[index] == track_id) return static_cast<int>(entry);
+        entry = (entry + 1) & track_table_mask_;
+    }
+}
 
-    glGenVertexArrays(1, &vao_);
-    glGenBuffers(1, &vbo_);
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, max_points_ * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(0));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(sizeof(float) * 3));
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+void LandmarkMap::LinkTrack(int index, uint32_t track_id) {
+    if (track_id_[index] == track_id) return;
+    UnlinkTrack(index);
+    const int previous = FindTrackEntry(track_id);
+    if (previous >= 0) {
+        UnlinkTrack(track_table_[previous]);
+    }
+    track_id_[index] = track_id;
+    uint32_t entry = HashTrack(track_id) & track_table_mask_;
+    while (track_table_[entry] >= 0) {
+        entry = (entry + 1) & track_table_mask_;
+    }
+    track_table_[entry] = index;
 }
 
-void LandmarkMap::CleanupGL() {
-    if (vbo_) glDeleteBuffers(1, &vbo_);
-    if (vao_) glDeleteVertexArrays(1, &vao_);
-    if (program_) glDeleteProgram(program_);
+void LandmarkMap::UnlinkTrack(int index) {
+    const uint32_t track_id = track_id_[index];
+    if (track_id == 0) return;
+    const int entry = FindTrackEntry(track_id);
+    track_id_[index] = 0;
+    if (entry < 0) return;
+    BackwardShiftErase(&track_table_, track_table_mask_, static_cast<uint32_t>(entry),
+                       [this](int32_t slot) { return HashTrack(track_id_[slot]); });
 }
 
-void LandmarkMap::BuildColor(float confidence, int age, bool has_metric_depth, float* out_rgba) const {
-    if (confidence <= 0.0f) {
-        out_rgba[0] = 0.0f;
-        out_rgba[1] = 0.0f;
-        out_rgba[2] = 0.0f;
-        out_rgba[3] = 0.0f;
-        return;
+int LandmarkMap::AllocateSlot() {
+    const int idx = write_index_;
+    metric_index_.Remove(idx);
+    bearing_index_.Remove(idx);
+    UnlinkTrack(idx);
+    write_index_ = (write_index_ + 1) % max_points_;
+    if (point_count_ < max_points_) {
+        point_count_++;
     }
-    const float age_norm = std::min(1.0f, static_cast<float>(age) / static_cast<float>(kMaxAge));
-    const float conf = std::min(1.0f, confidence);
-    if (has_metric_depth) {
-        const float r = 0.2f + 0.8f * conf;
-        const float g = 0.4f + 0.6f * age_norm;
-        const float b = 1.0f - 0.5f * age_norm;
-        out_rgba[0] = r;
-        out_rgba[1] = g;
-        out_rgba[2] = b;
-        out_rgba[3] = 0.7f + 0.3f * conf;
+    return idx;
+}
+
+void LandmarkMap::Reindex(int index) {
+    if (confidence_[index] <= 0.0f) {
+        metric_index_.Remove(index);
+        bearing_index_.Remove(index);
+        UnlinkTrack(index);
+    } else if (flags_[index] & kFlagMetric) {
+        const float pos[3] = {x_[index], y_[index], z_[index]};
+        bearing_index_.Remove(index);
+        metric_index_.Move(index, pos);
     } else {
-        out_rgba[0] = 0.9f;
-        out_rgba[1] = 0.8f - 0.3f * age_norm;
-        out_rgba[2] = 0.2f + 0.2f * conf;
-        out_rgba[3] = 0.35f + 0.4f * conf;
+        const float bearing[3] = {bearing_x_[index], bearing_y_[index], bearing_z_[index]};
+        metric_index_.Remove(index);
+        bearing_index_.Move(index, bearing);
     }
 }
 
-void LandmarkMap::UpdateGLBuffer(const float* world_from_camera) {
-    if (point_count_ == 0) return;
-    if (!world_from_camera) return;
-    for (int i = 0; i < point_count_; ++i) {
-        Landmark& lm = landmarks_[i];
-        Vertex& v = vertex_buffer_[i];
-        if (lm.has_metric_depth) {
-            v.x = lm.x;
-            v.y = lm.y;
-            v.z = lm.z;
-        } else {
-            const float depth = std::min(kFakeDepthBase + kFakeDepthGrowth * lm.age, kFakeDepthMax);
-            const float x_cam = lm.bearing[0] * depth;
-            const float y_cam = lm.bearing[1] * depth;
-            const float z_cam = lm.bearing[2] * depth;
-            v.x = world_from_camera[0] * x_cam +
-                  world_from_camera[4] * y_cam +
-                  world_from_camera[8] * z_cam +
-                  world_from_camera[12];
-            v.y = world_from_camera[1] * x_cam +
-                  world_from_camera[5] * y_cam +
-                  world_from_camera[9] * z_cam +
-                  world_from_camera[13];
-            v.z = world_from_camera[2] * x_cam +
-                  world_from_camera[6] * y_cam +
-                  world_from_camera[10] * z_cam +
-                  world_from_camera[14];
-        }
-        float color[4];
-        BuildColor(lm.confidence, lm.age, lm.has_metric_depth, color);
-        v.r = color[0];
-        v.g = color[1];
-        v.b = color[2];
-        v.a = color[3];
-    }
+void LandmarkMap::MarkDirty(int index) {
+    if (dirty_[index]) return;
+    dirty_[index] = 1;
+    dirty_slots_.push_back(index);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, point_count_ * sizeof(Vertex), vertex_buffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+void LandmarkMap::ClearDirty() {
+    for (int index : dirty_slots_) {
+        dirty_[index] = 0;
+    }
+    dirty_slots_.clear();
 }
 
-void LandmarkMap::Draw(const float* view_matrix, const float* projection_matrix, const float* world_from_camera) {
-    if (point_count_ == 0) return;
+LandmarkMap::Vertex LandmarkMap::PackVertex(int index) const {
+    const bool metric = (flags_[index] & kFlagMetric) != 0;
+    Vertex v;
+    v.x = metric ? x_[index] : bearing_x_[index];
+    v.y = metric ? y_[index] : bearing_y_[index];
+    v.z = metric ? z_[index] : bearing_z_[index];
+    // The shader re-applies the stale decay, so a vertex repacked while stale
+    // must still carry the confidence it had when last seen.
+    const float confidence =
+        confidence_[index] <= 0.0f ? 0.0f : std::min(1.0f, std::max(0.0f, seen_confidence_[index]));
+    v.confidence = static_cast<uint16_t>(confidence * 65535.0f + 0.5f);
+    v.flags = metric ? kVertexMetric : 0;
+    v.birth_frame = birth_frame_[index];
+    v.last_seen = last_seen_[index];
+    return v;
+}
 
-    float mvp[16];
-    for (int row = 0; row < 4; ++row) {
-        for (int col = 0; col < 4; ++col) {
-            float sum = 0.0f;
-            for (int k = 0; k < 4; ++k) {
-                sum += projection_matrix[k * 4 + row] * view_matrix[col * 4 + k];
-            }
-            mvp[col * 4 + row] = sum;
+void LandmarkMap::CollectDirty(std::vector<SlotRange>* out_ranges, std::vector<Vertex>* out_vertices) {
+    out_ranges->clear();
+    out_vertices->clear();
+    if (dirty_slots_.empty()) return;
+    for (int slot : dirty_slots_) {
+        out_ranges->push_back(SlotRange{slot, slot + 1});
+    }
+    MergeRanges(out_ranges, kDirtyMergeGap, kMaxDirtyRanges);
+    for (const SlotRange& range : *out_ranges) {
+        for (int i = range.begin; i < range.end; ++i) {
+            out_vertices->push_back(PackVertex(i));
         }
     }
-
-    UpdateGLBuffer(world_from_camera);
-    glUseProgram(program_);
-    glUniformMatrix4fv(mvp_uniform_, 1, GL_FALSE, mvp);
-    glBindVertexArray(vao_);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDepthFunc(GL_LEQUAL);
-    glDrawArrays(GL_POINTS, 0, point_count_);
-    glBindVertexArray(0);
 }
 
 void LandmarkMap::Clear() {
     point_count_ = 0;
     write_index_ = 0;
     frame_index_ = 0;
-    memset(landmarks_, 0, sizeof(Landmark) * max_points_);
-    memset(vertex_buffer_, 0, sizeof(Vertex) * max_points_);
-    __android_log_print(ANDROID_LOG_INFO, "SlamTorch", "LandmarkMap cleared");
+    x_.Zero();
+    y_.Zero();
+    z_.Zero();
+    bearing_x_.Zero();
+    bearing_y_.Zero();
+    bearing_z_.Zero();
+    confidence_.Zero();
+    seen_confidence_.Zero();
+    last_seen_.Zero();
+    seen_count_.Zero();
+    birth_frame_.Zero();
+    flags_.Zero();
+    dirty_.Zero();
+    dirty_slots_.clear();
+    track_id_.Zero();
+    std::fill(track_table_.begin(), track_table_.end(), -1);
+    metric_index_.Clear();
+    bearing_index_.Clear();
+    LogPrint(LogLevel::INFO, "LandmarkMap cleared");
 }
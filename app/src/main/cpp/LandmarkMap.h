@@ -1,60 +1,150 @@
 #ifndef SLAMTORCH_LANDMARK_MAP_H
 #define SLAMTORCH_LANDMARK_MAP_H
 
-#include <GLES3/gl3.h>
+#include "AlignedBuffer.h"
+#include "SlotRange.h"
+#include "SpatialHashGrid.h"
 #include <cstdint>
+#include <vector>
 
+// Ring buffer of feature landmarks, metric or bearing-only. Storage is one
+// aligned array per field so scans only touch the fields they read.
 class LandmarkMap {
 public:
-    struct Landmark {
-        float x = 0.0f;
-        float y = 0.0f;
-        float z = 0.0f;
+    // Shared with LandmarkMapRenderer, whose vertex shader derives age,
+    // stale fading, colour and bearing-only placement from a Vertex.
+    static constexpr int kMaxAge = 300;
+    static constexpr int kStaleFrames = 30;
+    static constexpr float kStaleDecay = 0.99f;
+    static constexpr float kMinConfidence = 0.05f;
+    static constexpr float kFakeDepthBase = 2.0f;
+    static constexpr float kFakeDepthGrowth = 0.05f;
+    static constexpr float kFakeDepthMax = 6.0f;
+    static constexpr uint16_t kVertexMetric = 1;
+    // Dirty slots are reported as at most this many ranges.
+    static constexpr int kMaxDirtyRanges = 16;
+
+    // One landmark as of its last update; fading after that is left to the
+    // shader, so a vertex only changes when the landmark does.
+    struct Vertex {
+        // World position, or the unit camera-frame bearing for bearing-only.
+        float x, y, z;
+        // Confidence in 1/65535 units.
+        uint16_t confidence;
+        uint16_t flags;
+        int32_t birth_frame;
+        int32_t last_seen;
+    };
+
+    // One feature observation; world_pos is ignored without metric depth.
+    // track_id is the optical-flow track it came from, 0 for none.
+    struct Observation {
+        float world_pos[3] = {0.0f, 0.0f, 0.0f};
         float bearing[3] = {0.0f, 0.0f, -1.0f};
         float confidence = 0.0f;
-        int age = 0;
-        int last_seen = 0;
-        int seen_count = 0;
         bool has_metric_depth = false;
+        uint32_t track_id = 0;
     };
 
     explicit LandmarkMap(int max_points);
-    ~LandmarkMap();
 
     void BeginFrame();
+    // Associates a frame's observations against the landmarks that existed
+    // before the call. An observation whose track already owns a landmark
+    // updates it directly; the others are matched spatially. Better matches
+    // claim first and no two observations update the same landmark; the rest
+    // become new landmarks. Writes the slot each observation updated or
+    // created, or -1, to out_landmarks if given.
+    void AddObservations(const Observation* observations, int count, int* out_landmarks);
     void AddMetricObservation(const float* world_pos, const float* bearing, float confidence);
     void AddBearingObservation(const float* bearing, float confidence);
-    void Draw(const float* view_matrix, const float* projection_matrix, const float* world_from_camera);
     void Clear();
 
+    // Slots changed since the last ClearDirty(), merged into sorted ranges,
+    // and their vertices back to back. Nearby runs merge so a few clean
+    // vertices ride along instead of costing another upload.
+    void CollectDirty(std::vector<SlotRange>* out_ranges, std::vector<Vertex>* out_vertices);
+    void ClearDirty();
+
     int GetPointCount() const { return point_count_; }
-    int GetMetricCount() const;
-    int GetBearingCount() const;
+    // Live landmarks; the indices hold exactly these, so no scan is needed.
+    int GetMetricCount() const { return metric_index_.GetCount(); }
+    int GetBearingCount() const { return bearing_index_.GetCount(); }
     int GetFrameIndex() const { return frame_index_; }
+    // Slot of the landmark a track last updated, or -1.
+    int FindTrackLandmark(uint32_t track_id) const;
 
 private:
-    void InitGL();
-    void CleanupGL();
-    void UpdateGLBuffer(const float* world_from_camera);
-    void BuildColor(float confidence, int age, bool has_metric_depth, float* out_rgba) const;
+    struct Match {
+        int landmark = -1;
+        // 0 for an exact match, 1 at the association threshold.
+        float score = 0.0f;
+        // A metric observation upgrading a bearing-only landmark.
+        bool promote = false;
+    };
+
+    Match FindMatch(const Observation& observation, bool skip_claimed);
+    Match FindTrackMatch(const Observation& observation) const;
+    int FindNearestMetric(const float* world_pos, bool skip_claimed, float* out_score);
+    int FindNearestBearing(const float* bearing, bool skip_claimed, float* out_score);
+    bool IsClaimed(int index) const { return claim_batch_[index] == batch_id_; }
+    void ApplyMatch(const Observation& observation, const Match& match);
+    int CreateLandmark(const Observation& observation);
+    static uint32_t HashTrack(uint32_t track_id) { return track_id * 2654435761u; }
+    int FindTrackEntry(uint32_t track_id) const;
+    // Makes track_id own the landmark, dropping both sides' previous links.
+    void LinkTrack(int index, uint32_t track_id);
+    void UnlinkTrack(int index);
+    // Takes the ring-buffer slot for a new landmark, unindexing whatever it held.
+    int AllocateSlot();
+    // Files a landmark under the index matching its state, or drops it once dead.
+    void Reindex(int index);
+    void MarkDirty(int index);
+    Vertex PackVertex(int index) const;
+
+    static constexpr uint8_t kFlagMetric = 1;
 
     int max_points_ = 0;
-    Landmark* landmarks_ = nullptr;
+    AlignedBuffer<float> x_;
+    AlignedBuffer<float> y_;
+    AlignedBuffer<float> z_;
+    AlignedBuffer<float> bearing_x_;
+    AlignedBuffer<float> bearing_y_;
+    AlignedBuffer<float> bearing_z_;
+    AlignedBuffer<float> confidence_;
+    // confidence_ as of last_seen_, before any stale decay.
+    AlignedBuffer<float> seen_confidence_;
+    AlignedBuffer<int> last_seen_;
+    AlignedBuffer<int> seen_count_;
+    AlignedBuffer<int> birth_frame_;
+    AlignedBuffer<uint8_t> flags_;
+    AlignedBuffer<uint8_t> dirty_;
+    // Owning track per slot, 0 for none.
+    AlignedBuffer<uint32_t> track_id_;
     int point_count_ = 0;
     int write_index_ = 0;
     int frame_index_ = 0;
+    // Live metric landmarks by position, cells of the dedupe distance.
+    SpatialHashGrid metric_index_;
+    // Live bearing-only landmarks by unit bearing, cells of the chord length
+    // matching the bearing dot threshold.
+    SpatialHashGrid bearing_index_;
+    // Track id -> slot, open addressing with linear probing; -1 is empty.
+    std::vector<int32_t> track_table_;
+    uint32_t track_table_mask_ = 0;
+    std::vector<int> dirty_slots_;
 
-    // GL resources
-    GLuint vbo_ = 0;
-    GLuint vao_ = 0;
-    GLuint program_ = 0;
-    GLint mvp_uniform_ = -1;
-
-    struct Vertex {
-        float x, y, z;
-        float r, g, b, a;
-    };
-    Vertex* vertex_buffer_ = nullptr;
+    // AddObservations scratch, kept to avoid per-frame allocation.
+    int batch_id_ = 0;
+    std::vector<int> claim_batch_;
+    std::vector<int> claim_observation_;
+    std::vector<Match> batch_matches_;
+    std::vector<int> batch_order_;
+    std::vector<int> candidates_;
+    std::vector<float> candidate_x_;
+    std::vector<float> candidate_y_;
+    std::vector<float> candidate_z_;
+    std::vector<float> candidate_values_;
 };
 
 #endif // SLAMTORCH_LANDMARK_MAP_H
@@ -0,0 +1,188 @@
+#include "LandmarkMapRenderer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+const char* kVertexShaderVersion = "#version 300 es\n";
+
+// Follows the constants block built from LandmarkMap's in Initialize().
+const char* kVertexShader = R"(
+    precision highp float;
+    layout(location = 0) in vec3 a_Position;
+    layout(location = 1) in float a_Confidence;
+    layout(location = 2) in uint a_Flags;
+    // Birth frame, last seen frame.
+    layout(location = 3) in ivec2 a_Frames;
+    uniform mat4 u_MVP;
+    uniform mat4 u_WorldFromCamera;
+    uniform int u_Frame;
+    out vec4 v_Color;
+    void main() {
+        float age = float(min(u_Frame - a_Frames.x, kMaxAge));
+        float age_norm = age / float(kMaxAge);
+        // Same fade LandmarkMap::BeginFrame applies once a landmark is stale.
+        int stale_frames = max(u_Frame - a_Frames.y - kStaleFrames, 0);
+        float conf = min(a_Confidence * pow(kStaleDecay, float(stale_frames)), 1.0);
+        if (conf < kMinConfidence) conf = 0.0;
+
+        vec3 world = a_Position;
+        bool metric = (a_Flags & kVertexMetric) != 0u;
+        if (!metric) {
+            float depth = min(kFakeDepthBase + kFakeDepthGrowth * age, kFakeDepthMax);
+            world = (u_WorldFromCamera * vec4(a_Position * depth, 1.0)).xyz;
+        }
+        gl_Position = u_MVP * vec4(world, 1.0);
+        gl_PointSize = 6.0;
+
+        if (conf <= 0.0) {
+            v_Color = vec4(0.0);
+        } else if (metric) {
+            v_Color = vec4(0.2 + 0.8 * conf, 0.4 + 0.6 * age_norm, 1.0 - 0.5 * age_norm, 0.7 + 0.3 * conf);
+        } else {
+            v_Color = vec4(0.9, 0.8 - 0.3 * age_norm, 0.2 + 0.2 * conf, 0.35 + 0.4 * conf);
+        }
+    }
+)";
+
+const char* kFragmentShader = R"(
+    #version 300 es
+    precision mediump float;
+    in vec4 v_Color;
+    out vec4 FragColor;
+    void main() {
+        vec2 coord = gl_PointCoord - vec2(0.5);
+        if (length(coord) > 0.5) discard;
+        FragColor = v_Color;
+    }
+)";
+}
+
+LandmarkMapRenderer::~LandmarkMapRenderer() {
+    if (vbo_) glDeleteBuffers(1, &vbo_);
+    if (vao_) glDeleteVertexArrays(1, &vao_);
+    if (program_) glDeleteProgram(program_);
+}
+
+void LandmarkMapRenderer::Initialize(int max_points) {
+    max_points_ = max_points;
+
+    char constants[512];
+    snprintf(constants, sizeof(constants),
+             "const int kMaxAge = %d;\n"
+             "const int kStaleFrames = %d;\n"
+             "const float kStaleDecay = %.6f;\n"
+             "const float kMinConfidence = %.6f;\n"
+             "const float kFakeDepthBase = %.6f;\n"
+             "const float kFakeDepthGrowth = %.6f;\n"
+             "const float kFakeDepthMax = %.6f;\n"
+             "const uint kVertexMetric = %uu;\n",
+             LandmarkMap::kMaxAge, LandmarkMap::kStaleFrames, LandmarkMap::kStaleDecay,
+             LandmarkMap::kMinConfidence, LandmarkMap::kFakeDepthBase, LandmarkMap::kFakeDepthGrowth,
+             LandmarkMap::kFakeDepthMax, static_cast<unsigned>(LandmarkMap::kVertexMetric));
+    const char* vertex_sources[] = {kVertexShaderVersion, constants, kVertexShader};
+
+    GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vert_shader, 3, vertex_sources, nullptr);
+    glCompileShader(vert_shader);
+
+    GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(frag_shader, 1, &kFragmentShader, nullptr);
+    glCompileShader(frag_shader);
+
+    program_ = glCreateProgram();
+    glAttachShader(program_, vert_shader);
+    glAttachShader(program_, frag_shader);
+    glLinkProgram(program_);
+
+    glDeleteShader(vert_shader);
+    glDeleteShader(frag_shader);
+
+    mvp_uniform_ = glGetUniformLocation(program_, "u_MVP");
+    world_from_camera_uniform_ = glGetUniformLocation(program_, "u_WorldFromCamera");
+    frame_uniform_ = glGetUniformLocation(program_, "u_Frame");
+
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, max_points_ * sizeof(LandmarkMap::Vertex), nullptr, GL_DYNAMIC_DRAW);
+    const GLsizei stride = sizeof(LandmarkMap::Vertex);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void*>(offsetof(LandmarkMap::Vertex, x)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          reinterpret_cast<void*>(offsetof(LandmarkMap::Vertex, confidence)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, stride,
+                           reinterpret_cast<void*>(offsetof(LandmarkMap::Vertex, flags)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 2, GL_INT, stride,
+                           reinterpret_cast<void*>(offsetof(LandmarkMap::Vertex, birth_frame)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LandmarkMapRenderer::Update(const SlotRange* ranges, int range_count,
+                                 const LandmarkMap::Vertex* vertices, int point_count,
+                                 int frame_index, const float* world_from_camera) {
+    point_count_ = std::min(point_count, max_points_);
+    frame_index_ = frame_index;
+    if (world_from_camera) {
+        memcpy(world_from_camera_, world_from_camera, sizeof(world_from_camera_));
+    }
+    if (!ranges || !vertices || range_count <= 0) return;
+
+    // Invalidating just the written range lets the driver hand out fresh
+    // storage instead of waiting for draws still reading the old vertices.
+    // GLES 3.0 has no persistent mapping, so each range is mapped on its own.
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    const LandmarkMap::Vertex* src = vertices;
+    for (int r = 0; r < range_count; ++r) {
+        const int begin = std::max(ranges[r].begin, 0);
+        const int end = std::min(ranges[r].end, max_points_);
+        const int count = ranges[r].end - ranges[r].begin;
+        if (end > begin) {
+            const GLintptr offset = static_cast<GLintptr>(begin) * sizeof(LandmarkMap::Vertex);
+            const GLsizeiptr size = static_cast<GLsizeiptr>(end - begin) * sizeof(LandmarkMap::Vertex);
+            void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            if (dst) {
+                memcpy(dst, src + (begin - ranges[r].begin), static_cast<size_t>(size));
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            } else {
+                glBufferSubData(GL_ARRAY_BUFFER, offset, size, src + (begin - ranges[r].begin));
+            }
+        }
+        src += count;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LandmarkMapRenderer::Draw(const float* view_matrix, const float* projection_matrix) {
+    if (point_count_ == 0) return;
+
+    float mvp[16];
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                sum += projection_matrix[k * 4 + row] * view_matrix[col * 4 + k];
+            }
+            mvp[col * 4 + row] = sum;
+        }
+    }
+
+    glUseProgram(program_);
+    glUniformMatrix4fv(mvp_uniform_, 1, GL_FALSE, mvp);
+    glUniformMatrix4fv(world_from_camera_uniform_, 1, GL_FALSE, world_from_camera_);
+    glUniform1i(frame_uniform_, frame_index_);
+    glBindVertexArray(vao_);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthFunc(GL_LEQUAL);
+    glDrawArrays(GL_POINTS, 0, point_count_);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,43 @@
+#ifndef SLAMTORCH_LANDMARK_MAP_RENDERER_H
+#define SLAMTORCH_LANDMARK_MAP_RENDERER_H
+
+#include <GLES3/gl3.h>
+#include "LandmarkMap.h"
+#include "SlotRange.h"
+
+// Draws LandmarkMap vertices as round points. The GPU copy is patched with
+// the slot ranges that changed; colour, stale fading and bearing-only
+// placement come from the vertex shader, so unchanged landmarks cost no
+// upload.
+class LandmarkMapRenderer {
+public:
+    LandmarkMapRenderer() = default;
+    ~LandmarkMapRenderer();
+
+    void Initialize(int max_points);
+    // Applies one FramePipeline result: vertices holds the vertices of ranges
+    // back to back. frame_index and world_from_camera are the landmark map's
+    // frame and the pose bearing-only landmarks hang off.
+    void Update(const SlotRange* ranges, int range_count, const LandmarkMap::Vertex* vertices,
+                int point_count, int frame_index, const float* world_from_camera);
+    void Draw(const float* view_matrix, const float* projection_matrix);
+
+    int GetPointCount() const { return point_count_; }
+
+private:
+    GLuint vbo_ = 0;
+    GLuint vao_ = 0;
+    GLuint program_ = 0;
+    GLint mvp_uniform_ = -1;
+    GLint world_from_camera_uniform_ = -1;
+    GLint frame_uniform_ = -1;
+    int max_points_ = 0;
+    int point_count_ = 0;
+    int frame_index_ = 0;
+    float world_from_camera_[16] = {1.0f, 0.0f, 0.0f, 0.0f,
+                                    0.0f, 1.0f, 0.0f, 0.0f,
+                                    0.0f, 0.0f, 1.0f, 0.0f,
+                                    0.0f, 0.0f, 0.0f, 1.0f};
+};
+
+#endif // SLAMTORCH_LANDMARK_MAP_RENDERER_H
@@ -0,0 +1,35 @@
+#include "Log.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+namespace {
+void DefaultSink(LogLevel level, const char* message) {
+#ifdef __ANDROID__
+    static const int kPriorities[] = {ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR};
+    __android_log_print(kPriorities[static_cast<int>(level)], "SlamTorch", "%s", message);
+#else
+    static const char* kNames[] = {"D", "I", "W", "E"};
+    fprintf(stderr, "[%s] %s\n", kNames[static_cast<int>(level)], message);
+#endif
+}
+
+std::atomic<LogSink> g_sink{DefaultSink};
+}
+
+void SetLogSink(LogSink sink) {
+    g_sink.store(sink ? sink : DefaultSink, std::memory_order_release);
+}
+
+void LogPrint(LogLevel level, const char* format, ...) {
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    g_sink.load(std::memory_order_acquire)(level, message);
+}
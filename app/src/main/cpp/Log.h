@@ -0,0 +1,25 @@
+#ifndef SLAMTORCH_LOG_H
+#define SLAMTORCH_LOG_H
+
+// Logging for the platform-independent core. Messages go to logcat on Android
+// and to stderr elsewhere unless a sink is installed, e.g. by a host tool that
+// wants to silence or capture them.
+enum class LogLevel {
+    DEBUG,
+    INFO,
+    WARN,
+    ERROR
+};
+
+using LogSink = void (*)(LogLevel level, const char* message);
+
+// nullptr restores the default sink.
+void SetLogSink(LogSink sink);
+
+void LogPrint(LogLevel level, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+#endif // SLAMTORCH_LOG_H
@@ -0,0 +1,277 @@
+#include "MarchingCubesTables.h"
+
+// Corner i sits at kCornerOffsets[i]; edge e joins corners kEdgeCorners[e].
+const int8_t kMarchingCubesCornerOffsets[8][3] = {
+    {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+    {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1},
+};
+
+const int8_t kMarchingCubesEdgeCorners[12][2] = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0},
+    {4, 5}, {5, 6}, {6, 7}, {7, 4},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7},
+};
+
+// Generated by walking the inside/outside boundary on each cube face (inside
+// corners on ambiguous faces are always separated, so neighbouring cubes agree
+// and the surface is watertight), chaining the face segments into loops and
+// fanning each loop. Triangles are wound so cross(b - a, c - a) points towards
+// the positive side of the field.
+const int8_t kMarchingCubesTriangles[256][16] = {
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 0, 9, 2, 9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 9, 2, 9, 10, -1, -1, -1, -1, -1, -1, -1},
+    {3, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 8, 1, 8, 9, -1, -1, -1, -1, -1, -1, -1},
+    {3, 1, 10, 3, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 11, 0, 11, 8, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 10, 3, 10, 11, -1, -1, -1, -1, -1, -1, -1},
+    {8, 9, 10, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {7, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 7, 0, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 7, 1, 7, 4, 1, 4, 9, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 7, 0, 7, 4, -1, -1, -1, -1, -1, -1, -1},
+    {2, 0, 9, 2, 9, 10, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 7, 2, 7, 4, 2, 4, 9, 2, 9, 10, -1, -1, -1, -1},
+    {3, 2, 11, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 7, 0, 7, 4, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 11, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 7, 1, 7, 4, 1, 4, 9, -1, -1, -1, -1},
+    {3, 1, 10, 3, 10, 11, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 11, 0, 11, 7, 0, 7, 4, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 10, 3, 10, 11, 7, 4, 8, -1, -1, -1, -1},
+    {7, 4, 9, 7, 9, 10, 7, 10, 11, -1, -1, -1, -1, -1, -1, -1},
+    {4, 5, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 4, 1, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 4, 1, 4, 5, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 8, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1},
+    {2, 0, 4, 2, 4, 5, 2, 5, 10, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 4, 2, 4, 5, 2, 5, 10, -1, -1, -1, -1},
+    {3, 2, 11, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 8, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 4, 1, 4, 5, 3, 2, 11, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 8, 1, 8, 4, 1, 4, 5, -1, -1, -1, -1},
+    {3, 1, 10, 3, 10, 11, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 11, 0, 11, 8, 4, 5, 9, -1, -1, -1, -1},
+    {3, 0, 4, 3, 4, 5, 3, 5, 10, 3, 10, 11, -1, -1, -1, -1},
+    {4, 5, 10, 4, 10, 11, 4, 11, 8, -1, -1, -1, -1, -1, -1, -1},
+    {7, 5, 9, 7, 9, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 7, 0, 7, 5, 0, 5, 9, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 8, 1, 8, 7, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 7, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 7, 5, 9, 7, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 7, 0, 7, 5, 0, 5, 9, -1, -1, -1, -1},
+    {2, 0, 8, 2, 8, 7, 2, 7, 5, 2, 5, 10, -1, -1, -1, -1},
+    {2, 3, 7, 2, 7, 5, 2, 5, 10, -1, -1, -1, -1, -1, -1, -1},
+    {3, 2, 11, 7, 5, 9, 7, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 7, 0, 7, 5, 0, 5, 9, -1, -1, -1, -1},
+    {1, 0, 8, 1, 8, 7, 1, 7, 5, 3, 2, 11, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 7, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1},
+    {3, 1, 10, 3, 10, 11, 7, 5, 9, 7, 9, 8, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 11, 0, 11, 7, 0, 7, 5, 0, 5, 9, -1},
+    {3, 0, 8, 3, 8, 7, 3, 7, 5, 3, 5, 10, 3, 10, 11, -1},
+    {7, 5, 10, 7, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 9, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 6, 0, 3, 8, -1, -1, -1, -1, -1, -1, -1},
+    {2, 0, 9, 2, 9, 5, 2, 5, 6, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 9, 2, 9, 5, 2, 5, 6, -1, -1, -1, -1},
+    {3, 2, 11, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 8, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 11, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 8, 1, 8, 9, 5, 6, 10, -1, -1, -1, -1},
+    {3, 1, 5, 3, 5, 6, 3, 6, 11, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 5, 0, 5, 6, 0, 6, 11, 0, 11, 8, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 5, 3, 5, 6, 3, 6, 11, -1, -1, -1, -1},
+    {5, 6, 11, 5, 11, 8, 5, 8, 9, -1, -1, -1, -1, -1, -1, -1},
+    {5, 6, 10, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 7, 0, 7, 4, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 5, 6, 10, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 7, 1, 7, 4, 1, 4, 9, 5, 6, 10, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 6, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 6, 0, 3, 7, 0, 7, 4, -1, -1, -1, -1},
+    {2, 0, 9, 2, 9, 5, 2, 5, 6, 7, 4, 8, -1, -1, -1, -1},
+    {2, 3, 7, 2, 7, 4, 2, 4, 9, 2, 9, 5, 2, 5, 6, -1},
+    {3, 2, 11, 5, 6, 10, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 7, 0, 7, 4, 5, 6, 10, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 11, 5, 6, 10, 7, 4, 8, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 7, 1, 7, 4, 1, 4, 9, 5, 6, 10, -1},
+    {3, 1, 5, 3, 5, 6, 3, 6, 11, 7, 4, 8, -1, -1, -1, -1},
+    {0, 1, 5, 0, 5, 6, 0, 6, 11, 0, 11, 7, 0, 7, 4, -1},
+    {3, 0, 9, 3, 9, 5, 3, 5, 6, 3, 6, 11, 7, 4, 8, -1},
+    {5, 6, 11, 5, 11, 7, 5, 7, 4, 5, 4, 9, -1, -1, -1, -1},
+    {4, 6, 10, 4, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, 4, 6, 10, 4, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 4, 1, 4, 6, 1, 6, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 4, 1, 4, 6, 1, 6, 10, -1, -1, -1, -1},
+    {2, 1, 9, 2, 9, 4, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 9, 2, 9, 4, 2, 4, 6, 0, 3, 8, -1, -1, -1, -1},
+    {2, 0, 4, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 4, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1},
+    {3, 2, 11, 4, 6, 10, 4, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 8, 4, 6, 10, 4, 10, 9, -1, -1, -1, -1},
+    {1, 0, 4, 1, 4, 6, 1, 6, 10, 3, 2, 11, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 8, 1, 8, 4, 1, 4, 6, 1, 6, 10, -1},
+    {3, 1, 9, 3, 9, 4, 3, 4, 6, 3, 6, 11, -1, -1, -1, -1},
+    {0, 1, 9, 0, 9, 4, 0, 4, 6, 0, 6, 11, 0, 11, 8, -1},
+    {3, 0, 4, 3, 4, 6, 3, 6, 11, -1, -1, -1, -1, -1, -1, -1},
+    {4, 6, 11, 4, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {7, 6, 10, 7, 10, 9, 7, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 7, 0, 7, 6, 0, 6, 10, 0, 10, 9, -1, -1, -1, -1},
+    {1, 0, 8, 1, 8, 7, 1, 7, 6, 1, 6, 10, -1, -1, -1, -1},
+    {1, 3, 7, 1, 7, 6, 1, 6, 10, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 9, 2, 9, 8, 2, 8, 7, 2, 7, 6, -1, -1, -1, -1},
+    {2, 1, 9, 2, 9, 0, 2, 0, 3, 2, 3, 7, 2, 7, 6, -1},
+    {2, 0, 8, 2, 8, 7, 2, 7, 6, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 7, 2, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 2, 11, 7, 6, 10, 7, 10, 9, 7, 9, 8, -1, -1, -1, -1},
+    {0, 2, 11, 0, 11, 7, 0, 7, 6, 0, 6, 10, 0, 10, 9, -1},
+    {1, 0, 8, 1, 8, 7, 1, 7, 6, 1, 6, 10, 3, 2, 11, -1},
+    {1, 2, 11, 1, 11, 7, 1, 7, 6, 1, 6, 10, -1, -1, -1, -1},
+    {3, 1, 9, 3, 9, 8, 3, 8, 7, 3, 7, 6, 3, 6, 11, -1},
+    {0, 1, 9, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 8, 3, 8, 7, 3, 7, 6, 3, 6, 11, -1, -1, -1, -1},
+    {7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {6, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 9, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 8, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 0, 9, 2, 9, 10, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 9, 2, 9, 10, 6, 7, 11, -1, -1, -1, -1},
+    {3, 2, 6, 3, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 6, 0, 6, 7, 0, 7, 8, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 6, 3, 6, 7, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 6, 1, 6, 7, 1, 7, 8, 1, 8, 9, -1, -1, -1, -1},
+    {3, 1, 10, 3, 10, 6, 3, 6, 7, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 6, 0, 6, 7, 0, 7, 8, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 10, 3, 10, 6, 3, 6, 7, -1, -1, -1, -1},
+    {6, 7, 8, 6, 8, 9, 6, 9, 10, -1, -1, -1, -1, -1, -1, -1},
+    {6, 4, 8, 6, 8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 11, 0, 11, 6, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 6, 4, 8, 6, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 11, 1, 11, 6, 1, 6, 4, 1, 4, 9, -1, -1, -1, -1},
+    {2, 1, 10, 6, 4, 8, 6, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 11, 0, 11, 6, 0, 6, 4, -1, -1, -1, -1},
+    {2, 0, 9, 2, 9, 10, 6, 4, 8, 6, 8, 11, -1, -1, -1, -1},
+    {2, 3, 11, 2, 11, 6, 2, 6, 4, 2, 4, 9, 2, 9, 10, -1},
+    {3, 2, 6, 3, 6, 4, 3, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 6, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 6, 3, 6, 4, 3, 4, 8, -1, -1, -1, -1},
+    {1, 2, 6, 1, 6, 4, 1, 4, 9, -1, -1, -1, -1, -1, -1, -1},
+    {3, 1, 10, 3, 10, 6, 3, 6, 4, 3, 4, 8, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 6, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 10, 3, 10, 6, 3, 6, 4, 3, 4, 8, -1},
+    {6, 4, 9, 6, 9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 5, 9, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, 4, 5, 9, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 4, 1, 4, 5, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 4, 1, 4, 5, 6, 7, 11, -1, -1, -1, -1},
+    {2, 1, 10, 4, 5, 9, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 8, 4, 5, 9, 6, 7, 11, -1, -1, -1, -1},
+    {2, 0, 4, 2, 4, 5, 2, 5, 10, 6, 7, 11, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 4, 2, 4, 5, 2, 5, 10, 6, 7, 11, -1},
+    {3, 2, 6, 3, 6, 7, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 6, 0, 6, 7, 0, 7, 8, 4, 5, 9, -1, -1, -1, -1},
+    {1, 0, 4, 1, 4, 5, 3, 2, 6, 3, 6, 7, -1, -1, -1, -1},
+    {1, 2, 6, 1, 6, 7, 1, 7, 8, 1, 8, 4, 1, 4, 5, -1},
+    {3, 1, 10, 3, 10, 6, 3, 6, 7, 4, 5, 9, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 6, 0, 6, 7, 0, 7, 8, 4, 5, 9, -1},
+    {3, 0, 4, 3, 4, 5, 3, 5, 10, 3, 10, 6, 3, 6, 7, -1},
+    {4, 5, 10, 4, 10, 6, 4, 6, 7, 4, 7, 8, -1, -1, -1, -1},
+    {6, 5, 9, 6, 9, 8, 6, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 11, 0, 11, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1},
+    {1, 0, 8, 1, 8, 11, 1, 11, 6, 1, 6, 5, -1, -1, -1, -1},
+    {1, 3, 11, 1, 11, 6, 1, 6, 5, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 10, 6, 5, 9, 6, 9, 8, 6, 8, 11, -1, -1, -1, -1},
+    {2, 1, 10, 0, 3, 11, 0, 11, 6, 0, 6, 5, 0, 5, 9, -1},
+    {2, 0, 8, 2, 8, 11, 2, 11, 6, 2, 6, 5, 2, 5, 10, -1},
+    {2, 3, 11, 2, 11, 6, 2, 6, 5, 2, 5, 10, -1, -1, -1, -1},
+    {3, 2, 6, 3, 6, 5, 3, 5, 9, 3, 9, 8, -1, -1, -1, -1},
+    {0, 2, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 8, 1, 8, 3, 1, 3, 2, 1, 2, 6, 1, 6, 5, -1},
+    {1, 2, 6, 1, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 1, 10, 3, 10, 6, 3, 6, 5, 3, 5, 9, 3, 9, 8, -1},
+    {0, 1, 10, 0, 10, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1},
+    {3, 0, 8, 6, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {6, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {5, 7, 11, 5, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, 5, 7, 11, 5, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 5, 7, 11, 5, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 9, 5, 7, 11, 5, 11, 10, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 7, 2, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 7, 2, 7, 11, 0, 3, 8, -1, -1, -1, -1},
+    {2, 0, 9, 2, 9, 5, 2, 5, 7, 2, 7, 11, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 9, 2, 9, 5, 2, 5, 7, 2, 7, 11, -1},
+    {3, 2, 10, 3, 10, 5, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 10, 0, 10, 5, 0, 5, 7, 0, 7, 8, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 10, 3, 10, 5, 3, 5, 7, -1, -1, -1, -1},
+    {1, 2, 10, 1, 10, 5, 1, 5, 7, 1, 7, 8, 1, 8, 9, -1},
+    {3, 1, 5, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 5, 0, 5, 7, 0, 7, 8, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 5, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1},
+    {5, 7, 8, 5, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {5, 4, 8, 5, 8, 11, 5, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 11, 0, 11, 10, 0, 10, 5, 0, 5, 4, -1, -1, -1, -1},
+    {1, 0, 9, 5, 4, 8, 5, 8, 11, 5, 11, 10, -1, -1, -1, -1},
+    {1, 3, 11, 1, 11, 10, 1, 10, 5, 1, 5, 4, 1, 4, 9, -1},
+    {2, 1, 5, 2, 5, 4, 2, 4, 8, 2, 8, 11, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 4, 2, 4, 0, 2, 0, 3, 2, 3, 11, -1},
+    {2, 0, 9, 2, 9, 5, 2, 5, 4, 2, 4, 8, 2, 8, 11, -1},
+    {2, 3, 11, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 2, 10, 3, 10, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1},
+    {0, 2, 10, 0, 10, 5, 0, 5, 4, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 9, 3, 2, 10, 3, 10, 5, 3, 5, 4, 3, 4, 8, -1},
+    {1, 2, 10, 1, 10, 5, 1, 5, 4, 1, 4, 9, -1, -1, -1, -1},
+    {3, 1, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 5, 0, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1},
+    {5, 4, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 7, 11, 4, 11, 10, 4, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, 4, 7, 11, 4, 11, 10, 4, 10, 9, -1, -1, -1, -1},
+    {1, 0, 4, 1, 4, 7, 1, 7, 11, 1, 11, 10, -1, -1, -1, -1},
+    {1, 3, 8, 1, 8, 4, 1, 4, 7, 1, 7, 11, 1, 11, 10, -1},
+    {2, 1, 9, 2, 9, 4, 2, 4, 7, 2, 7, 11, -1, -1, -1, -1},
+    {2, 1, 9, 2, 9, 4, 2, 4, 7, 2, 7, 11, 0, 3, 8, -1},
+    {2, 0, 4, 2, 4, 7, 2, 7, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 4, 2, 4, 7, 2, 7, 11, -1, -1, -1, -1},
+    {3, 2, 10, 3, 10, 9, 3, 9, 4, 3, 4, 7, -1, -1, -1, -1},
+    {0, 2, 10, 0, 10, 9, 0, 9, 4, 0, 4, 7, 0, 7, 8, -1},
+    {1, 0, 4, 1, 4, 7, 1, 7, 3, 1, 3, 2, 1, 2, 10, -1},
+    {1, 2, 10, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 1, 9, 3, 9, 4, 3, 4, 7, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 9, 0, 9, 4, 0, 4, 7, 0, 7, 8, -1, -1, -1, -1},
+    {3, 0, 4, 3, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 8, 11, 9, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 11, 0, 11, 10, 0, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 8, 1, 8, 11, 1, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 11, 1, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 9, 2, 9, 8, 2, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 9, 2, 9, 0, 2, 0, 3, 2, 3, 11, -1, -1, -1, -1},
+    {2, 0, 8, 2, 8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 2, 10, 3, 10, 9, 3, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 10, 0, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 0, 8, 1, 8, 3, 1, 3, 2, 1, 2, 10, -1, -1, -1, -1},
+    {1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 1, 9, 3, 9, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+};
@@ -0,0 +1,13 @@
+#ifndef SLAMTORCH_MARCHING_CUBES_TABLES_H
+#define SLAMTORCH_MARCHING_CUBES_TABLES_H
+
+#include <cstdint>
+
+// Lookup tables for marching cubes. The cube index has bit i set when corner i
+// is inside (value < 0). Each triangle row lists edge indices in groups of
+// three, terminated by -1.
+extern const int8_t kMarchingCubesCornerOffsets[8][3];
+extern const int8_t kMarchingCubesEdgeCorners[12][2];
+extern const int8_t kMarchingCubesTriangles[256][16];
+
+#endif // SLAMTORCH_MARCHING_CUBES_TABLES_H
@@ -0,0 +1,36 @@
+#ifndef SLAMTORCH_OPEN_ADDRESSING_H
+#define SLAMTORCH_OPEN_ADDRESSING_H
+
+#include <cstdint>
+#include <vector>
+
+// Helpers shared by the power-of-two, linear-probing index tables that map
+// keys to slots of some external array, with -1 marking an empty entry.
+
+// Spatial hash of an integer cell coordinate (Teschner et al.).
+inline uint32_t HashCell(int x, int y, int z) {
+    return (static_cast<uint32_t>(x) * 73856093u) ^
+           (static_cast<uint32_t>(y) * 19349663u) ^
+           (static_cast<uint32_t>(z) * 83492791u);
+}
+
+// Empties table[slot] by backward-shift deletion: later entries of the probe
+// run are pulled into the hole so lookups never need tombstones. home(value)
+// returns the unmasked hash of the key stored as value.
+template <typename HomeFn>
+void BackwardShiftErase(std::vector<int32_t>* table, uint32_t mask, uint32_t slot, HomeFn&& home) {
+    int32_t* entries = table->data();
+    uint32_t hole = slot;
+    uint32_t next = (hole + 1) & mask;
+    while (entries[next] >= 0) {
+        const uint32_t ideal = home(entries[next]) & mask;
+        if (((next - ideal) & mask) >= ((next - hole) & mask)) {
+            entries[hole] = entries[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    entries[hole] = -1;
+}
+
+#endif // SLAMTORCH_OPEN_ADDRESSING_H
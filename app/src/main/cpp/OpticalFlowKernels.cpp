@@ -0,0 +1,655 @@
+#include "OpticalFlowKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SLAMTORCH_FLOW_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SLAMTORCH_FLOW_SSE 1
+#endif
+
+namespace {
+constexpr int kWindowRadius = OpticalFlowKernels::kWindowRadius;
+constexpr int kWindowSize = OpticalFlowKernels::kWindowSize;
+constexpr int kLanes = OpticalFlowKernels::kLanes;
+constexpr int kWeightBits = OpticalFlowKernels::kWeightBits;
+constexpr int kIterations = 6;
+constexpr float kMinDet = 1e-4f;
+// Interpolated intensities keep 5 fractional bits.
+constexpr int kValueBits = 5;
+constexpr int kDescale = kWeightBits - kValueBits;
+// Scharr responses and Q5 intensities are both 32x their slope/value, so the
+// normal equations are 1024x; the scale cancels in the solve but not in det.
+constexpr float kSystemScale = 1024.0f;
+
+using BilinearWeights = OpticalFlowKernels::BilinearWeights;
+
+// Q5 intensity at the top-left pixel p plus the weights' fraction.
+inline int SampleQ5(const uint8_t* p, int stride, const BilinearWeights& w) {
+    const int sum = p[0] * w.w00 + p[1] * w.w01 + p[stride] * w.w10 + p[stride + 1] * w.w11;
+    return (sum + (1 << (kDescale - 1))) >> kDescale;
+}
+
+#if defined(SLAMTORCH_FLOW_SSE)
+// Both weights in every 32-bit lane, lo in the low half, for _mm_madd_epi16.
+inline __m128i PairLanes(int16_t lo, int16_t hi) {
+    return _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(static_cast<uint16_t>(hi)) << 16 |
+                                           static_cast<uint16_t>(lo)));
+}
+#endif
+
+// Interleaved (gx, gy) Scharr responses of one interior row, 8 pixels at a time.
+void ScharrRow(const uint8_t* above, const uint8_t* row, const uint8_t* below, int16_t* out, int begin,
+               int end) {
+    int x = begin;
+#if defined(SLAMTORCH_FLOW_NEON)
+    for (; x + 8 <= end; x += 8) {
+        const int16x8_t a0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(above + x - 1)));
+        const int16x8_t a1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(above + x)));
+        const int16x8_t a2 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(above + x + 1)));
+        const int16x8_t b0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row + x - 1)));
+        const int16x8_t b2 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row + x + 1)));
+        const int16x8_t c0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(below + x - 1)));
+        const int16x8_t c1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(below + x)));
+        const int16x8_t c2 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(below + x + 1)));
+        int16x8x2_t g;
+        g.val[0] = vmlaq_n_s16(vmulq_n_s16(vsubq_s16(vaddq_s16(a2, c2), vaddq_s16(a0, c0)), 3),
+                               vsubq_s16(b2, b0), 10);
+        g.val[1] = vmlaq_n_s16(vmulq_n_s16(vsubq_s16(vaddq_s16(c0, c2), vaddq_s16(a0, a2)), 3),
+                               vsubq_s16(c1, a1), 10);
+        vst2q_s16(out + 2 * x, g);
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i three = _mm_set1_epi16(3);
+    const __m128i ten = _mm_set1_epi16(10);
+    auto load = [zero](const uint8_t* p) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+    };
+    for (; x + 8 <= end; x += 8) {
+        const __m128i a0 = load(above + x - 1);
+        const __m128i a1 = load(above + x);
+        const __m128i a2 = load(above + x + 1);
+        const __m128i b0 = load(row + x - 1);
+        const __m128i b2 = load(row + x + 1);
+        const __m128i c0 = load(below + x - 1);
+        const __m128i c1 = load(below + x);
+        const __m128i c2 = load(below + x + 1);
+        const __m128i gx = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_sub_epi16(_mm_add_epi16(a2, c2), _mm_add_epi16(a0, c0)), three),
+            _mm_mullo_epi16(_mm_sub_epi16(b2, b0), ten));
+        const __m128i gy = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_sub_epi16(_mm_add_epi16(c0, c2), _mm_add_epi16(a0, a2)), three),
+            _mm_mullo_epi16(_mm_sub_epi16(c1, a1), ten));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * x), _mm_unpacklo_epi16(gx, gy));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * x + 8), _mm_unpackhi_epi16(gx, gy));
+    }
+#endif
+    for (; x < end; ++x) {
+        out[2 * x] = static_cast<int16_t>(3 * (above[x + 1] + below[x + 1] - above[x - 1] - below[x - 1]) +
+                                          10 * (row[x + 1] - row[x - 1]));
+        out[2 * x + 1] = static_cast<int16_t>(3 * (below[x - 1] + below[x + 1] - above[x - 1] - above[x + 1]) +
+                                              10 * (below[x] - above[x]));
+    }
+}
+
+// dst[x] = (r0[2x] + r0[2x + 1] + r1[2x] + r1[2x + 1]) / 4, 16 outputs at a time.
+void DownsampleBoxRow(const uint8_t* r0, const uint8_t* r1, uint8_t* dst, int count) {
+    int x = 0;
+#if defined(SLAMTORCH_FLOW_NEON)
+    for (; x + 16 <= count; x += 16) {
+        uint16x8_t lo = vpaddlq_u8(vld1q_u8(r0 + 2 * x));
+        lo = vpadalq_u8(lo, vld1q_u8(r1 + 2 * x));
+        uint16x8_t hi = vpaddlq_u8(vld1q_u8(r0 + 2 * x + 16));
+        hi = vpadalq_u8(hi, vld1q_u8(r1 + 2 * x + 16));
+        vst1q_u8(dst + x, vcombine_u8(vshrn_n_u16(lo, 2), vshrn_n_u16(hi, 2)));
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    for (; x + 16 <= count; x += 16) {
+        __m128i sums[2];
+        for (int k = 0; k < 2; ++k) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + 2 * x + 16 * k));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 2 * x + 16 * k));
+            const __m128i pairs_a = _mm_add_epi16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8));
+            const __m128i pairs_b = _mm_add_epi16(_mm_and_si128(b, low_bytes), _mm_srli_epi16(b, 8));
+            sums[k] = _mm_srli_epi16(_mm_add_epi16(pairs_a, pairs_b), 2);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sums[0], sums[1]));
+    }
+#endif
+    for (; x < count; ++x) {
+        dst[x] = static_cast<uint8_t>((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1]) / 4);
+    }
+}
+
+// out[i] = r[0][i] + 4 r[1][i] + 6 r[2][i] + 4 r[3][i] + r[4][i], 16 columns at a time.
+void GaussianColumns(const uint8_t* const* r, uint16_t* out, int count) {
+    const uint8_t* r0 = r[0];
+    const uint8_t* r1 = r[1];
+    const uint8_t* r2 = r[2];
+    const uint8_t* r3 = r[3];
+    const uint8_t* r4 = r[4];
+    int i = 0;
+#if defined(SLAMTORCH_FLOW_NEON)
+    const uint8x8_t six = vdup_n_u8(6);
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16_t a = vld1q_u8(r0 + i);
+        const uint8x16_t b = vld1q_u8(r1 + i);
+        const uint8x16_t c = vld1q_u8(r2 + i);
+        const uint8x16_t d = vld1q_u8(r3 + i);
+        const uint8x16_t e = vld1q_u8(r4 + i);
+        uint16x8_t lo = vaddl_u8(vget_low_u8(a), vget_low_u8(e));
+        uint16x8_t hi = vaddl_u8(vget_high_u8(a), vget_high_u8(e));
+        lo = vaddq_u16(lo, vshlq_n_u16(vaddl_u8(vget_low_u8(b), vget_low_u8(d)), 2));
+        hi = vaddq_u16(hi, vshlq_n_u16(vaddl_u8(vget_high_u8(b), vget_high_u8(d)), 2));
+        lo = vmlal_u8(lo, vget_low_u8(c), six);
+        hi = vmlal_u8(hi, vget_high_u8(c), six);
+        vst1q_u16(out + i, lo);
+        vst1q_u16(out + i + 8, hi);
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i six = _mm_set1_epi16(6);
+    for (; i + 16 <= count; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + i));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r2 + i));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r3 + i));
+        const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r4 + i));
+        const __m128i outer_lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(e, zero));
+        const __m128i outer_hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(e, zero));
+        const __m128i inner_lo = _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(d, zero));
+        const __m128i inner_hi = _mm_add_epi16(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(d, zero));
+        const __m128i lo = _mm_add_epi16(_mm_add_epi16(outer_lo, _mm_slli_epi16(inner_lo, 2)),
+                                         _mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), six));
+        const __m128i hi = _mm_add_epi16(_mm_add_epi16(outer_hi, _mm_slli_epi16(inner_hi, 2)),
+                                         _mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), six));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), hi);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = static_cast<uint16_t>(r0[i] + 4 * r1[i] + 6 * r2[i] + 4 * r3[i] + r4[i]);
+    }
+}
+
+// dst[x] = (p[2x] + 4 p[2x + 1] + 6 p[2x + 2] + 4 p[2x + 3] + p[2x + 4] + 128) >> 8
+// over a row of length p_length, 8 outputs at a time.
+void GaussianDecimateRow(const uint16_t* p, int p_length, uint8_t* dst, int count) {
+    int x = 0;
+#if defined(SLAMTORCH_FLOW_NEON)
+    for (; x + 8 <= count && 2 * x + 20 <= p_length; x += 8) {
+        const uint16x8x2_t a = vld2q_u16(p + 2 * x);
+        const uint16x8x2_t b = vld2q_u16(p + 2 * x + 2);
+        const uint16x8_t c = vld2q_u16(p + 2 * x + 4).val[0];
+        uint16x8_t sum = vaddq_u16(a.val[0], c);
+        sum = vaddq_u16(sum, vshlq_n_u16(vaddq_u16(a.val[1], b.val[1]), 2));
+        sum = vmlaq_n_u16(sum, b.val[0], 6);
+        vst1_u8(dst + x, vrshrn_n_u16(sum, 8));
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    // Filters every column, then keeps the even ones.
+    const __m128i six = _mm_set1_epi16(6);
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i low_words = _mm_set1_epi32(0xFFFF);
+    for (; x + 8 <= count && 2 * x + 20 <= p_length; x += 8) {
+        __m128i even[2];
+        for (int k = 0; k < 2; ++k) {
+            const uint16_t* q = p + 2 * x + 8 * k;
+            __m128i v[5];
+            for (int t = 0; t < 5; ++t) {
+                v[t] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + t));
+            }
+            __m128i sum = _mm_add_epi16(v[0], v[4]);
+            sum = _mm_add_epi16(sum, _mm_slli_epi16(_mm_add_epi16(v[1], v[3]), 2));
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(v[2], six));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, half), 8);
+            even[k] = _mm_and_si128(sum, low_words);
+        }
+        const __m128i words = _mm_packs_epi32(even[0], even[1]);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(words, words));
+    }
+#endif
+    for (; x < count; ++x) {
+        const uint16_t* q = p + 2 * x;
+        dst[x] = static_cast<uint8_t>((q[0] + 4 * q[1] + 6 * q[2] + 4 * q[3] + q[4] + 128) >> 8);
+    }
+}
+
+// xx, xy, yy = gx * gx, gx * gy, gy * gy of count interleaved Scharr pairs.
+void GradientProducts(const int16_t* g, int count, float* xx, float* xy, float* yy) {
+    int i = 0;
+#if defined(SLAMTORCH_FLOW_NEON)
+    for (; i + 8 <= count; i += 8) {
+        const int16x8x2_t v = vld2q_s16(g + 2 * i);
+        const int16x4_t gx_lo = vget_low_s16(v.val[0]);
+        const int16x4_t gx_hi = vget_high_s16(v.val[0]);
+        const int16x4_t gy_lo = vget_low_s16(v.val[1]);
+        const int16x4_t gy_hi = vget_high_s16(v.val[1]);
+        vst1q_f32(xx + i, vcvtq_f32_s32(vmull_s16(gx_lo, gx_lo)));
+        vst1q_f32(xx + i + 4, vcvtq_f32_s32(vmull_s16(gx_hi, gx_hi)));
+        vst1q_f32(xy + i, vcvtq_f32_s32(vmull_s16(gx_lo, gy_lo)));
+        vst1q_f32(xy + i + 4, vcvtq_f32_s32(vmull_s16(gx_hi, gy_hi)));
+        vst1q_f32(yy + i, vcvtq_f32_s32(vmull_s16(gy_lo, gy_lo)));
+        vst1q_f32(yy + i + 4, vcvtq_f32_s32(vmull_s16(gy_hi, gy_hi)));
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    for (; i + 4 <= count; i += 4) {
+        // Each 32-bit lane holds one (gx, gy) pair; sign-extend both halves.
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + 2 * i));
+        const __m128 gx = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+        const __m128 gy = _mm_cvtepi32_ps(_mm_srai_epi32(v, 16));
+        _mm_storeu_ps(xx + i, _mm_mul_ps(gx, gx));
+        _mm_storeu_ps(xy + i, _mm_mul_ps(gx, gy));
+        _mm_storeu_ps(yy + i, _mm_mul_ps(gy, gy));
+    }
+#endif
+    for (; i < count; ++i) {
+        const float gx = g[2 * i];
+        const float gy = g[2 * i + 1];
+        xx[i] = gx * gx;
+        xy[i] = gx * gy;
+        yy[i] = gy * gy;
+    }
+}
+
+// out[i] = sum of src[i] over kWindowSize rows stride floats apart.
+void ColumnSum(const float* src, int stride, int count, float* out) {
+    int i = 0;
+#if defined(SLAMTORCH_FLOW_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t sum = vld1q_f32(src + i);
+        for (int r = 1; r < kWindowSize; ++r) {
+            sum = vaddq_f32(sum, vld1q_f32(src + r * stride + i));
+        }
+        vst1q_f32(out + i, sum);
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_loadu_ps(src + i);
+        for (int r = 1; r < kWindowSize; ++r) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(src + r * stride + i));
+        }
+        _mm_storeu_ps(out + i, sum);
+    }
+#endif
+    for (; i < count; ++i) {
+        float sum = src[i];
+        for (int r = 1; r < kWindowSize; ++r) {
+            sum += src[r * stride + i];
+        }
+        out[i] = sum;
+    }
+}
+
+// out[i] = sum of src[i..i + kWindowSize).
+void RowSum(const float* src, int count, float* out) {
+    int i = 0;
+#if defined(SLAMTORCH_FLOW_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t sum = vld1q_f32(src + i);
+        for (int c = 1; c < kWindowSize; ++c) {
+            sum = vaddq_f32(sum, vld1q_f32(src + i + c));
+        }
+        vst1q_f32(out + i, sum);
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_loadu_ps(src + i);
+        for (int c = 1; c < kWindowSize; ++c) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(src + i + c));
+        }
+        _mm_storeu_ps(out + i, sum);
+    }
+#endif
+    for (; i < count; ++i) {
+        float sum = src[i];
+        for (int c = 1; c < kWindowSize; ++c) {
+            sum += src[i + c];
+        }
+        out[i] = sum;
+    }
+}
+
+// Smaller eigenvalue of [[a, b], [b, c]], in place of a.
+void MinEigenvalues(float* a, const float* b, const float* c, int count) {
+    int i = 0;
+#if defined(SLAMTORCH_FLOW_NEON) && defined(__aarch64__)
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t va = vld1q_f32(a + i);
+        const float32x4_t vb = vld1q_f32(b + i);
+        const float32x4_t vc = vld1q_f32(c + i);
+        const float32x4_t mean = vmulq_f32(vaddq_f32(va, vc), half);
+        const float32x4_t diff = vmulq_f32(vsubq_f32(va, vc), half);
+        const float32x4_t radius = vsqrtq_f32(vmlaq_f32(vmulq_f32(diff, diff), vb, vb));
+        vst1q_f32(a + i, vsubq_f32(mean, radius));
+    }
+#elif defined(SLAMTORCH_FLOW_SSE)
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 va = _mm_loadu_ps(a + i);
+        const __m128 vb = _mm_loadu_ps(b + i);
+        const __m128 vc = _mm_loadu_ps(c + i);
+        const __m128 mean = _mm_mul_ps(_mm_add_ps(va, vc), half);
+        const __m128 diff = _mm_mul_ps(_mm_sub_ps(va, vc), half);
+        const __m128 radius = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(diff, diff), _mm_mul_ps(vb, vb)));
+        _mm_storeu_ps(a + i, _mm_sub_ps(mean, radius));
+    }
+#endif
+    for (; i < count; ++i) {
+        const float mean = 0.5f * (a[i] + c[i]);
+        const float diff = 0.5f * (a[i] - c[i]);
+        a[i] = mean - std::sqrt(diff * diff + b[i] * b[i]);
+    }
+}
+}
+
+// The fractions are quantized before the products are formed, so no weight
+// can round below zero: w11 never exceeds qx or qy, and w00 is the exact
+// (one - qx) * (one - qy) / one rounded.
+OpticalFlowKernels::BilinearWeights OpticalFlowKernels::MakeWeights(float fx, float fy) {
+    constexpr int one = 1 << kWeightBits;
+    const int qx = static_cast<int>(std::lround(fx * static_cast<float>(one)));
+    const int qy = static_cast<int>(std::lround(fy * static_cast<float>(one)));
+    const int w11 = (qx * qy + one / 2) >> kWeightBits;
+    BilinearWeights w;
+    w.w00 = static_cast<int16_t>(one - qx - qy + w11);
+    w.w01 = static_cast<int16_t>(qx - w11);
+    w.w10 = static_cast<int16_t>(qy - w11);
+    w.w11 = static_cast<int16_t>(w11);
+    return w;
+}
+
+void OpticalFlowKernels::DownsampleBox(const uint8_t* src, int src_w, int src_h, uint8_t* dst, int w, int h) {
+    const int pairs = src_w / 2;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* r0 = src + 2 * y * src_w;
+        const uint8_t* r1 = (2 * y + 1 < src_h) ? r0 + src_w : r0;
+        uint8_t* out = dst + y * w;
+        DownsampleBoxRow(r0, r1, out, pairs);
+        // An odd width leaves a last column without a right neighbour.
+        if (pairs < w) {
+            out[pairs] = static_cast<uint8_t>((2 * r0[src_w - 1] + 2 * r1[src_w - 1]) / 4);
+        }
+    }
+}
+
+void OpticalFlowKernels::DownsampleGaussian(const uint8_t* src, int src_w, int src_h, uint8_t* dst, int w, int h,
+                                            uint16_t* row) {
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* rows[5];
+        for (int k = 0; k < 5; ++k) {
+            const int sy = std::min(std::max(2 * y - 2 + k, 0), src_h - 1);
+            rows[k] = src + sy * src_w;
+        }
+        GaussianColumns(rows, row + 2, src_w);
+        row[0] = row[1] = row[2];
+        row[src_w + 2] = row[src_w + 3] = row[src_w + 1];
+        GaussianDecimateRow(row, src_w + 4, dst + y * w, w);
+    }
+}
+
+void OpticalFlowKernels::ScharrGradients(const uint8_t* image, int w, int h, int16_t* gradient) {
+    for (int y = 1; y < h - 1; ++y) {
+        ScharrRow(image + (y - 1) * w, image + y * w, image + (y + 1) * w, gradient + 2 * y * w, 1, w - 1);
+    }
+}
+
+const float* OpticalFlowKernels::MinEigenvalueScores(const int16_t* gradient, int w, int left, int top,
+                                                     int score_w, int score_h, std::vector<float>* scratch) {
+    const int product_w = score_w + 2 * kWindowRadius;
+    const int product_h = score_h + 2 * kWindowRadius;
+    // Three product planes, three score planes and three column-sum rows.
+    const size_t product_size = static_cast<size_t>(product_w * product_h);
+    const size_t score_size = static_cast<size_t>(score_w * score_h);
+    scratch->resize(3 * product_size + 3 * score_size + 3 * static_cast<size_t>(product_w));
+    float* xx = scratch->data();
+    float* xy = xx + product_size;
+    float* yy = xy + product_size;
+    float* score = yy + product_size;
+    float* score_xy = score + score_size;
+    float* score_yy = score_xy + score_size;
+    float* column_xx = score_yy + score_size;
+    float* column_xy = column_xx + product_w;
+    float* column_yy = column_xy + product_w;
+
+    for (int r = 0; r < product_h; ++r) {
+        const int y = top - kWindowRadius + r;
+        GradientProducts(gradient + 2 * (y * w + left - kWindowRadius), product_w, xx + r * product_w,
+                         xy + r * product_w, yy + r * product_w);
+    }
+    for (int r = 0; r < score_h; ++r) {
+        ColumnSum(xx + r * product_w, product_w, product_w, column_xx);
+        ColumnSum(xy + r * product_w, product_w, product_w, column_xy);
+        ColumnSum(yy + r * product_w, product_w, product_w, column_yy);
+        RowSum(column_xx, score_w, score + r * score_w);
+        RowSum(column_xy, score_w, score_xy + r * score_w);
+        RowSum(column_yy, score_w, score_yy + r * score_w);
+    }
+    MinEigenvalues(score, score_xy, score_yy, score_w * score_h);
+    return score;
+}
+
+void OpticalFlowKernels::BuildPatch(const uint8_t* image, const int16_t* gradient, int w, int h, float x, float y,
+                                    Patch* patch) {
+    const int ix = static_cast<int>(std::floor(x));
+    const int iy = static_cast<int>(std::floor(y));
+    const BilinearWeights wt = MakeWeights(x - static_cast<float>(ix), y - static_cast<float>(iy));
+    memset(patch->value, 0, sizeof(patch->value));
+    memset(patch->grad_x, 0, sizeof(patch->grad_x));
+    memset(patch->grad_y, 0, sizeof(patch->grad_y));
+    int a11 = 0;
+    int a12 = 0;
+    int a22 = 0;
+    for (int r = 0; r < kWindowSize; ++r) {
+        const int py = iy - kWindowRadius + r;
+        if (py < 1 || py + 2 >= h) continue;
+        for (int c = 0; c < kWindowSize; ++c) {
+            const int px = ix - kWindowRadius + c;
+            if (px < 1 || px + 2 >= w) continue;
+            const int16_t* g = gradient + 2 * (py * w + px);
+            const int stride = 2 * w;
+            const int gx = (g[0] * wt.w00 + g[2] * wt.w01 + g[stride] * wt.w10 + g[stride + 2] * wt.w11 +
+                            (1 << (kWeightBits - 1))) >> kWeightBits;
+            const int gy = (g[1] * wt.w00 + g[3] * wt.w01 + g[stride + 1] * wt.w10 + g[stride + 3] * wt.w11 +
+                            (1 << (kWeightBits - 1))) >> kWeightBits;
+            const int lane = r * kLanes + c;
+            patch->value[lane] = static_cast<int16_t>(SampleQ5(image + py * w + px, w, wt));
+            patch->grad_x[lane] = static_cast<int16_t>(gx);
+            patch->grad_y[lane] = static_cast<int16_t>(gy);
+            a11 += gx * gx;
+            a12 += gx * gy;
+            a22 += gy * gy;
+        }
+    }
+    patch->a11 = static_cast<float>(a11);
+    patch->a12 = static_cast<float>(a12);
+    patch->a22 = static_cast<float>(a22);
+}
+
+void OpticalFlowKernels::AccumulateMismatchAt(const uint8_t* image, int w, int h, const Patch& patch, int left,
+                                              int top, const BilinearWeights& wt, int* out_bx, int* out_by) {
+#if defined(SLAMTORCH_FLOW_NEON) || defined(SLAMTORCH_FLOW_SSE)
+    // Whole padded rows, plus the bilinear neighbour, inside the image.
+    if (left >= 0 && top >= 0 && left + kLanes + 1 <= w && top + kWindowSize + 1 <= h) {
+#if defined(SLAMTORCH_FLOW_NEON)
+        int32x4_t acc_x = vdupq_n_s32(0);
+        int32x4_t acc_y = vdupq_n_s32(0);
+        for (int r = 0; r < kWindowSize; ++r) {
+            const uint8_t* row0 = image + (top + r) * w + left;
+            const uint8_t* row1 = row0 + w;
+            // Signed like the SSE and scalar paths, so all three agree for
+            // any weights.
+            const int16x8_t a0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row0)));
+            const int16x8_t a1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row0 + 1)));
+            const int16x8_t b0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row1)));
+            const int16x8_t b1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row1 + 1)));
+            int32x4_t lo = vmull_n_s16(vget_low_s16(a0), wt.w00);
+            int32x4_t hi = vmull_n_s16(vget_high_s16(a0), wt.w00);
+            lo = vmlal_n_s16(lo, vget_low_s16(a1), wt.w01);
+            hi = vmlal_n_s16(hi, vget_high_s16(a1), wt.w01);
+            lo = vmlal_n_s16(lo, vget_low_s16(b0), wt.w10);
+            hi = vmlal_n_s16(hi, vget_high_s16(b0), wt.w10);
+            lo = vmlal_n_s16(lo, vget_low_s16(b1), wt.w11);
+            hi = vmlal_n_s16(hi, vget_high_s16(b1), wt.w11);
+            const int16x8_t j = vcombine_s16(vrshrn_n_s32(lo, kDescale), vrshrn_n_s32(hi, kDescale));
+            const int16x8_t diff = vsubq_s16(j, vld1q_s16(patch.value + r * kLanes));
+            const int16x8_t gx = vld1q_s16(patch.grad_x + r * kLanes);
+            const int16x8_t gy = vld1q_s16(patch.grad_y + r * kLanes);
+            acc_x = vmlal_s16(acc_x, vget_low_s16(gx), vget_low_s16(diff));
+            acc_x = vmlal_s16(acc_x, vget_high_s16(gx), vget_high_s16(diff));
+            acc_y = vmlal_s16(acc_y, vget_low_s16(gy), vget_low_s16(diff));
+            acc_y = vmlal_s16(acc_y, vget_high_s16(gy), vget_high_s16(diff));
+        }
+        int32x2_t sum_x = vadd_s32(vget_low_s32(acc_x), vget_high_s32(acc_x));
+        int32x2_t sum_y = vadd_s32(vget_low_s32(acc_y), vget_high_s32(acc_y));
+        *out_bx = vget_lane_s32(vpadd_s32(sum_x, sum_x), 0);
+        *out_by = vget_lane_s32(vpadd_s32(sum_y, sum_y), 0);
+#else
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i top_weights = PairLanes(wt.w00, wt.w01);
+        const __m128i bottom_weights = PairLanes(wt.w10, wt.w11);
+        const __m128i round = _mm_set1_epi32(1 << (kDescale - 1));
+        __m128i acc_x = zero;
+        __m128i acc_y = zero;
+        for (int r = 0; r < kWindowSize; ++r) {
+            const uint8_t* row0 = image + (top + r) * w + left;
+            const uint8_t* row1 = row0 + w;
+            const __m128i a0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row0)), zero);
+            const __m128i a1 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row0 + 1)), zero);
+            const __m128i b0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row1)), zero);
+            const __m128i b1 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row1 + 1)), zero);
+            __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a0, a1), top_weights),
+                                       _mm_madd_epi16(_mm_unpacklo_epi16(b0, b1), bottom_weights));
+            __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a0, a1), top_weights),
+                                       _mm_madd_epi16(_mm_unpackhi_epi16(b0, b1), bottom_weights));
+            lo = _mm_srai_epi32(_mm_add_epi32(lo, round), kDescale);
+            hi = _mm_srai_epi32(_mm_add_epi32(hi, round), kDescale);
+            const __m128i j = _mm_packs_epi32(lo, hi);
+            const __m128i diff =
+                _mm_sub_epi16(j, _mm_load_si128(reinterpret_cast<const __m128i*>(patch.value + r * kLanes)));
+            acc_x = _mm_add_epi32(acc_x, _mm_madd_epi16(
+                _mm_load_si128(reinterpret_cast<const __m128i*>(patch.grad_x + r * kLanes)), diff));
+            acc_y = _mm_add_epi32(acc_y, _mm_madd_epi16(
+                _mm_load_si128(reinterpret_cast<const __m128i*>(patch.grad_y + r * kLanes)), diff));
+        }
+        alignas(16) int32_t lanes_x[4];
+        alignas(16) int32_t lanes_y[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes_x), acc_x);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes_y), acc_y);
+        *out_bx = lanes_x[0] + lanes_x[1] + lanes_x[2] + lanes_x[3];
+        *out_by = lanes_y[0] + lanes_y[1] + lanes_y[2] + lanes_y[3];
+#endif
+        return;
+    }
+#endif
+
+    AccumulateMismatchScalar(image, w, h, patch, left, top, wt, out_bx, out_by);
+}
+
+void OpticalFlowKernels::AccumulateMismatchScalar(const uint8_t* image, int w, int h, const Patch& patch, int left,
+                                                  int top, const BilinearWeights& wt, int* out_bx, int* out_by) {
+    int bx = 0;
+    int by = 0;
+    for (int r = 0; r < kWindowSize; ++r) {
+        const int qy = top + r;
+        if (qy < 0 || qy + 1 >= h) continue;
+        for (int c = 0; c < kWindowSize; ++c) {
+            const int qx = left + c;
+            if (qx < 0 || qx + 1 >= w) continue;
+            const int lane = r * kLanes + c;
+            const int diff = SampleQ5(image + qy * w + qx, w, wt) - patch.value[lane];
+            bx += patch.grad_x[lane] * diff;
+            by += patch.grad_y[lane] * diff;
+        }
+    }
+    *out_bx = bx;
+    *out_by = by;
+}
+
+float OpticalFlowKernels::TrackLevel(const uint8_t* from, const int16_t* from_gradient, const uint8_t* to, int w,
+                                     int h, float x, float y, float guess_x, float guess_y, float* out_x,
+                                     float* out_y) {
+    Patch patch;
+    BuildPatch(from, from_gradient, w, h, x, y, &patch);
+    const float det = patch.a11 * patch.a22 - patch.a12 * patch.a12;
+    if (det < kMinDet * kSystemScale * kSystemScale) {
+        return std::numeric_limits<float>::infinity();
+    }
+    const float inv_det = 1.0f / det;
+
+    float dx = guess_x - x;
+    float dy = guess_y - y;
+    for (int iter = 0; iter < kIterations; ++iter) {
+        const float px = x + dx;
+        const float py = y + dy;
+        const int ix = static_cast<int>(std::floor(px));
+        const int iy = static_cast<int>(std::floor(py));
+        const BilinearWeights wt = MakeWeights(px - static_cast<float>(ix), py - static_cast<float>(iy));
+        int bx = 0;
+        int by = 0;
+        AccumulateMismatchAt(to, w, h, patch, ix - kWindowRadius, iy - kWindowRadius, wt, &bx, &by);
+        const float sum_x = static_cast<float>(bx);
+        const float sum_y = static_cast<float>(by);
+        const float delta_x = (-patch.a22 * sum_x + patch.a12 * sum_y) * inv_det;
+        const float delta_y = (patch.a12 * sum_x - patch.a11 * sum_y) * inv_det;
+
+        dx += delta_x;
+        dy += delta_y;
+
+        if (delta_x * delta_x + delta_y * delta_y < 1e-4f) {
+            break;
+        }
+    }
+
+    *out_x = x + dx;
+    *out_y = y + dy;
+    const float moved_x = *out_x - guess_x;
+    const float moved_y = *out_y - guess_y;
+    return std::sqrt(moved_x * moved_x + moved_y * moved_y);
+}
+
+float OpticalFlowKernels::WindowCorrelation(const uint8_t* a, float ax, float ay, const uint8_t* b, float bx,
+                                            float by, int w, int h) {
+    const int iax = static_cast<int>(std::floor(ax));
+    const int iay = static_cast<int>(std::floor(ay));
+    const int ibx = static_cast<int>(std::floor(bx));
+    const int iby = static_cast<int>(std::floor(by));
+    if (std::min(iax, ibx) < kWindowRadius || std::min(iay, iby) < kWindowRadius ||
+        std::max(iax, ibx) + kWindowRadius + 1 >= w || std::max(iay, iby) + kWindowRadius + 1 >= h) {
+        return 0.0f;
+    }
+    const BilinearWeights wa = MakeWeights(ax - static_cast<float>(iax), ay - static_cast<float>(iay));
+    const BilinearWeights wb = MakeWeights(bx - static_cast<float>(ibx), by - static_cast<float>(iby));
+    int64_t sum_a = 0;
+    int64_t sum_b = 0;
+    int64_t sum_aa = 0;
+    int64_t sum_bb = 0;
+    int64_t sum_ab = 0;
+    for (int r = -kWindowRadius; r <= kWindowRadius; ++r) {
+        const uint8_t* row_a = a + (iay + r) * w + iax;
+        const uint8_t* row_b = b + (iby + r) * w + ibx;
+        for (int c = -kWindowRadius; c <= kWindowRadius; ++c) {
+            const int va = SampleQ5(row_a + c, w, wa);
+            const int vb = SampleQ5(row_b + c, w, wb);
+            sum_a += va;
+            sum_b += vb;
+            sum_aa += va * va;
+            sum_bb += vb * vb;
+            sum_ab += va * vb;
+        }
+    }
+    // Scaled by the pixel count so the means stay integral.
+    constexpr int64_t n = kWindowSize * kWindowSize;
+    const double var_a = static_cast<double>(n * sum_aa - sum_a * sum_a);
+    const double var_b = static_cast<double>(n * sum_bb - sum_b * sum_b);
+    const double cov = static_cast<double>(n * sum_ab - sum_a * sum_b);
+    if (var_a <= 0.0 || var_b <= 0.0) return 0.0f;
+    return static_cast<float>(cov / std::sqrt(var_a * var_b));
+}
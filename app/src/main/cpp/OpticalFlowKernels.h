@@ -0,0 +1,79 @@
+#ifndef SLAMTORCH_OPTICAL_FLOW_KERNELS_H
+#define SLAMTORCH_OPTICAL_FLOW_KERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+// Pixel kernels behind OpticalFlowTracker: pyramid reduction, Scharr
+// gradients, Shi-Tomasi scores and fixed-point inverse-compositional LK. They
+// run on NEON and SSE2, with scalar loops for tails and other targets, and
+// are exposed here so the host checks and benchmarks can drive them directly.
+class OpticalFlowKernels {
+public:
+    static constexpr int kWindowRadius = 2;
+    static constexpr int kWindowSize = kWindowRadius * 2 + 1;
+    // LK window rows are padded to one 8-lane register; padding lanes carry
+    // zero gradients so they never contribute.
+    static constexpr int kLanes = 8;
+    // Bilinear weights are Q14.
+    static constexpr int kWeightBits = 14;
+
+    struct BilinearWeights {
+        int16_t w00, w01, w10, w11;
+    };
+
+    // Inverse-compositional template of one track at one level. The previous
+    // frame's window, its gradients and the normal matrix stay fixed while
+    // the warp iterates, so they are computed once per level.
+    struct Patch {
+        alignas(16) int16_t value[kWindowSize * kLanes];
+        alignas(16) int16_t grad_x[kWindowSize * kLanes];
+        alignas(16) int16_t grad_y[kWindowSize * kLanes];
+        float a11 = 0.0f;
+        float a12 = 0.0f;
+        float a22 = 0.0f;
+    };
+
+    // Weights for the fraction (fx, fy) in [0, 1); non-negative and summing
+    // to exactly one.
+    static BilinearWeights MakeWeights(float fx, float fy);
+
+    // Quarter-size level of src: 2x2 average, or the 5x5 binomial filter
+    // sampled at even pixels with row holding src_w + 4 values.
+    static void DownsampleBox(const uint8_t* src, int src_w, int src_h, uint8_t* dst, int w, int h);
+    static void DownsampleGaussian(const uint8_t* src, int src_w, int src_h, uint8_t* dst, int w, int h,
+                                   uint16_t* row);
+    // Interleaved (gx, gy) Scharr responses, 32x the intensity slope, of the
+    // interior pixels; the one-pixel border is left untouched.
+    static void ScharrGradients(const uint8_t* image, int w, int h, int16_t* gradient);
+
+    // Smaller eigenvalue of the structure tensor summed over the window
+    // around each pixel of the score_w x score_h block at (left, top), in
+    // Scharr units. Gradients must cover the block plus kWindowRadius.
+    // Returns score_w * score_h values inside scratch.
+    static const float* MinEigenvalueScores(const int16_t* gradient, int w, int left, int top, int score_w,
+                                            int score_h, std::vector<float>* scratch);
+
+    static void BuildPatch(const uint8_t* image, const int16_t* gradient, int w, int h, float x, float y,
+                           Patch* patch);
+    // Sums grad * (J - T) over the window whose top-left pixel is (left, top)
+    // in image J, interpolated with wt. Vectorized when the padded rows fit
+    // the image; the scalar path skips pixels whose footprint leaves it, and
+    // both give identical sums.
+    static void AccumulateMismatchAt(const uint8_t* image, int w, int h, const Patch& patch, int left, int top,
+                                     const BilinearWeights& wt, int* out_bx, int* out_by);
+    static void AccumulateMismatchScalar(const uint8_t* image, int w, int h, const Patch& patch, int left,
+                                         int top, const BilinearWeights& wt, int* out_bx, int* out_by);
+    // Moves the window at (x, y) in from, starting at (guess_x, guess_y), to
+    // where it best matches to. Returns how far the estimate moved from the
+    // guess, or infinity if the window is too flat to track.
+    static float TrackLevel(const uint8_t* from, const int16_t* from_gradient, const uint8_t* to, int w, int h,
+                            float x, float y, float guess_x, float guess_y, float* out_x, float* out_y);
+
+    // Normalized cross-correlation of the windows at (ax, ay) in a and
+    // (bx, by) in b; 0 if either leaves the image or is flat.
+    static float WindowCorrelation(const uint8_t* a, float ax, float ay, const uint8_t* b, float bx, float by,
+                                   int w, int h);
+};
+
+#endif // SLAMTORCH_OPTICAL_FLOW_KERNELS_H
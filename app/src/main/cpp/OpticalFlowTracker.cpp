@@ -1,18 +1,31 @@
 #include "OpticalFlowTracker.h"
-#include "AndroidOut.h"
+#include "Log.h"
+#include "OpticalFlowKernels.h"
+#include "ThreadPool.h"
 #include <algorithm>
 #include <cmath>
 #include <cstring>
 
 namespace {
-constexpr int kWindowRadius = 2;
-constexpr int kWindowSize = kWindowRadius * 2 + 1;
-constexpr int kIterations = 6;
-constexpr float kMinDet = 1e-4f;
+constexpr int kWindowSize = OpticalFlowKernels::kWindowSize;
 constexpr float kMaxError = 20.0f;
+// The forward-backward check re-tracks only this many of the finest levels.
+constexpr int kCheckLevels = 2;
+// Full-resolution pixels a track may miss its start by when tracked back.
+constexpr float kMaxRoundTripError = 1.0f;
+// Tracks whose window correlates worse than this between frames are dropped.
+constexpr float kMinQuality = 0.7f;
 constexpr int kGridSize = 24;
 constexpr int kMinBorder = 6;
-constexpr float kGradThresh = 18.0f;
+// Shi-Tomasi threshold on the smaller eigenvalue of the structure tensor over
+// the tracking window, in Scharr units (1024x the squared slope): a slope of
+// about one grey level per pixel in the weakest direction.
+constexpr float kMinEigenvalue = kWindowSize * kWindowSize * 1024.0f;
+// New features keep at least this far from existing tracks, in mask blocks.
+constexpr int kMaskBlock = 8;
+// Tracks per parallel work item; small enough to balance, large enough that
+// claiming a chunk costs nothing next to tracking it.
+constexpr int kTrackChunk = 16;
 }
 
 OpticalFlowTracker::OpticalFlowTracker(int max_features, int pyramid_levels)
@@ -24,19 +37,28 @@ OpticalFlowTracker::OpticalFlowTracker(int max_features, int pyramid_levels)
     level_heights_ = new int[pyramid_levels_];
     pyramid_prev_ = new uint8_t*[pyramid_levels_];
     pyramid_curr_ = new uint8_t*[pyramid_levels_];
+    gradient_prev_ = new int16_t*[pyramid_levels_];
+    gradient_curr_ = new int16_t*[pyramid_levels_];
     memset(pyramid_prev_, 0, sizeof(uint8_t*) * pyramid_levels_);
     memset(pyramid_curr_, 0, sizeof(uint8_t*) * pyramid_levels_);
+    memset(gradient_prev_, 0, sizeof(int16_t*) * pyramid_levels_);
+    memset(gradient_curr_, 0, sizeof(int16_t*) * pyramid_levels_);
 }
 
 OpticalFlowTracker::~OpticalFlowTracker() {
     for (int i = 0; i < pyramid_levels_; ++i) {
         delete[] pyramid_prev_[i];
         delete[] pyramid_curr_[i];
+        delete[] gradient_prev_[i];
+        delete[] gradient_curr_[i];
     }
     delete[] pyramid_prev_;
     delete[] pyramid_curr_;
+    delete[] gradient_prev_;
+    delete[] gradient_curr_;
     delete[] level_widths_;
     delete[] level_heights_;
+    delete[] filter_row_;
     delete[] tracks_;
 }
 
@@ -56,7 +78,7 @@ void OpticalFlowTracker::Initialize(int width, int height) {
     height_ = height;
     AllocatePyramids();
     Reset();
-    aout << "OpticalFlowTracker initialized: " << width_ << "x" << height_ << std::endl;
+    LogPrint(LogLevel::INFO, "OpticalFlowTracker initialized: %dx%d", width_, height_);
 }
 
 void OpticalFlowTracker::AllocatePyramids() {
@@ -71,38 +93,60 @@ void OpticalFlowTracker::AllocatePyramids() {
         pyramid_curr_[level] = new uint8_t[w * h];
         memset(pyramid_prev_[level], 0, static_cast<size_t>(w * h));
         memset(pyramid_curr_[level], 0, static_cast<size_t>(w * h));
+        delete[] gradient_prev_[level];
+        delete[] gradient_curr_[level];
+        gradient_prev_[level] = new int16_t[2 * w * h];
+        gradient_curr_[level] = new int16_t[2 * w * h];
+        memset(gradient_prev_[level], 0, sizeof(int16_t) * 2 * w * h);
+        memset(gradient_curr_[level], 0, sizeof(int16_t) * 2 * w * h);
         w = (w + 1) / 2;
         h = (h + 1) / 2;
     }
+    base_prev_ = pyramid_prev_[0];
+    base_curr_ = pyramid_curr_[0];
+    delete[] filter_row_;
+    filter_row_ = new uint16_t[width_ + 4];
 }
 
-void OpticalFlowTracker::BuildPyramid(const uint8_t* src, uint8_t** pyramid) {
-    if (!src || !pyramid[0]) return;
-    const int base_size = width_ * height_;
-    memcpy(pyramid[0], src, static_cast<size_t>(base_size));
+void OpticalFlowTracker::SetPyramidFilter(PyramidFilter filter) {
+    if (filter == filter_) return;
+    filter_ = filter;
+    // Levels built with different filters do not line up.
+    has_prev_ = false;
+}
+
+void OpticalFlowTracker::BuildPyramid(const uint8_t* src) {
+    if (!src || !pyramid_curr_[0]) return;
+    if (zero_copy_) {
+        base_curr_ = src;
+    } else {
+        memcpy(pyramid_curr_[0], src, static_cast<size_t>(width_ * height_));
+        base_curr_ = pyramid_curr_[0];
+    }
 
     for (int level = 1; level < pyramid_levels_; ++level) {
+        const uint8_t* prev = CurrLevel(level - 1);
         const int prev_w = level_widths_[level - 1];
         const int prev_h = level_heights_[level - 1];
+        if (filter_ == PyramidFilter::GAUSSIAN) {
+            OpticalFlowKernels::DownsampleGaussian(prev, prev_w, prev_h, pyramid_curr_[level],
+                                                   level_widths_[level], level_heights_[level], filter_row_);
+        } else {
+            OpticalFlowKernels::DownsampleBox(prev, prev_w, prev_h, pyramid_curr_[level], level_widths_[level],
+                                              level_heights_[level]);
+        }
+    }
+}
+
+void OpticalFlowTracker::BuildGradients() {
+    for (int level = 0; level < pyramid_levels_; ++level) {
+        const uint8_t* image = CurrLevel(level);
+        int16_t* gradient = gradient_curr_[level];
         const int w = level_widths_[level];
         const int h = level_heights_[level];
-        const uint8_t* prev = pyramid[level - 1];
-        uint8_t* curr = pyramid[level];
-
-        for (int y = 0; y < h; ++y) {
-            const int src_y = y * 2;
-            const int src_y1 = (src_y + 1 < prev_h) ? (src_y + 1) : src_y;
-            for (int x = 0; x < w; ++x) {
-                const int src_x = x * 2;
-                const int src_x1 = (src_x + 1 < prev_w) ? (src_x + 1) : src_x;
-                int sum = 0;
-                sum += prev[src_y * prev_w + src_x];
-                sum += prev[src_y * prev_w + src_x1];
-                sum += prev[src_y1 * prev_w + src_x];
-                sum += prev[src_y1 * prev_w + src_x1];
-                curr[y * w + x] = static_cast<uint8_t>(sum / 4);
-            }
-        }
+        if (!image || w < 3 || h < 3) continue;
+        // Border pixels stay zero from allocation.
+        OpticalFlowKernels::ScharrGradients(image, w, h, gradient);
     }
 }
 
@@ -110,6 +154,8 @@ void OpticalFlowTracker::SwapPyramids() {
     uint8_t** temp = pyramid_prev_;
     pyramid_prev_ = pyramid_curr_;
     pyramid_curr_ = temp;
+    std::swap(base_prev_, base_curr_);
+    std::swap(gradient_prev_, gradient_curr_);
     has_prev_ = true;
 }
 
@@ -120,71 +166,101 @@ bool OpticalFlowTracker::Update(const uint8_t* image, int width, int height) {
         Initialize(width, height);
     }
 
-    BuildPyramid(image, pyramid_curr_);
+    BuildPyramid(image);
+    BuildGradients();
 
     if (!has_prev_) {
-        DetectFeatures(pyramid_curr_[0]);
+        track_count_ = 0;
+        DetectFeatures();
         SwapPyramids();
         return true;
     }
 
+    // Tracks only touch their own state, so chunks can run in any order.
+    if (pool_) {
+        pool_->ParallelFor(track_count_, kTrackChunk, [this](int begin, int end) { TrackRange(begin, end); });
+    } else {
+        TrackRange(0, track_count_);
+    }
     int active_count = 0;
     for (int i = 0; i < track_count_; ++i) {
-        if (!tracks_[i].active) continue;
-        if (TrackFeature(i)) {
-            tracks_[i].age++;
-            tracks_[i].stable_count++;
+        if (tracks_[i].active) {
             active_count++;
-        } else {
-            tracks_[i].active = false;
-            tracks_[i].stable_count = 0;
         }
     }
 
     if (active_count < reseed_threshold_) {
-        DetectFeatures(pyramid_curr_[0]);
+        DetectFeatures();
     }
 
     SwapPyramids();
     return true;
 }
 
-void OpticalFlowTracker::DetectFeatures(const uint8_t* image) {
-    track_count_ = 0;
+void OpticalFlowTracker::SetWorkerCount(int worker_count, bool big_cores_only) {
+    pool_.reset();
+    if (worker_count > 0) {
+        pool_ = std::make_unique<ThreadPool>(worker_count, big_cores_only);
+    }
+}
+
+void OpticalFlowTracker::TrackRange(int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        if (!tracks_[i].active) continue;
+        if (TrackFeature(i)) {
+            tracks_[i].age++;
+            tracks_[i].stable_count++;
+        } else {
+            tracks_[i].active = false;
+            tracks_[i].stable_count = 0;
+        }
+    }
+}
+
+void OpticalFlowTracker::DetectFeatures() {
     const int w = width_;
     const int h = height_;
     const int grid_x = (w - kMinBorder) / kGridSize;
     const int grid_y = (h - kMinBorder) / kGridSize;
+    const int cells_x = grid_x + 1;
+
+    // Keep surviving tracks, in order, and mark the cells they occupy and
+    // the mask blocks around them.
+    occupancy_width_ = (w + kMaskBlock - 1) / kMaskBlock;
+    const int occupancy_height = (h + kMaskBlock - 1) / kMaskBlock;
+    occupancy_.assign(static_cast<size_t>(occupancy_width_ * occupancy_height), 0);
+    cell_occupied_.assign(static_cast<size_t>(cells_x * (grid_y + 1)), 0);
+    int kept = 0;
+    for (int i = 0; i < track_count_; ++i) {
+        if (!tracks_[i].active) continue;
+        const Track& t = tracks_[i];
+        tracks_[kept++] = t;
+        const int cx = std::min(std::max((static_cast<int>(t.x) - kMinBorder) / kGridSize, 0), grid_x);
+        const int cy = std::min(std::max((static_cast<int>(t.y) - kMinBorder) / kGridSize, 0), grid_y);
+        cell_occupied_[cy * cells_x + cx] = 1;
+        const int bx = static_cast<int>(t.x) / kMaskBlock;
+        const int by = static_cast<int>(t.y) / kMaskBlock;
+        for (int y = std::max(by - 1, 0); y <= std::min(by + 1, occupancy_height - 1); ++y) {
+            for (int x = std::max(bx - 1, 0); x <= std::min(bx + 1, occupancy_width_ - 1); ++x) {
+                occupancy_[y * occupancy_width_ + x] = 1;
+            }
+        }
+    }
+    track_count_ = kept;
 
     for (int gy = 0; gy <= grid_y; ++gy) {
         for (int gx = 0; gx <= grid_x; ++gx) {
-            float best_score = 0.0f;
-            int best_x = -1;
-            int best_y = -1;
+            if (track_count_ >= max_features_) return;
+            if (cell_occupied_[gy * cells_x + gx]) continue;
             const int start_x = kMinBorder + gx * kGridSize;
             const int start_y = kMinBorder + gy * kGridSize;
             const int end_x = std::min(start_x + kGridSize, w - kMinBorder);
             const int end_y = std::min(start_y + kGridSize, h - kMinBorder);
+            if (end_x <= start_x || end_y <= start_y) continue;
 
-            for (int y = start_y; y < end_y; y += 2) {
-                for (int x = start_x; x < end_x; x += 2) {
-                    const int idx = y * w + x;
-                    const uint8_t intensity = image[idx];
-                    if (intensity < 15 || intensity > 240) {
-                        continue;
-                    }
-                    const float ix = 0.5f * (image[idx + 1] - image[idx - 1]);
-                    const float iy = 0.5f * (image[idx + w] - image[idx - w]);
-                    const float score = ix * ix + iy * iy;
-                    if (score > best_score && score > kGradThresh) {
-                        best_score = score;
-                        best_x = x;
-                        best_y = y;
-                    }
-                }
-            }
-
-            if (best_x >= 0 && track_count_ < max_features_) {
+            int best_x = -1;
+            int best_y = -1;
+            if (FindCorner(start_x, start_y, end_x, end_y, &best_x, &best_y)) {
                 Track& t = tracks_[track_count_++];
                 t.x = static_cast<float>(best_x);
                 t.y = static_cast<float>(best_y);
@@ -194,25 +270,77 @@ void OpticalFlowTracker::DetectFeatures(const uint8_t* image) {
                 t.stable_count = 1;
                 t.active = true;
                 t.error = 0.0f;
+                t.quality = 1.0f;
+                t.id = next_track_id_++;
+                if (next_track_id_ == 0) {
+                    next_track_id_ = 1;
+                }
             }
         }
     }
 }
 
+bool OpticalFlowTracker::FindCorner(int x0, int y0, int x1, int y1, int* out_x, int* out_y) {
+    const uint8_t* image = CurrLevel(0);
+    const int16_t* gradient = gradient_curr_[0];
+    const int w = width_;
+    // Scores cover the cell plus a one-pixel ring for the local-maximum test.
+    const int score_w = x1 - x0 + 2;
+    const int score_h = y1 - y0 + 2;
+    const float* score = OpticalFlowKernels::MinEigenvalueScores(gradient, w, x0 - 1, y0 - 1, score_w, score_h,
+                                                                 &corner_scratch_);
+
+    float best_score = kMinEigenvalue;
+    int best_x = -1;
+    int best_y = -1;
+    for (int r = 1; r < score_h - 1; ++r) {
+        const float* row = score + r * score_w;
+        const int y = y0 - 1 + r;
+        for (int c = 1; c < score_w - 1; ++c) {
+            const float s = row[c];
+            if (s <= best_score) continue;
+            // Ties resolve towards the top-left, so two pixels never both win.
+            if (s < row[c - 1] || s <= row[c + 1] || s < row[c - score_w - 1] || s < row[c - score_w] ||
+                s < row[c - score_w + 1] || s <= row[c + score_w - 1] || s <= row[c + score_w] ||
+                s <= row[c + score_w + 1]) {
+                continue;
+            }
+            const int x = x0 - 1 + c;
+            if (occupancy_[(y / kMaskBlock) * occupancy_width_ + x / kMaskBlock]) continue;
+            const uint8_t intensity = image[y * w + x];
+            if (intensity < 15 || intensity > 240) continue;
+            best_score = s;
+            best_x = x;
+            best_y = y;
+        }
+    }
+    if (best_x < 0) return false;
+    *out_x = best_x;
+    *out_y = best_y;
+    return true;
+}
+
 bool OpticalFlowTracker::TrackFeature(int track_index) {
     Track& t = tracks_[track_index];
+    const int check_levels = std::min(kCheckLevels, pyramid_levels_);
     float x = t.x;
     float y = t.y;
     float error = 0.0f;
+    // Full-resolution guess entering the levels the round trip re-tracks.
+    float check_guess_x = x;
+    float check_guess_y = y;
 
     for (int level = pyramid_levels_ - 1; level >= 0; --level) {
+        if (level == check_levels - 1) {
+            check_guess_x = x;
+            check_guess_y = y;
+        }
         const float scale = 1.0f / static_cast<float>(1 << level);
-        float lx = x * scale;
-        float ly = y * scale;
-        float out_x = lx;
-        float out_y = ly;
-
-        error = TrackFeatureAtLevel(level, lx, ly, &out_x, &out_y);
+        // The template stays at the track's previous position; only the
+        // guess in the current frame carries down the pyramid.
+        float out_x = x * scale;
+        float out_y = y * scale;
+        error = TrackFeatureAtLevel(level, false, t.x * scale, t.y * scale, x * scale, y * scale, &out_x, &out_y);
         if (error > kMaxError) {
             return false;
         }
@@ -225,97 +353,51 @@ bool OpticalFlowTracker::TrackFeature(int track_index) {
         return false;
     }
 
-    t.prev_x = t.x;
-    t.prev_y = t.y;
-    t.x = x;
-    t.y = y;
-    t.error = error;
-    return true;
-}
-
-float OpticalFlowTracker::TrackFeatureAtLevel(int level, float x, float y, float* out_x, float* out_y) {
-    const uint8_t* prev = pyramid_prev_[level];
-    const uint8_t* curr = pyramid_curr_[level];
-    const int w = level_widths_[level];
-    const int h = level_heights_[level];
-    float dx = 0.0f;
-    float dy = 0.0f;
-
-    for (int iter = 0; iter < kIterations; ++iter) {
-        float sum_ix2 = 0.0f;
-        float sum_iy2 = 0.0f;
-        float sum_ixiy = 0.0f;
-        float sum_ixit = 0.0f;
-        float sum_iyit = 0.0f;
-
-        for (int wy = -kWindowRadius; wy <= kWindowRadius; ++wy) {
-            for (int wx = -kWindowRadius; wx <= kWindowRadius; ++wx) {
-                const float px = x + static_cast<float>(wx);
-                const float py = y + static_cast<float>(wy);
-                const float qx = px + dx;
-                const float qy = py + dy;
-
-                if (px < 1.0f || py < 1.0f || px >= w - 1.0f || py >= h - 1.0f) {
-                    continue;
-                }
-                if (qx < 1.0f || qy < 1.0f || qx >= w - 1.0f || qy >= h - 1.0f) {
-                    continue;
-                }
-
-                const float prev_val = SampleBilinear(prev, w, h, px, py);
-                const float curr_val = SampleBilinear(curr, w, h, qx, qy);
-
-                const float ix = 0.5f * (SampleBilinear(prev, w, h, px + 1.0f, py) -
-                                         SampleBilinear(prev, w, h, px - 1.0f, py));
-                const float iy = 0.5f * (SampleBilinear(prev, w, h, px, py + 1.0f) -
-                                         SampleBilinear(prev, w, h, px, py - 1.0f));
-
-                const float it = curr_val - prev_val;
-
-                sum_ix2 += ix * ix;
-                sum_iy2 += iy * iy;
-                sum_ixiy += ix * iy;
-                sum_ixit += ix * it;
-                sum_iyit += iy * it;
+    if (forward_backward_) {
+        // Track back from the new position, seeded with the coarse motion
+        // reversed so the fine levels redo their work instead of starting
+        // at the answer. A point that slid along an edge or jumped to a
+        // lookalike does not come back to where it started.
+        float back_x = x - (check_guess_x - t.x);
+        float back_y = y - (check_guess_y - t.y);
+        for (int level = check_levels - 1; level >= 0; --level) {
+            const float scale = 1.0f / static_cast<float>(1 << level);
+            float out_x = back_x * scale;
+            float out_y = back_y * scale;
+            if (TrackFeatureAtLevel(level, true, x * scale, y * scale, back_x * scale, back_y * scale, &out_x,
+                                    &out_y) > kMaxError) {
+                return false;
             }
+            back_x = out_x / scale;
+            back_y = out_y / scale;
         }
-
-        const float det = sum_ix2 * sum_iy2 - sum_ixiy * sum_ixiy;
-        if (det < kMinDet) {
-            return kMaxError + 1.0f;
+        const float miss_x = back_x - t.x;
+        const float miss_y = back_y - t.y;
+        if (miss_x * miss_x + miss_y * miss_y > kMaxRoundTripError * kMaxRoundTripError) {
+            return false;
         }
+    }
 
-        const float inv_det = 1.0f / det;
-        const float delta_x = (-sum_iy2 * sum_ixit + sum_ixiy * sum_iyit) * inv_det;
-        const float delta_y = (sum_ixiy * sum_ixit - sum_ix2 * sum_iyit) * inv_det;
-
-        dx += delta_x;
-        dy += delta_y;
-
-        if (delta_x * delta_x + delta_y * delta_y < 1e-4f) {
-            break;
-        }
+    const float quality =
+        OpticalFlowKernels::WindowCorrelation(PrevLevel(0), t.x, t.y, CurrLevel(0), x, y, width_, height_);
+    if (quality < kMinQuality) {
+        return false;
     }
 
-    *out_x = x + dx;
-    *out_y = y + dy;
-    return std::sqrt(dx * dx + dy * dy);
+    t.prev_x = t.x;
+    t.prev_y = t.y;
+    t.x = x;
+    t.y = y;
+    t.error = error;
+    t.quality = quality;
+    return true;
 }
 
-float OpticalFlowTracker::SampleBilinear(const uint8_t* image, int width, int height, float x, float y) const {
-    const int x0 = static_cast<int>(x);
-    const int y0 = static_cast<int>(y);
-    const int x1 = (x0 + 1 < width) ? x0 + 1 : x0;
-    const int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
-    const float fx = x - static_cast<float>(x0);
-    const float fy = y - static_cast<float>(y0);
-
-    const float v00 = image[y0 * width + x0];
-    const float v10 = image[y0 * width + x1];
-    const float v01 = image[y1 * width + x0];
-    const float v11 = image[y1 * width + x1];
-
-    const float v0 = v00 + fx * (v10 - v00);
-    const float v1 = v01 + fx * (v11 - v01);
-    return v0 + fy * (v1 - v0);
+float OpticalFlowTracker::TrackFeatureAtLevel(int level, bool backward, float x, float y, float guess_x,
+                                              float guess_y, float* out_x, float* out_y) {
+    const uint8_t* from = backward ? CurrLevel(level) : PrevLevel(level);
+    const int16_t* from_gradient = backward ? gradient_curr_[level] : gradient_prev_[level];
+    const uint8_t* to = backward ? PrevLevel(level) : CurrLevel(level);
+    return OpticalFlowKernels::TrackLevel(from, from_gradient, to, level_widths_[level], level_heights_[level], x, y,
+                                          guess_x, guess_y, out_x, out_y);
 }
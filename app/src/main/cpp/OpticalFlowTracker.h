@@ -2,18 +2,34 @@
 #define SLAMTORCH_OPTICAL_FLOW_TRACKER_H
 
 #include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
 
 class OpticalFlowTracker {
 public:
+    // How each pyramid level is reduced from the one below.
+    enum class PyramidFilter {
+        BOX,       // 2x2 average
+        GAUSSIAN,  // 5-tap binomial, smoother levels for better LK convergence
+    };
+
     struct Track {
         float x = 0.0f;
         float y = 0.0f;
         float prev_x = 0.0f;
         float prev_y = 0.0f;
         float error = 0.0f;
+        // Normalized cross-correlation of the window between the last two
+        // frames, 1 for a new track; tracks that fall too low are dropped.
+        float quality = 0.0f;
         int age = 0;
         int stable_count = 0;
         bool active = false;
+        // Unique for the tracker's lifetime, never 0; downstream maps key
+        // per-feature state on it.
+        uint32_t id = 0;
     };
 
     OpticalFlowTracker(int max_features, int pyramid_levels);
@@ -23,6 +39,20 @@ public:
     void Initialize(int width, int height);
     bool Update(const uint8_t* image, int width, int height);
 
+    // Takes effect on the next Update, which then restarts tracking.
+    void SetPyramidFilter(PyramidFilter filter);
+    // Level 0 aliases the image passed to Update instead of copying it. The
+    // image must then stay valid and unchanged until the following Update
+    // returns, since it is tracked against as the previous frame.
+    void SetZeroCopy(bool zero_copy) { zero_copy_ = zero_copy; }
+    // Tracks features on worker_count extra threads besides the caller's,
+    // optionally pinned to the big cores. Results are identical to the
+    // serial path for any count; 0 tracks serially.
+    void SetWorkerCount(int worker_count, bool big_cores_only = false);
+    // Also tracks every feature back over the finest levels and drops those
+    // that do not return to their start, at the cost of those levels' LK again.
+    void SetForwardBackwardCheck(bool enabled) { forward_backward_ = enabled; }
+
     int GetTrackCount() const { return track_count_; }
     const Track* GetTracks() const { return tracks_; }
     int GetWidth() const { return width_; }
@@ -31,12 +61,28 @@ public:
 
 private:
     void AllocatePyramids();
-    void BuildPyramid(const uint8_t* src, uint8_t** pyramid);
+    // Builds the current pyramid from src.
+    void BuildPyramid(const uint8_t* src);
+    const uint8_t* PrevLevel(int level) const { return level == 0 ? base_prev_ : pyramid_prev_[level]; }
+    const uint8_t* CurrLevel(int level) const { return level == 0 ? base_curr_ : pyramid_curr_[level]; }
+    // Scharr gradients of every current level, the template side of the next frame's LK.
+    void BuildGradients();
     void SwapPyramids();
-    void DetectFeatures(const uint8_t* image);
+    // Tracks the active features in [begin, end), retiring those lost.
+    void TrackRange(int begin, int end);
+    // Drops lost tracks and seeds the strongest Shi-Tomasi corner of every
+    // grid cell no track occupies; existing tracks are kept. Needs the
+    // current level-0 gradients.
+    void DetectFeatures();
+    // Best corner in the cell [x0, x1) x [y0, y1) that is a 3x3 local maximum
+    // and clear of the occupancy mask; false if none passes the threshold.
+    bool FindCorner(int x0, int y0, int x1, int y1, int* out_x, int* out_y);
     bool TrackFeature(int track_index);
-    float TrackFeatureAtLevel(int level, float x, float y, float* out_x, float* out_y);
-    float SampleBilinear(const uint8_t* image, int width, int height, float x, float y) const;
+    // Refines the guess for the previous frame's (x, y) at one level, or the
+    // previous frame's guess for the current frame's (x, y) if backward;
+    // returns how far the estimate moved from the guess.
+    float TrackFeatureAtLevel(int level, bool backward, float x, float y, float guess_x, float guess_y,
+                              float* out_x, float* out_y);
 
     int max_features_ = 0;
     int pyramid_levels_ = 0;
@@ -46,13 +92,35 @@ private:
 
     uint8_t** pyramid_prev_ = nullptr;
     uint8_t** pyramid_curr_ = nullptr;
+    // Level 0 as tracked: pyramid_*_[0], or the caller's image in zero-copy mode.
+    const uint8_t* base_prev_ = nullptr;
+    const uint8_t* base_curr_ = nullptr;
+    // Per level, interleaved (gx, gy) Scharr responses, 32x the intensity
+    // slope; zero on the border.
+    int16_t** gradient_prev_ = nullptr;
+    int16_t** gradient_curr_ = nullptr;
+    // Vertical Gaussian pass of one row, padded by two columns each side.
+    uint16_t* filter_row_ = nullptr;
+    PyramidFilter filter_ = PyramidFilter::BOX;
+    bool zero_copy_ = false;
+    bool forward_backward_ = false;
     int* level_widths_ = nullptr;
     int* level_heights_ = nullptr;
 
     Track* tracks_ = nullptr;
     int track_count_ = 0;
 
+    std::unique_ptr<ThreadPool> pool_;
+
+    // Detection scratch: per mask block, whether a track is near; per grid
+    // cell, whether a track is in it; and the structure-tensor planes of one cell.
+    std::vector<uint8_t> occupancy_;
+    std::vector<uint8_t> cell_occupied_;
+    int occupancy_width_ = 0;
+    std::vector<float> corner_scratch_;
+
     int reseed_threshold_ = 0;
+    uint32_t next_track_id_ = 1;
 };
 
 #endif // SLAMTORCH_OPTICAL_FLOW_TRACKER_H
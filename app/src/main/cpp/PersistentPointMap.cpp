@@ -1,132 +1,40 @@
 #include "PersistentPointMap.h"
-#include "AndroidOut.h"
-#include <android/log.h>
+#include "Log.h"
+#include "OpenAddressing.h"
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
 namespace {
-    const char* VERTEX_SHADER = R"(
-        #version 300 es
-        precision highp float;
-        
-        uniform mat4 u_MVP;
-        uniform float u_PointSize;
-        
-        layout(location = 0) in vec3 a_Position;
-        
-        out float v_Depth;
-        
-        void main() {
-            gl_Position = u_MVP * vec4(a_Position, 1.0);
-            gl_PointSize = u_PointSize;
-            v_Depth = gl_Position.z / gl_Position.w;
-        }
-    )";
-
-    const char* FRAGMENT_SHADER = R"(
-        #version 300 es
-        precision mediump float;
-        
-        in float v_Depth;
-        out vec4 FragColor;
-        
-        void main() {
-            vec2 coord = gl_PointCoord - vec2(0.5);
-            if (length(coord) > 0.5) discard;
-            
-            // Color based on depth: close = cyan, far = blue
-            float depth_norm = clamp(v_Depth * 0.5 + 0.5, 0.0, 1.0);
-            vec3 color = mix(vec3(0.0, 0.9, 0.9), vec3(0.0, 0.3, 0.8), depth_norm);
-            FragColor = vec4(color, 0.8);
-        }
-    )";
+    // Runs of refreshed slots closer than this share one range.
+    constexpr int DIRTY_MERGE_GAP = 64;
 }
 
-PersistentPointMap::PersistentPointMap(int max_points) {
-    (void)max_points;
+PersistentPointMap::PersistentPointMap(int max_points, float voxel_size)
+    : max_points_(std::max(1, std::min(max_points, MAX_POINTS))),
+      voxel_size_(voxel_size > 0.0f ? voxel_size : DEFAULT_VOXEL_SIZE),
+      inv_voxel_size_(1.0f / voxel_size_) {
     // Allocate fixed-size buffers
-    point_buffer_ = new float[MAX_POINTS * 3];
-    temp_transformed_ = new float[MAX_POINTS * 3];
-    memset(point_buffer_, 0, MAX_POINTS * 3 * sizeof(float));
-    
-    InitGL();
-    
-    __android_log_print(ANDROID_LOG_INFO, "SlamTorch", 
-        "PersistentPointMap initialized: max=%d points, decimation=1/%d",
-        MAX_POINTS, DECIMATION);
-}
-
-PersistentPointMap::~PersistentPointMap() {
-    CleanupGL();
-    delete[] point_buffer_;
-    delete[] temp_transformed_;
-}
-
-void PersistentPointMap::InitGL() {
-    // Compile vertex shader
-    GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert_shader, 1, &VERTEX_SHADER, nullptr);
-    glCompileShader(vert_shader);
-    
-    GLint compiled = 0;
-    glGetShaderiv(vert_shader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        char log[512];
-        glGetShaderInfoLog(vert_shader, 512, nullptr, log);
-        __android_log_print(ANDROID_LOG_ERROR, "SlamTorch", "Map vertex shader error: %s", log);
+    point_buffer_ = new float[max_points_ * 3];
+    memset(point_buffer_, 0, max_points_ * 3 * sizeof(float));
+    voxel_coord_.assign(static_cast<size_t>(max_points_) * 3, 0);
+    observation_count_.assign(static_cast<size_t>(max_points_), 0);
+    refresh_pending_.assign(static_cast<size_t>(max_points_), 0);
+
+    uint32_t table_size = 64;
+    while (table_size < static_cast<uint32_t>(max_points_) * 2) {
+        table_size <<= 1;
     }
+    table_.assign(table_size, -1);
+    table_mask_ = table_size - 1;
 
-    // Compile fragment shader
-    GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag_shader, 1, &FRAGMENT_SHADER, nullptr);
-    glCompileShader(frag_shader);
-    
-    glGetShaderiv(frag_shader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        char log[512];
-        glGetShaderInfoLog(frag_shader, 512, nullptr, log);
-        __android_log_print(ANDROID_LOG_ERROR, "SlamTorch", "Map fragment shader error: %s", log);
-    }
-
-    // Link program
-    program_ = glCreateProgram();
-    glAttachShader(program_, vert_shader);
-    glAttachShader(program_, frag_shader);
-    glLinkProgram(program_);
-    
-    GLint linked = 0;
-    glGetProgramiv(program_, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        char log[512];
-        glGetProgramInfoLog(program_, 512, nullptr, log);
-        __android_log_print(ANDROID_LOG_ERROR, "SlamTorch", "Map shader link error: %s", log);
-    }
-
-    glDeleteShader(vert_shader);
-    glDeleteShader(frag_shader);
-
-    // Get uniform locations
-    mvp_uniform_ = glGetUniformLocation(program_, "u_MVP");
-    point_size_uniform_ = glGetUniformLocation(program_, "u_PointSize");
-
-    // Create VAO and VBO
-    glGenVertexArrays(1, &vao_);
-    glGenBuffers(1, &vbo_);
-    
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, MAX_POINTS * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-    
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    LogPrint(LogLevel::INFO,
+        "PersistentPointMap initialized: max=%d points, voxel=%.3fm, decimation=1/%d",
+        max_points_, voxel_size_, DECIMATION);
 }
 
-void PersistentPointMap::CleanupGL() {
-    if (vbo_) glDeleteBuffers(1, &vbo_);
-    if (vao_) glDeleteVertexArrays(1, &vao_);
-    if (program_) glDeleteProgram(program_);
+PersistentPointMap::~PersistentPointMap() {
+    delete[] point_buffer_;
 }
 
 bool PersistentPointMap::ShouldAddPoint(float x, float y, float z) const {
@@ -145,11 +53,94 @@ void PersistentPointMap::TransformPoint(const float* mat, float x, float y, floa
     out[2] = mat[2]*x + mat[6]*y + mat[10]*z + mat[14];
 }
 
+int PersistentPointMap::FindTableSlot(int vx, int vy, int vz) const {
+    uint32_t slot = HashCell(vx, vy, vz) & table_mask_;
+    while (true) {
+        const int32_t index = table_[slot];
+        if (index < 0) return -1;
+        const int32_t* coord = &voxel_coord_[index * 3];
+        if (coord[0] == vx && coord[1] == vy && coord[2] == vz) {
+            return static_cast<int>(slot);
+        }
+        slot = (slot + 1) & table_mask_;
+    }
+}
+
+void PersistentPointMap::EraseTableSlot(uint32_t slot) {
+    BackwardShiftErase(&table_, table_mask_, slot, [this](int32_t index) {
+        const int32_t* coord = &voxel_coord_[index * 3];
+        return HashCell(coord[0], coord[1], coord[2]);
+    });
+}
+
+void PersistentPointMap::AddPoint(float x, float y, float z) {
+    const int vx = static_cast<int>(std::floor(x * inv_voxel_size_));
+    const int vy = static_cast<int>(std::floor(y * inv_voxel_size_));
+    const int vz = static_cast<int>(std::floor(z * inv_voxel_size_));
+
+    const int existing = FindTableSlot(vx, vy, vz);
+    if (existing >= 0) {
+        // Running mean; the point stays filed under the voxel it started in.
+        const int index = table_[existing];
+        const int count = ++observation_count_[index];
+        const float weight = 1.0f / static_cast<float>(count);
+        float* p = point_buffer_ + index * 3;
+        p[0] += (x - p[0]) * weight;
+        p[1] += (y - p[1]) * weight;
+        p[2] += (z - p[2]) * weight;
+        total_merged_++;
+        // The mean settles as count grows, so re-upload it only at powers of
+        // two; a static scene then stops costing uploads.
+        if ((count & (count - 1)) == 0 && !refresh_pending_[index]) {
+            refresh_pending_[index] = 1;
+            refresh_slots_.push_back(index);
+        }
+        return;
+    }
+
+    const int index = write_index_;
+    if (span_length_ == 0) {
+        span_begin_ = index;
+    }
+    span_length_ = std::min(span_length_ + 1, max_points_);
+    if (observation_count_[index] > 0) {
+        // Overwriting the oldest voxel: drop it from the table first.
+        const int32_t* coord = &voxel_coord_[index * 3];
+        const int old_slot = FindTableSlot(coord[0], coord[1], coord[2]);
+        if (old_slot >= 0) {
+            EraseTableSlot(static_cast<uint32_t>(old_slot));
+        }
+        has_wrapped_ = true;
+    }
+
+    float* p = point_buffer_ + index * 3;
+    p[0] = x;
+    p[1] = y;
+    p[2] = z;
+    int32_t* coord = &voxel_coord_[index * 3];
+    coord[0] = vx;
+    coord[1] = vy;
+    coord[2] = vz;
+    observation_count_[index] = 1;
+
+    uint32_t slot = HashCell(vx, vy, vz) & table_mask_;
+    while (table_[slot] >= 0) {
+        slot = (slot + 1) & table_mask_;
+    }
+    table_[slot] = index;
+
+    write_index_ = (write_index_ + 1) % max_points_;
+    if (current_count_ < max_points_) {
+        current_count_++;
+    }
+}
+
 void PersistentPointMap::AddPoints(const float* world_from_camera, const float* points, int num_points) {
     if (!points || num_points == 0) return;
 
     static int log_counter = 0;
     int points_added = 0;
+    const int merged_before = total_merged_;
     
     // Decimate and transform points
     for (int i = 0; i < num_points; i += DECIMATION) {
@@ -162,30 +153,12 @@ void PersistentPointMap::AddPoints(const float* world_from_camera, const float*
         if (confidence < 0.3f) continue;
         
         // Transform to world space
-        float wx, wy, wz;
-        TransformPoint(world_from_camera, cx, cy, cz, temp_transformed_ + points_added * 3);
-        wx = temp_transformed_[points_added * 3 + 0];
-        wy = temp_transformed_[points_added * 3 + 1];
-        wz = temp_transformed_[points_added * 3 + 2];
+        float world[3];
+        TransformPoint(world_from_camera, cx, cy, cz, world);
         
-        // Filter by distance and voxel
-        if (ShouldAddPoint(wx, wy, wz)) {
-            // Add to ring buffer
-            int idx = write_index_ * 3;
-            
-            if (current_count_ == MAX_POINTS) {
-                has_wrapped_ = true;
-            }
-            
-            // Add new point
-            point_buffer_[idx + 0] = wx;
-            point_buffer_[idx + 1] = wy;
-            point_buffer_[idx + 2] = wz;
-            
-            write_index_ = (write_index_ + 1) % MAX_POINTS;
-            if (current_count_ < MAX_POINTS) {
-                current_count_++;
-            }
+        // Filter by distance, then merge into the point's voxel
+        if (ShouldAddPoint(world[0], world[1], world[2])) {
+            AddPoint(world[0], world[1], world[2]);
             points_added++;
             total_added_++;
         }
@@ -193,68 +166,54 @@ void PersistentPointMap::AddPoints(const float* world_from_camera, const float*
     
     // Log periodically
     if (log_counter++ % 60 == 0 && points_added > 0) {
-        __android_log_print(ANDROID_LOG_DEBUG, "SlamTorch",
-            "Map: added %d/%d points, total=%d, wrapped=%d",
-            points_added, num_points, current_count_, has_wrapped_);
+        LogPrint(LogLevel::DEBUG,
+            "Map: added %d/%d points (%d merged), total=%d, wrapped=%d",
+            points_added, num_points, total_merged_ - merged_before, current_count_, has_wrapped_);
     }
     
-    // Update GL buffer if we added points
-    if (points_added > 0) {
-        UpdateGLBuffer();
-    }
-}
-
-void PersistentPointMap::UpdateGLBuffer() {
-    if (current_count_ == 0) return;
-    
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    
-    // Orphan buffer for better performance
-    glBufferData(GL_ARRAY_BUFFER, MAX_POINTS * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-    
-    // Upload current points
-    glBufferSubData(GL_ARRAY_BUFFER, 0, current_count_ * 3 * sizeof(float), point_buffer_);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void PersistentPointMap::Draw(const float* view_matrix, const float* projection_matrix) {
-    if (current_count_ == 0) return;
-
-    // Compute MVP (projection * view)
-    float mvp[16];
-    for (int row = 0; row < 4; row++) {
-        for (int col = 0; col < 4; col++) {
-            float sum = 0.0f;
-            for (int k = 0; k < 4; k++) {
-                sum += projection_matrix[k * 4 + row] * view_matrix[col * 4 + k];
+const float* PersistentPointMap::GetPoints(int* out_count, std::vector<SlotRange>* out_ranges) {
+    if (out_count) *out_count = current_count_;
+    if (out_ranges) {
+        out_ranges->clear();
+        if (span_length_ >= max_points_) {
+            out_ranges->push_back(SlotRange{0, current_count_});
+        } else if (span_length_ > 0) {
+            const int end = span_begin_ + span_length_;
+            if (end <= max_points_) {
+                out_ranges->push_back(SlotRange{span_begin_, end});
+            } else {
+                out_ranges->push_back(SlotRange{0, end - max_points_});
+                out_ranges->push_back(SlotRange{span_begin_, max_points_});
             }
-            mvp[col * 4 + row] = sum;
         }
+        for (int slot : refresh_slots_) {
+            out_ranges->push_back(SlotRange{slot, slot + 1});
+        }
+        MergeRanges(out_ranges, DIRTY_MERGE_GAP, MAX_DIRTY_RANGES);
     }
-
-    glUseProgram(program_);
-    glUniformMatrix4fv(mvp_uniform_, 1, GL_FALSE, mvp);
-    glUniform1f(point_size_uniform_, 10.0f);  // 10px for dense production map
-
-    glBindVertexArray(vao_);
-    
-    // Enable blending for semi-transparent points
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDepthFunc(GL_LEQUAL);
-    
-    glDrawArrays(GL_POINTS, 0, current_count_);
-    
-    glBindVertexArray(0);
+    span_length_ = 0;
+    for (int slot : refresh_slots_) {
+        refresh_pending_[slot] = 0;
+    }
+    refresh_slots_.clear();
+    return point_buffer_;
 }
 
 void PersistentPointMap::Clear() {
     current_count_ = 0;
     write_index_ = 0;
     total_added_ = 0;
+    total_merged_ = 0;
     has_wrapped_ = false;
-    memset(point_buffer_, 0, MAX_POINTS * 3 * sizeof(float));
-    
-    __android_log_print(ANDROID_LOG_INFO, "SlamTorch", "PersistentPointMap cleared");
+    memset(point_buffer_, 0, max_points_ * 3 * sizeof(float));
+    std::fill(observation_count_.begin(), observation_count_.end(), 0);
+    std::fill(table_.begin(), table_.end(), -1);
+    // Nothing to upload; the point count alone empties the GPU copy.
+    span_length_ = 0;
+    std::fill(refresh_pending_.begin(), refresh_pending_.end(), 0);
+    refresh_slots_.clear();
+    
+    LogPrint(LogLevel::INFO, "PersistentPointMap cleared");
 }
@@ -1,13 +1,23 @@
 #ifndef SLAMTORCH_PERSISTENT_POINT_MAP_H
 #define SLAMTORCH_PERSISTENT_POINT_MAP_H
 
-#include <GLES3/gl3.h>
+#include "SlotRange.h"
 #include <cstdint>
+#include <vector>
 
-// Zero-allocation persistent point map for ARCore SLAM visualization
+// Zero-allocation persistent point map for ARCore SLAM visualization.
+// PersistentPointMapRenderer draws it. Points are deduplicated on a voxel
+// grid: a new observation landing in an occupied voxel refines that voxel's
+// point instead of taking a new slot, so capacity counts distinct surface
+// points rather than observations.
 class PersistentPointMap {
 public:
-    PersistentPointMap(int max_points = 500000);
+    static constexpr int MAX_POINTS = 500000;  // Production-grade: 500k points
+    static constexpr float DEFAULT_VOXEL_SIZE = 0.02f;
+    // Changed slots are reported as at most this many ranges.
+    static constexpr int MAX_DIRTY_RANGES = 8;
+
+    PersistentPointMap(int max_points = MAX_POINTS, float voxel_size = DEFAULT_VOXEL_SIZE);
     ~PersistentPointMap();
 
     // Add points from ARCore point cloud (camera space -> world space)
@@ -16,8 +26,11 @@ public:
     // num_points: number of points in array
     void AddPoints(const float* world_from_camera, const float* points, int num_points);
 
-    // Render accumulated map with given view/projection matrices
-    void Draw(const float* view_matrix, const float* projection_matrix);
+    // Accumulated xyz points. out_ranges receives the sorted slot ranges that
+    // changed since the last call: the span written since then, which is one
+    // or two ranges around the ring's wrap, plus merged points whose mean is
+    // due for a refresh.
+    const float* GetPoints(int* out_count, std::vector<SlotRange>* out_ranges);
 
     // Clear all accumulated points
     void Clear();
@@ -25,36 +38,48 @@ public:
     // Diagnostics
     int GetPointCount() const { return current_count_; }
     int GetTotalAdded() const { return total_added_; }
+    int GetTotalMerged() const { return total_merged_; }
     bool IsBufferWrapped() const { return has_wrapped_; }
+    float GetVoxelSize() const { return voxel_size_; }
+    // Observations averaged into the point at index, 0 for an unused slot.
+    int GetObservationCount(int index) const { return observation_count_[index]; }
 
 private:
-    static constexpr int MAX_POINTS = 500000;  // Production-grade: 500k points
     static constexpr float MAX_DISTANCE = 10.0f;  // Extended range
     static constexpr int DECIMATION = 2;  // Keep 1/2 of input points
 
+    int max_points_ = 0;
+    float voxel_size_ = DEFAULT_VOXEL_SIZE;
+    float inv_voxel_size_ = 1.0f / DEFAULT_VOXEL_SIZE;
+
     // Fixed-size ring buffer
-    float* point_buffer_ = nullptr;  // 3 floats per point (xyz)
+    float* point_buffer_ = nullptr;  // 3 floats per point (xyz), running mean
     int current_count_ = 0;
     int write_index_ = 0;
     int total_added_ = 0;
+    int total_merged_ = 0;
     bool has_wrapped_ = false;
+    // Slots written since the last GetPoints(), in ring order from span_begin_.
+    int span_begin_ = 0;
+    int span_length_ = 0;
+    // Merged slots outside that span awaiting re-upload, flagged once each.
+    std::vector<uint8_t> refresh_pending_;
+    std::vector<int> refresh_slots_;
 
-    // OpenGL resources
-    GLuint vbo_ = 0;
-    GLuint vao_ = 0;
-    GLuint program_ = 0;
-    GLint mvp_uniform_ = -1;
-    GLint point_size_uniform_ = -1;
-
-    // Pre-allocated temp buffer for transform
-    float* temp_transformed_ = nullptr;
+    // Per slot: the voxel it owns (3 ints) and how many observations it holds.
+    std::vector<int32_t> voxel_coord_;
+    std::vector<int32_t> observation_count_;
+    // Voxel -> slot, open addressing with linear probing; -1 is empty. Sized
+    // at least twice max_points_ so probe runs stay short.
+    std::vector<int32_t> table_;
+    uint32_t table_mask_ = 0;
 
     // Helper functions
-    void InitGL();
-    void CleanupGL();
     bool ShouldAddPoint(float x, float y, float z) const;
     void TransformPoint(const float* mat, float x, float y, float z, float* out) const;
-    void UpdateGLBuffer();
+    int FindTableSlot(int vx, int vy, int vz) const;
+    void EraseTableSlot(uint32_t slot);
+    void AddPoint(float x, float y, float z);
 };
 
 #endif // SLAMTORCH_PERSISTENT_POINT_MAP_H
@@ -0,0 +1,170 @@
+#include "PersistentPointMapRenderer.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const char* VERTEX_SHADER = R"(
+        #version 300 es
+        precision highp float;
+        
+        uniform mat4 u_MVP;
+        uniform float u_PointSize;
+        
+        layout(location = 0) in vec3 a_Position;
+        
+        out float v_Depth;
+        
+        void main() {
+            gl_Position = u_MVP * vec4(a_Position, 1.0);
+            gl_PointSize = u_PointSize;
+            v_Depth = gl_Position.z / gl_Position.w;
+        }
+    )";
+
+    const char* FRAGMENT_SHADER = R"(
+        #version 300 es
+        precision mediump float;
+        
+        in float v_Depth;
+        out vec4 FragColor;
+        
+        void main() {
+            vec2 coord = gl_PointCoord - vec2(0.5);
+            if (length(coord) > 0.5) discard;
+            
+            // Color based on depth: close = cyan, far = blue
+            float depth_norm = clamp(v_Depth * 0.5 + 0.5, 0.0, 1.0);
+            vec3 color = mix(vec3(0.0, 0.9, 0.9), vec3(0.0, 0.3, 0.8), depth_norm);
+            FragColor = vec4(color, 0.8);
+        }
+    )";
+}
+
+PersistentPointMapRenderer::~PersistentPointMapRenderer() {
+    if (vbo_) glDeleteBuffers(1, &vbo_);
+    if (vao_) glDeleteVertexArrays(1, &vao_);
+    if (program_) glDeleteProgram(program_);
+}
+
+void PersistentPointMapRenderer::Initialize(int max_points) {
+    max_points_ = max_points;
+
+    // Compile vertex shader
+    GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vert_shader, 1, &VERTEX_SHADER, nullptr);
+    glCompileShader(vert_shader);
+    
+    GLint compiled = 0;
+    glGetShaderiv(vert_shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[512];
+        glGetShaderInfoLog(vert_shader, 512, nullptr, log);
+        __android_log_print(ANDROID_LOG_ERROR, "SlamTorch", "Map vertex shader error: %s", log);
+    }
+
+    // Compile fragment shader
+    GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(frag_shader, 1, &FRAGMENT_SHADER, nullptr);
+    glCompileShader(frag_shader);
+    
+    glGetShaderiv(frag_shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[512];
+        glGetShaderInfoLog(frag_shader, 512, nullptr, log);
+        __android_log_print(ANDROID_LOG_ERROR, "SlamTorch", "Map fragment shader error: %s", log);
+    }
+
+    // Link program
+    program_ = glCreateProgram();
+    glAttachShader(program_, vert_shader);
+    glAttachShader(program_, frag_shader);
+    glLinkProgram(program_);
+    
+    GLint linked = 0;
+    glGetProgramiv(program_, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[512];
+        glGetProgramInfoLog(program_, 512, nullptr, log);
+        __android_log_print(ANDROID_LOG_ERROR, "SlamTorch", "Map shader link error: %s", log);
+    }
+
+    glDeleteShader(vert_shader);
+    glDeleteShader(frag_shader);
+
+    // Get uniform locations
+    mvp_uniform_ = glGetUniformLocation(program_, "u_MVP");
+    point_size_uniform_ = glGetUniformLocation(program_, "u_PointSize");
+
+    // Create VAO and VBO
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, max_points_ * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PersistentPointMapRenderer::Update(const float* points, int count,
+                                        const SlotRange* ranges, int range_count) {
+    point_count_ = points ? std::min(count, max_points_) : 0;
+    if (point_count_ == 0 || !ranges || range_count <= 0) return;
+
+    // Patch the buffer in place; invalidating just the range lets the driver
+    // avoid waiting on draws that still read it. GLES 3.0 has no persistent
+    // mapping, so each range is mapped on its own.
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    for (int r = 0; r < range_count; ++r) {
+        const int begin = std::max(ranges[r].begin, 0);
+        const int end = std::min(ranges[r].end, point_count_);
+        if (end <= begin) continue;
+        const GLintptr offset = static_cast<GLintptr>(begin) * 3 * sizeof(float);
+        const GLsizeiptr size = static_cast<GLsizeiptr>(end - begin) * 3 * sizeof(float);
+        void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (dst) {
+            memcpy(dst, points + begin * 3, static_cast<size_t>(size));
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, points + begin * 3);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PersistentPointMapRenderer::Draw(const float* view_matrix, const float* projection_matrix) {
+    if (point_count_ == 0) return;
+
+    // Compute MVP (projection * view)
+    float mvp[16];
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += projection_matrix[k * 4 + row] * view_matrix[col * 4 + k];
+            }
+            mvp[col * 4 + row] = sum;
+        }
+    }
+
+    glUseProgram(program_);
+    glUniformMatrix4fv(mvp_uniform_, 1, GL_FALSE, mvp);
+    glUniform1f(point_size_uniform_, 10.0f);  // 10px for dense production map
+
+    glBindVertexArray(vao_);
+    
+    // Enable blending for semi-transparent points
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthFunc(GL_LEQUAL);
+    
+    glDrawArrays(GL_POINTS, 0, point_count_);
+    
+    glBindVertexArray(0);
+}
@@ -0,0 +1,31 @@
+#ifndef SLAMTORCH_PERSISTENT_POINT_MAP_RENDERER_H
+#define SLAMTORCH_PERSISTENT_POINT_MAP_RENDERER_H
+
+#include <GLES3/gl3.h>
+#include "PersistentPointMap.h"
+
+// Draws the points accumulated by PersistentPointMap, coloured by depth.
+class PersistentPointMapRenderer {
+public:
+    PersistentPointMapRenderer() = default;
+    ~PersistentPointMapRenderer();
+
+    void Initialize(int max_points);
+    // xyz points and the slot ranges that changed, as from
+    // PersistentPointMap::GetPoints; only those ranges are uploaded.
+    void Update(const float* points, int count, const SlotRange* ranges, int range_count);
+    void Draw(const float* view_matrix, const float* projection_matrix);
+
+    int GetPointCount() const { return point_count_; }
+
+private:
+    GLuint vbo_ = 0;
+    GLuint vao_ = 0;
+    GLuint program_ = 0;
+    GLint mvp_uniform_ = -1;
+    GLint point_size_uniform_ = -1;
+    int max_points_ = 0;
+    int point_count_ = 0;
+};
+
+#endif // SLAMTORCH_PERSISTENT_POINT_MAP_RENDERER_H
@@ -28,40 +28,6 @@ constexpr char kPlaneFragmentShader[] = R"(
         fragColor = u_Color;
     }
 )";
-
-bool IsPointInTriangle(const float* polygon, int ia, int ib, int ic, int ip, bool ccw) {
-    const float ax = polygon[ia * 2 + 0];
-    const float az = polygon[ia * 2 + 1];
-    const float bx = polygon[ib * 2 + 0];
-    const float bz = polygon[ib * 2 + 1];
-    const float cx = polygon[ic * 2 + 0];
-    const float cz = polygon[ic * 2 + 1];
-    const float px = polygon[ip * 2 + 0];
-    const float pz = polygon[ip * 2 + 1];
-
-    const float abx = bx - ax;
-    const float abz = bz - az;
-    const float bcx = cx - bx;
-    const float bcz = cz - bz;
-    const float cax = ax - cx;
-    const float caz = az - cz;
-
-    const float apx = px - ax;
-    const float apz = pz - az;
-    const float bpx = px - bx;
-    const float bpz = pz - bz;
-    const float cpx = px - cx;
-    const float cpz = pz - cz;
-
-    const float cross1 = abx * apz - abz * apx;
-    const float cross2 = bcx * bpz - bcz * bpx;
-    const float cross3 = cax * cpz - caz * cpx;
-
-    if (ccw) {
-        return cross1 >= 0.0f && cross2 >= 0.0f && cross3 >= 0.0f;
-    }
-    return cross1 <= 0.0f && cross2 <= 0.0f && cross3 <= 0.0f;
-}
 }
 
 PlaneRenderer::PlaneRenderer() {
@@ -257,10 +223,10 @@ void PlaneRenderer::Update(const ArSession* session, const ArTrackableList* plan
         int triangle_indices = 0;
         if (safe_vertex_count >= 3) {
             const int available = kMaxIndices - index_count_;
-            triangle_indices = TriangulatePolygon(polygon, safe_vertex_count,
-                                                  static_cast<uint16_t>(vertex_start),
-                                                  indices_.data() + index_count_,
-                                                  available);
+            triangle_indices = PolygonTriangulator::Triangulate(polygon, safe_vertex_count,
+                                                                static_cast<uint16_t>(vertex_start),
+                                                                indices_.data() + index_count_,
+                                                                available);
         }
 
         if (triangle_indices > 0) {
@@ -293,88 +259,6 @@ void PlaneRenderer::UploadBuffers() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-int PlaneRenderer::TriangulatePolygon(const float* polygon, int vertex_count, uint16_t base_index,
-                                      uint16_t* out_indices, int max_indices) const {
-    if (vertex_count < 3 || max_indices < (vertex_count - 2) * 3) return 0;
-
-    float area = 0.0f;
-    for (int i = 0; i < vertex_count; ++i) {
-        const int j = (i + 1) % vertex_count;
-        area += polygon[i * 2 + 0] * polygon[j * 2 + 1] -
-                polygon[j * 2 + 0] * polygon[i * 2 + 1];
-    }
-    const bool ccw = area >= 0.0f;
-
-    std::array<int, kMaxVerticesPerPlane> index_list{};
-    for (int i = 0; i < vertex_count; ++i) {
-        index_list[i] = i;
-    }
-
-    int remaining = vertex_count;
-    int out_count = 0;
-    int guard = 0;
-
-    while (remaining > 2 && guard++ < vertex_count * vertex_count) {
-        bool ear_found = false;
-        for (int i = 0; i < remaining; ++i) {
-            const int prev = index_list[(i + remaining - 1) % remaining];
-            const int curr = index_list[i];
-            const int next = index_list[(i + 1) % remaining];
-
-            const float ax = polygon[prev * 2 + 0];
-            const float az = polygon[prev * 2 + 1];
-            const float bx = polygon[curr * 2 + 0];
-            const float bz = polygon[curr * 2 + 1];
-            const float cx = polygon[next * 2 + 0];
-            const float cz = polygon[next * 2 + 1];
-
-            const float cross = (bx - ax) * (cz - az) - (bz - az) * (cx - ax);
-            if (ccw ? (cross <= 0.0f) : (cross >= 0.0f)) {
-                continue;
-            }
-
-            bool contains_vertex = false;
-            for (int j = 0; j < remaining; ++j) {
-                const int test = index_list[j];
-                if (test == prev || test == curr || test == next) continue;
-                if (IsPointInTriangle(polygon, prev, curr, next, test, ccw)) {
-                    contains_vertex = true;
-                    break;
-                }
-            }
-
-            if (contains_vertex) {
-                continue;
-            }
-
-            out_indices[out_count++] = base_index + static_cast<uint16_t>(prev);
-            out_indices[out_count++] = base_index + static_cast<uint16_t>(curr);
-            out_indices[out_count++] = base_index + static_cast<uint16_t>(next);
-
-            for (int k = i; k < remaining - 1; ++k) {
-                index_list[k] = index_list[k + 1];
-            }
-            --remaining;
-            ear_found = true;
-            break;
-        }
-
-        if (!ear_found) {
-            break;
-        }
-    }
-
-    if (remaining > 2 && out_count == 0) {
-        for (int i = 1; i < vertex_count - 1; ++i) {
-            out_indices[out_count++] = base_index;
-            out_indices[out_count++] = base_index + static_cast<uint16_t>(i);
-            out_indices[out_count++] = base_index + static_cast<uint16_t>(i + 1);
-        }
-    }
-
-    return out_count;
-}
-
 void PlaneRenderer::MultiplyMatrix(float* out, const float* a, const float* b) {
     for (int i = 0; i < 4; ++i) {
         for (int j = 0; j < 4; ++j) {
@@ -4,6 +4,7 @@
 #include <GLES3/gl3.h>
 #include <array>
 #include "arcore/arcore_c_api.h"
+#include "PolygonTriangulator.h"
 
 class PlaneRenderer {
 public:
@@ -28,13 +29,11 @@ private:
     };
 
     static constexpr int kMaxPlanes = 64;
-    static constexpr int kMaxVerticesPerPlane = 128;
+    static constexpr int kMaxVerticesPerPlane = PolygonTriangulator::kMaxVertices;
     static constexpr int kMaxVertices = kMaxPlanes * kMaxVerticesPerPlane;
     static constexpr int kMaxIndices = kMaxPlanes * (kMaxVerticesPerPlane - 2) * 3;
 
     void UploadBuffers();
-    int TriangulatePolygon(const float* polygon, int vertex_count, uint16_t base_index,
-                           uint16_t* out_indices, int max_indices) const;
     static void MultiplyMatrix(float* out, const float* a, const float* b);
 
     GLuint shader_program_ = 0;
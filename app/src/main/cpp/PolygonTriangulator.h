@@ -0,0 +1,18 @@
+#ifndef SLAMTORCH_POLYGON_TRIANGULATOR_H
+#define SLAMTORCH_POLYGON_TRIANGULATOR_H
+
+#include <cstdint>
+
+// Ear-clipping triangulation of simple 2D polygons such as ARCore plane
+// boundaries. Falls back to a fan when no ear can be clipped.
+class PolygonTriangulator {
+public:
+    static constexpr int kMaxVertices = 128;
+
+    // polygon holds vertex_count (x, z) pairs. Writes up to max_indices
+    // indices offset by base_index and returns how many were written.
+    static int Triangulate(const float* polygon, int vertex_count, uint16_t base_index,
+                           uint16_t* out_indices, int max_indices);
+};
+
+#endif // SLAMTORCH_POLYGON_TRIANGULATOR_H
@@ -49,14 +49,18 @@ Renderer::Renderer(android_app *pApp) :
     point_cloud_renderer_ = std::make_unique<PointCloudRenderer>();
     point_cloud_renderer_->Initialize();
     
-    landmark_map_ = std::make_unique<LandmarkMap>(20000);
-    optical_flow_ = std::make_unique<OpticalFlowTracker>(800, 3);
+    landmark_renderer_ = std::make_unique<LandmarkMapRenderer>();
+    landmark_renderer_->Initialize(FramePipeline::kMaxLandmarks);
     debug_hud_ = std::make_unique<DebugHud>();
-    depth_mapper_ = std::make_unique<DepthMapper>();
     plane_renderer_ = std::make_unique<PlaneRenderer>();
     plane_renderer_->Initialize(ar_slam_ ? ar_slam_->GetSession() : nullptr);
     voxel_map_renderer_ = std::make_unique<VoxelMapRenderer>();
     voxel_map_renderer_->Initialize();
+
+    profiler_.NameCurrentThread("render");
+    frame_pipeline_ = std::make_unique<FramePipeline>(depth_mesh_renderer_->GetGridWidth(),
+                                                      depth_mesh_renderer_->GetGridHeight(),
+                                                      true, &profiler_);
     
     // Initialize last-known matrices to identity
     for (int i = 0; i < 16; ++i) {
@@ -88,10 +92,10 @@ Renderer::~Renderer() {
     if (jni_attached_ && app_->activity->vm) {
         app_->activity->vm->DetachCurrentThread();
     }
-    delete[] camera_image_buffer_;
 }
 
 void Renderer::render() {
+    ScopedStage frame_stage(&profiler_, ProfileStage::FRAME);
     updateRenderArea();
     
     // FPS calculation (zero allocation)
@@ -117,7 +121,10 @@ void Renderer::render() {
 
     // Update ARCore SLAM (acquires frame, camera, point cloud)
     if (ar_slam_ && ar_slam_->GetSession()) {
-        ar_slam_->Update(env_);
+        {
+            ScopedStage stage(&profiler_, ProfileStage::AR_UPDATE);
+            ar_slam_->Update(env_);
+        }
         
         ArTrackingState tracking_state = ar_slam_->GetTrackingState();
         static int log_counter = 0;
@@ -136,8 +143,6 @@ void Renderer::render() {
         background_renderer_->Draw(ar_slam_->GetSession(), ar_slam_->GetFrame());
         
         // 2. Accumulate and render 3D content
-        int image_width = 0;
-        int image_height = 0;
         if (tracking_state == AR_TRACKING_STATE_TRACKING) {
             // Get camera matrices for 3D rendering
             ar_slam_->GetViewMatrix(view_matrix_);
@@ -155,8 +160,10 @@ void Renderer::render() {
             
             const ArPointCloud* point_cloud = ar_slam_->GetPointCloud();
             int32_t num_points = 0;
+            const float* point_data = nullptr;
             if (point_cloud) {
                 ArPointCloud_getNumberOfPoints(ar_slam_->GetSession(), point_cloud, &num_points);
+                ArPointCloud_getData(ar_slam_->GetSession(), point_cloud, &point_data);
                 current_point_count_ = num_points;
             }
             
@@ -164,7 +171,7 @@ void Renderer::render() {
             if (pc_log++ % 60 == 0) {
                 __android_log_print(ANDROID_LOG_INFO, "SlamTorch", 
                     "Frame points=%d, Landmark map=%d",
-                    num_points, landmark_map_ ? landmark_map_->GetPointCount() : 0);
+                    num_points, current_landmark_count_);
             }
             
             if (plane_renderer_ && planes_enabled_) {
@@ -173,267 +180,84 @@ void Renderer::render() {
                 plane_renderer_->Update(ar_slam_->GetSession(), ar_slam_->GetPlaneList());
             }
 
-            // 4. CPU image acquisition and optical flow tracking
-            ar_slam_->GetImageDimensions(&image_width, &image_height);
-            if (landmark_map_) {
-                landmark_map_->BeginFrame();
-            }
-
-            if (image_width > 0 && image_height > 0 && optical_flow_) {
-                const int required_capacity = image_width * image_height;
-                if (camera_image_capacity_ < required_capacity) {
-                    delete[] camera_image_buffer_;
-                    camera_image_buffer_ = new uint8_t[required_capacity];
-                    camera_image_capacity_ = required_capacity;
+            // 3. Copy this frame's inputs into a pipeline packet; tracking,
+            // depth preprocessing, mapping and the depth mesh run on the worker.
+            if (frame_pipeline_) {
+                FramePipeline::Packet& packet = frame_pipeline_->GetPacket();
+                ArFrame_getTimestamp(ar_slam_->GetSession(), ar_slam_->GetFrame(), &packet.timestamp_ns);
+                for (int i = 0; i < 16; ++i) {
+                    packet.world_from_camera[i] = world_from_camera[i];
                 }
-                camera_image_stride_ = image_width;
-
-                if (camera_image_buffer_) {
-                    const bool got_image = ar_slam_->AcquireCameraImageY(
-                        camera_image_buffer_,
-                        camera_image_stride_,
-                        camera_image_capacity_,
-                        &image_width,
-                        &image_height);
-
-                    if (got_image) {
-                        optical_flow_->Update(camera_image_buffer_, image_width, image_height);
-                        current_feature_count_ = optical_flow_->GetTrackCount();
-
-                        if (landmark_map_) {
-                            float fx = 0.0f, fy = 0.0f, cx = 0.0f, cy = 0.0f;
-                            ar_slam_->GetCameraIntrinsics(&fx, &fy, &cx, &cy);
-
-                            DepthFrame depth_frame;
-                            ArImage* depth_image = nullptr;
-                            ArImage* confidence_image = nullptr;
-                            const bool depth_ok = ar_slam_->AcquireDepthFrame(depth_source_, &depth_frame,
-                                                                             &depth_image, &confidence_image);
-
-                            const OpticalFlowTracker::Track* tracks = optical_flow_->GetTracks();
-                            const int track_count = optical_flow_->GetTrackCount();
-                            int stable_tracks = 0;
-                            float total_track_age = 0.0f;
-                            int depth_attempts = 0;
-                            int depth_hits = 0;
-
-                            for (int i = 0; i < track_count; ++i) {
-                                const auto& track = tracks[i];
-                                if (!track.active) continue;
-                                total_track_age += static_cast<float>(track.age);
-
-                                if (track.stable_count < 20) continue;
-                                if (track.error > 5.0f) continue;
-
-                                stable_tracks++;
-
-                                const float bearing_x = (track.x - cx) / fx;
-                                const float bearing_y = (track.y - cy) / fy;
-                                float bearing_z = -1.0f;
-                                const float bearing_len = std::sqrt(
-                                    bearing_x * bearing_x +
-                                    bearing_y * bearing_y +
-                                    bearing_z * bearing_z);
-                                float bearing[3] = {
-                                    bearing_x / bearing_len,
-                                    bearing_y / bearing_len,
-                                    bearing_z / bearing_len
-                                };
-
-                                if (!depth_ok || !depth_frame.depth_data) {
-                                    const float confidence = 0.4f + 0.4f * (track.stable_count / 30.0f);
-                                    landmark_map_->AddBearingObservation(bearing, confidence);
-                                    continue;
-                                }
-
-                                const float depth_scale_x = static_cast<float>(depth_frame.width) /
-                                                            static_cast<float>(image_width);
-                                const float depth_scale_y = static_cast<float>(depth_frame.height) /
-                                                            static_cast<float>(image_height);
-                                const int px = static_cast<int>(track.x * depth_scale_x);
-                                const int py = static_cast<int>(track.y * depth_scale_y);
-                                if (px < 0 || py < 0 || px >= depth_frame.width || py >= depth_frame.height) {
-                                    continue;
-                                }
-
-                                const uint8_t* row = reinterpret_cast<const uint8_t*>(depth_frame.depth_data) +
-                                                     depth_frame.row_stride * py;
-                                const uint16_t* depth_pixel = reinterpret_cast<const uint16_t*>(row + depth_frame.pixel_stride * px);
-                                const uint16_t depth_mm = *depth_pixel;
-                                depth_attempts++;
-                                if (depth_mm == 0) continue;
-                                depth_hits++;
-
-                                const float depth_m = static_cast<float>(depth_mm) * 0.001f;
-                                const float x_cam = (track.x - cx) * depth_m / fx;
-                                const float y_cam = (track.y - cy) * depth_m / fy;
-                                const float z_cam = -depth_m;
-
-                                float world_pos[3];
-                                world_pos[0] = world_from_camera[0] * x_cam +
-                                               world_from_camera[4] * y_cam +
-                                               world_from_camera[8] * z_cam +
-                                               world_from_camera[12];
-                                world_pos[1] = world_from_camera[1] * x_cam +
-                                               world_from_camera[5] * y_cam +
-                                               world_from_camera[9] * z_cam +
-                                               world_from_camera[13];
-                                world_pos[2] = world_from_camera[2] * x_cam +
-                                               world_from_camera[6] * y_cam +
-                                               world_from_camera[10] * z_cam +
-                                               world_from_camera[14];
-
-                                const float confidence = 0.5f + 0.5f * (track.stable_count / 30.0f);
-                                landmark_map_->AddMetricObservation(world_pos, bearing, confidence);
-                            }
-
-                            current_stable_track_count_ = stable_tracks;
-                            current_avg_track_age_ = track_count > 0
-                                ? (total_track_age / static_cast<float>(track_count))
-                                : 0.0f;
-                            current_depth_hit_rate_ = depth_attempts > 0
-                                ? (100.0f * static_cast<float>(depth_hits) / static_cast<float>(depth_attempts))
-                                : 0.0f;
-                            current_bearing_landmarks_ = landmark_map_->GetBearingCount();
-                            current_metric_landmarks_ = landmark_map_->GetMetricCount();
-
-                            if (depth_image) {
-                                ar_slam_->ReleaseDepthImage(depth_image);
-                            }
-                            if (confidence_image) {
-                                ar_slam_->ReleaseDepthImage(confidence_image);
-                            }
-                        }
-                    }
-                }
-            }
-        } else {
-            static int warn_log = 0;
-            if (warn_log++ % 180 == 0) {
-                __android_log_print(ANDROID_LOG_WARN, "SlamTorch", "Not tracking - move phone slowly over textured surfaces");
-            }
-        }
-        
-        // Update depth mapper and overlay for room mapping
-        if (tracking_state == AR_TRACKING_STATE_TRACKING) {
-            DepthFrame depth_frame;
-            ArImage* depth_image = nullptr;
-            ArImage* confidence_image = nullptr;
-            const ArCoreSlam::DepthSource depth_frame_source =
-                depth_mesh_mode_ == ArCoreSlam::DepthSource::OFF ? depth_source_ : depth_mesh_mode_;
-            const bool depth_ok = ar_slam_->AcquireDepthFrame(depth_frame_source, &depth_frame,
-                                                             &depth_image, &confidence_image);
-            if (depth_ok) {
-                current_depth_width_ = depth_frame.width;
-                current_depth_height_ = depth_frame.height;
-
-                float min_depth = 0.0f;
-                float max_depth = 0.0f;
-                const int stride = 4;
-                for (int y = 0; y < depth_frame.height; y += stride) {
-                    const uint8_t* row = reinterpret_cast<const uint8_t*>(depth_frame.depth_data) +
-                                         depth_frame.row_stride * y;
-                    for (int x = 0; x < depth_frame.width; x += stride) {
-                        const uint16_t* depth_pixel = reinterpret_cast<const uint16_t*>(row + depth_frame.pixel_stride * x);
-                        const uint16_t depth_mm = *depth_pixel;
-                        if (depth_mm == 0) continue;
-                        const float depth_m = static_cast<float>(depth_mm) * 0.001f;
-                        if (min_depth == 0.0f || depth_m < min_depth) min_depth = depth_m;
-                        if (depth_m > max_depth) max_depth = depth_m;
+                int image_width = 0;
+                int image_height = 0;
+                ar_slam_->GetImageDimensions(&image_width, &image_height);
+                ar_slam_->GetCameraIntrinsics(&packet.fx, &packet.fy, &packet.cx, &packet.cy);
+                packet.image_width = image_width;
+                packet.image_height = image_height;
+
+                packet.has_image = false;
+                if (image_width > 0 && image_height > 0) {
+                    ScopedStage stage(&profiler_, ProfileStage::IMAGE_COPY);
+                    const int required_capacity = image_width * image_height;
+                    if (static_cast<int>(packet.image.size()) < required_capacity) {
+                        packet.image.resize(static_cast<size_t>(required_capacity));
                     }
+                    packet.has_image = ar_slam_->AcquireCameraImageY(
+                        packet.image.data(),
+                        image_width,
+                        required_capacity,
+                        &packet.y_width,
+                        &packet.y_height);
                 }
-                current_depth_min_m_ = min_depth;
-                current_depth_max_m_ = max_depth;
 
-                if (depth_mesh_renderer_) {
-                    if (depth_mesh_mode_ == ArCoreSlam::DepthSource::OFF) {
-                        depth_mesh_renderer_->Clear();
-                        depth_mesh_valid_ratio_ = 0.0f;
+                {
+                    ScopedStage stage(&profiler_, ProfileStage::DEPTH_COPY);
+                    DepthFrame depth_frame;
+                    ArImage* depth_image = nullptr;
+                    ArImage* confidence_image = nullptr;
+                    const ArCoreSlam::DepthSource depth_frame_source =
+                        depth_mesh_mode_ == ArCoreSlam::DepthSource::OFF ? depth_source_ : depth_mesh_mode_;
+                    if (ar_slam_->AcquireDepthFrame(depth_frame_source, &depth_frame, &depth_image, &confidence_image)) {
+                        packet.SetDepth(depth_frame);
                     } else {
-                        float fx = 0.0f, fy = 0.0f, cx = 0.0f, cy = 0.0f;
-                        ar_slam_->GetCameraIntrinsics(&fx, &fy, &cx, &cy);
-                        const float min_depth_mesh = std::max(0.2f, current_depth_min_m_ > 0.0f ? current_depth_min_m_ : 0.2f);
-                        const float max_depth_mesh = std::min(6.0f, current_depth_max_m_ > 0.0f ? current_depth_max_m_ : 6.0f);
-                        depth_mesh_renderer_->Update(depth_frame,
-                                                     image_width,
-                                                     image_height,
-                                                     fx,
-                                                     fy,
-                                                     cx,
-                                                     cy,
-                                                     last_good_world_from_camera_,
-                                                     min_depth_mesh,
-                                                     max_depth_mesh);
-                        depth_mesh_valid_ratio_ = depth_mesh_renderer_->GetValidRatio();
-                        depth_mesh_width_ = depth_mesh_renderer_->GetGridWidth();
-                        depth_mesh_height_ = depth_mesh_renderer_->GetGridHeight();
+                        packet.ClearDepth();
                     }
-                }
-
-                if (depth_mapper_ && map_enabled_) {
-                    float fx = 0.0f, fy = 0.0f, cx = 0.0f, cy = 0.0f;
-                    ar_slam_->GetCameraIntrinsics(&fx, &fy, &cx, &cy);
-                    depth_mapper_->SetEnabled(map_enabled_);
-                    depth_mapper_->Update(depth_frame, fx, fy, cx, cy, image_width, image_height, last_good_world_from_camera_);
-                    const auto& stats = depth_mapper_->GetStats();
-                    current_voxels_used_ = stats.voxels_used;
-                    points_fused_accumulator_ += stats.points_fused_last_frame;
-
-                    bool dirty = false;
-                    int render_count = 0;
-                    const float* points = depth_mapper_->GetRenderPoints(&render_count, &dirty);
-                    if (dirty && voxel_map_renderer_) {
-                        voxel_map_renderer_->UpdatePoints(points, render_count);
-                    }
-                }
-
-                if (debug_overlay_enabled_ && depth_overlay_renderer_) {
-                    const int debug_size = depth_frame.width * depth_frame.height;
-                    if (static_cast<int>(depth_debug_buffer_.size()) != debug_size) {
-                        depth_debug_buffer_.assign(debug_size, 0);
+                    if (depth_image) {
+                        ar_slam_->ReleaseDepthImage(depth_image);
                     }
-                    const float min_depth_vis = (current_depth_min_m_ > 0.0f) ? current_depth_min_m_ : 0.2f;
-                    const float max_depth_vis = (current_depth_max_m_ > min_depth_vis) ? current_depth_max_m_ : 6.0f;
-                    const float inv_range = 1.0f / std::max(0.001f, max_depth_vis - min_depth_vis);
-                    for (int y = 0; y < depth_frame.height; ++y) {
-                        const uint8_t* row = reinterpret_cast<const uint8_t*>(depth_frame.depth_data) +
-                                             depth_frame.row_stride * y;
-                        uint8_t* dst_row = depth_debug_buffer_.data() + y * depth_frame.width;
-                        for (int x = 0; x < depth_frame.width; ++x) {
-                            const uint16_t* depth_pixel = reinterpret_cast<const uint16_t*>(row + depth_frame.pixel_stride * x);
-                            const uint16_t depth_mm = *depth_pixel;
-                            if (depth_mm == 0) {
-                                dst_row[x] = 0;
-                                continue;
-                            }
-                            const float depth_m = static_cast<float>(depth_mm) * 0.001f;
-                            const float normalized = 1.0f - std::min(1.0f, std::max(0.0f, (depth_m - min_depth_vis) * inv_range));
-                            dst_row[x] = static_cast<uint8_t>(normalized * 255.0f);
-                        }
+                    if (confidence_image) {
+                        ar_slam_->ReleaseDepthImage(confidence_image);
                     }
-                    depth_overlay_renderer_->UpdateTexture(depth_debug_buffer_.data(),
-                                                           depth_frame.width, depth_frame.height);
                 }
-            } else {
-                current_depth_width_ = 0;
-                current_depth_height_ = 0;
-                current_depth_min_m_ = 0.0f;
-                current_depth_max_m_ = 0.0f;
-                depth_mesh_valid_ratio_ = 0.0f;
-            }
-            if (depth_image) {
-                ar_slam_->ReleaseDepthImage(depth_image);
+                packet.SetPoints(point_data, num_points);
+
+                packet.settings.map_enabled = map_enabled_;
+                packet.settings.fusion_mode = map_fusion_mode_;
+                packet.settings.depth_mesh_enabled = depth_mesh_mode_ != ArCoreSlam::DepthSource::OFF;
+                packet.settings.build_visualization = debug_overlay_enabled_ && depth_overlay_renderer_;
+                frame_pipeline_->SubmitPacket();
             }
-            if (confidence_image) {
-                ar_slam_->ReleaseDepthImage(confidence_image);
+        } else {
+            static int warn_log = 0;
+            if (warn_log++ % 180 == 0) {
+                __android_log_print(ANDROID_LOG_WARN, "SlamTorch", "Not tracking - move phone slowly over textured surfaces");
             }
         }
 
+        // Apply the newest worker result, if any; only GL uploads happen here.
+        const FramePipeline::Result* result = frame_pipeline_ ? frame_pipeline_->AcquireResult() : nullptr;
+        if (result) {
+            ScopedStage stage(&profiler_, ProfileStage::RESULT_UPLOAD);
+            applyFrameResult(*result);
+        }
+
+        ScopedStage draw_stage(&profiler_, ProfileStage::DRAW);
+
         // 4. ALWAYS render persistent map (even when not tracking, using last good matrices)
-        if (landmark_map_ && landmark_map_->GetPointCount() > 0) {
+        if (landmark_renderer_ && current_landmark_count_ > 0) {
             const float* view_to_use = has_good_matrices_ ? last_good_view_ : view_matrix_;
             const float* proj_to_use = has_good_matrices_ ? last_good_proj_ : projection_matrix_;
-            landmark_map_->Draw(view_to_use, proj_to_use, last_good_world_from_camera_);
+            landmark_renderer_->Draw(view_to_use, proj_to_use);
         }
 
         if (depth_mesh_renderer_ && depth_mesh_mode_ != ArCoreSlam::DepthSource::OFF) {
@@ -456,10 +280,15 @@ void Renderer::render() {
             has_good_matrices_ ? last_good_proj_ : projection_matrix_
         );
 
-        if (voxel_map_renderer_ && map_enabled_ && voxel_map_renderer_->GetPointCount() > 0) {
+        if (voxel_map_renderer_ && map_enabled_) {
             const float* view_to_use = has_good_matrices_ ? last_good_view_ : view_matrix_;
             const float* proj_to_use = has_good_matrices_ ? last_good_proj_ : projection_matrix_;
-            voxel_map_renderer_->Draw(view_to_use, proj_to_use);
+            if (voxel_map_renderer_->GetMeshVertexCount() > 0) {
+                voxel_map_renderer_->DrawMesh(view_to_use, proj_to_use);
+            }
+            if (voxel_map_renderer_->GetPointCount() > 0) {
+                voxel_map_renderer_->Draw(view_to_use, proj_to_use);
+            }
         }
 
         if (debug_overlay_enabled_ && depth_overlay_renderer_) {
@@ -471,6 +300,83 @@ void Renderer::render() {
     eglSwapBuffers(display_, surface_);
 }
 
+void Renderer::applyFrameResult(const FramePipeline::Result& result) {
+    if (result.tracking_updated) {
+        current_feature_count_ = result.feature_count;
+        current_stable_track_count_ = result.stable_tracks;
+        current_avg_track_age_ = result.avg_track_age;
+        current_depth_hit_rate_ = result.depth_hit_rate;
+        current_bearing_landmarks_ = result.bearing_landmarks;
+        current_metric_landmarks_ = result.metric_landmarks;
+    }
+    current_landmark_count_ = result.landmark_count;
+    if (landmark_renderer_) {
+        landmark_renderer_->Update(result.landmark_ranges.data(),
+                                   static_cast<int>(result.landmark_ranges.size()),
+                                   result.landmark_vertices.data(), result.landmark_count,
+                                   result.landmark_frame, result.landmark_world_from_camera);
+    }
+
+    if (result.depth_valid) {
+        current_depth_width_ = result.depth_width;
+        current_depth_height_ = result.depth_height;
+        current_depth_min_m_ = result.depth_min_m;
+        current_depth_max_m_ = result.depth_max_m;
+    } else {
+        current_depth_width_ = 0;
+        current_depth_height_ = 0;
+        current_depth_min_m_ = 0.0f;
+        current_depth_max_m_ = 0.0f;
+        depth_mesh_valid_ratio_ = 0.0f;
+    }
+
+    if (depth_mesh_renderer_) {
+        if (depth_mesh_mode_ == ArCoreSlam::DepthSource::OFF) {
+            depth_mesh_renderer_->Clear();
+            depth_mesh_valid_ratio_ = 0.0f;
+        } else if (result.depth_mesh_updated) {
+            if (result.depth_mesh_valid) {
+                depth_mesh_renderer_->Upload(result.depth_mesh_vertices.data(),
+                                             static_cast<int>(result.depth_mesh_vertices.size()));
+            } else {
+                depth_mesh_renderer_->Clear();
+            }
+            depth_mesh_valid_ratio_ = result.depth_mesh_valid_ratio;
+            depth_mesh_width_ = depth_mesh_renderer_->GetGridWidth();
+            depth_mesh_height_ = depth_mesh_renderer_->GetGridHeight();
+        }
+    }
+
+    if (result.map_updated) {
+        current_voxels_used_ = result.voxels_used;
+    }
+    points_fused_accumulator_ += static_cast<int>(result.total_points_fused - last_total_points_fused_);
+    last_total_points_fused_ = result.total_points_fused;
+    if (voxel_map_renderer_) {
+        if (result.map_reset) {
+            voxel_map_renderer_->Clear();
+        }
+        if (result.map_points_dirty) {
+            voxel_map_renderer_->UpdatePoints(result.map_point_ranges.data(),
+                                              static_cast<int>(result.map_point_ranges.size()),
+                                              result.map_points.data(), result.map_point_count,
+                                              result.map_point_capacity);
+        }
+        if (result.map_mesh_dirty) {
+            voxel_map_renderer_->UpdateMesh(result.map_mesh_ranges.data(),
+                                            static_cast<int>(result.map_mesh_ranges.size()),
+                                            result.map_mesh.data(), result.map_mesh_vertex_count,
+                                            result.map_mesh_capacity);
+        }
+    }
+
+    if (debug_overlay_enabled_ && depth_overlay_renderer_ && result.has_visualization) {
+        depth_overlay_renderer_->UpdateTexture(result.visualization.data(),
+                                               result.depth_width,
+                                               result.depth_height);
+    }
+}
+
 void Renderer::OnPause() {
     if (ar_slam_) ar_slam_->OnPause();
 }
@@ -488,16 +394,12 @@ void Renderer::UpdateRotation(int display_rotation) {
 }
 
 void Renderer::ClearPersistentMap() {
-    if (landmark_map_) {
-        landmark_map_->Clear();
-    }
-    if (depth_mapper_) {
-        depth_mapper_->Reset();
-    }
-    if (optical_flow_) {
-        optical_flow_->Reset();
+    // The worker resets landmarks, tracks and maps before its next packet.
+    if (frame_pipeline_) {
+        frame_pipeline_->RequestClear();
     }
     has_good_matrices_ = false;
+    current_landmark_count_ = 0;
     current_bearing_landmarks_ = 0;
     current_metric_landmarks_ = 0;
     current_feature_count_ = 0;
@@ -536,8 +438,23 @@ void Renderer::SetDepthMode(ArCoreSlam::DepthSource mode) {
 
 void Renderer::SetMapEnabled(bool enabled) {
     map_enabled_ = enabled;
-    if (!map_enabled_ && depth_mapper_) {
-        depth_mapper_->SetEnabled(false);
+}
+
+void Renderer::SetMapFusionMode(DepthMapper::FusionMode mode) {
+    // Handed to the worker with the next packet.
+    map_fusion_mode_ = mode;
+}
+
+bool Renderer::ExportTrace(const std::string& path) const {
+    return profiler_.ExportChromeTrace(path);
+}
+
+void Renderer::SetRecording(const std::string& path) {
+    if (!frame_pipeline_) return;
+    if (path.empty()) {
+        frame_pipeline_->StopRecording();
+    } else {
+        frame_pipeline_->StartRecording(path, SessionRecording::HasCompression());
     }
 }
 
@@ -574,7 +491,7 @@ DebugStats Renderer::GetDebugStats() const {
     DebugStats stats;
     if (debug_hud_) {
         debug_hud_->Update(ar_slam_.get(), current_point_count_,
-                           landmark_map_ ? landmark_map_->GetPointCount() : 0,
+                           current_landmark_count_,
                            current_bearing_landmarks_,
                            current_metric_landmarks_,
                            current_feature_count_,
@@ -599,7 +516,8 @@ DebugStats Renderer::GetDebugStats() const {
                            depth_mesh_wireframe_,
                            depth_mesh_width_,
                            depth_mesh_height_,
-                           depth_mesh_valid_ratio_);
+                           depth_mesh_valid_ratio_,
+                           &profiler_);
         const DebugHudData& data = debug_hud_->GetData();
         stats.tracking_state = data.tracking_state;
         stats.torch_mode = data.torch_mode;
@@ -631,6 +549,7 @@ DebugStats Renderer::GetDebugStats() const {
         stats.depth_mesh_width = data.depth_mesh_width;
         stats.depth_mesh_height = data.depth_mesh_height;
         stats.depth_mesh_valid_ratio = data.depth_mesh_valid_ratio;
+        stats.stage_timings = data.stage_timings;
     } else {
         stats.tracking_state = "NONE";
         stats.torch_mode = "NONE";
@@ -662,6 +581,7 @@ DebugStats Renderer::GetDebugStats() const {
         stats.depth_mesh_width = 0;
         stats.depth_mesh_height = 0;
         stats.depth_mesh_valid_ratio = 0.0f;
+        stats.stage_timings = "";
     }
     return stats;
 }
@@ -710,9 +630,8 @@ void Renderer::handleInput() {
         auto &keyEvent = inputBuffer->keyEvents[i];
         if (keyEvent.action == AKEY_EVENT_ACTION_DOWN) {
             // Volume Down (Keycode 25) - Clear persistent map
-            if (keyEvent.keyCode == 25 && landmark_map_) {
-                landmark_map_->Clear();
-                has_good_matrices_ = false;
+            if (keyEvent.keyCode == 25) {
+                ClearPersistentMap();
                 __android_log_print(ANDROID_LOG_INFO, "SlamTorch", "User cleared persistent map");
             }
             // Cycle through Torch Modes on Volume Up (Keycode 24)
@@ -5,6 +5,7 @@
 #include <memory>
 #include <cstdint>
 #include <jni.h>
+#include <string>
 #include <vector>
 
 #include "ArCoreSlam.h"
@@ -13,8 +14,9 @@
 #include "DepthMapper.h"
 #include "DepthOverlayRenderer.h"
 #include "DepthMeshRenderer.h"
-#include "LandmarkMap.h"
-#include "OpticalFlowTracker.h"
+#include "FramePipeline.h"
+#include "FrameProfiler.h"
+#include "LandmarkMapRenderer.h"
 #include "PlaneRenderer.h"
 #include "PointCloudRenderer.h"
 #include "VoxelMapRenderer.h"
@@ -53,6 +55,7 @@ struct DebugStats {
     int depth_mesh_width;
     int depth_mesh_height;
     float depth_mesh_valid_ratio;
+    const char* stage_timings;
 };
 
 class Renderer {
@@ -74,17 +77,23 @@ public:
     void SetTorchMode(ArCoreSlam::TorchMode mode);
     void SetDepthMode(ArCoreSlam::DepthSource mode);
     void SetMapEnabled(bool enabled);
+    void SetMapFusionMode(DepthMapper::FusionMode mode);
     void SetDebugOverlayEnabled(bool enabled);
     void SetPlanesEnabled(bool enabled);
     void SetDepthMeshMode(ArCoreSlam::DepthSource mode);
     void SetDepthMeshWireframe(bool enabled);
+    // Records the frames the pipeline processes to path; an empty path stops.
+    void SetRecording(const std::string& path);
     void ClearDepthMesh();
     DebugStats GetDebugStats() const;
+    // Writes the buffered stage timings as Chrome trace JSON.
+    bool ExportTrace(const std::string& path) const;
 
 private:
     void initRenderer();
     void updateRenderArea();
     void createModels();
+    void applyFrameResult(const FramePipeline::Result& result);
 
     android_app *app_;
     EGLDisplay display_;
@@ -101,12 +110,14 @@ private:
     std::unique_ptr<DepthOverlayRenderer> depth_overlay_renderer_;
     std::unique_ptr<DepthMeshRenderer> depth_mesh_renderer_;
     std::unique_ptr<PointCloudRenderer> point_cloud_renderer_;
-    std::unique_ptr<LandmarkMap> landmark_map_;
-    std::unique_ptr<OpticalFlowTracker> optical_flow_;
+    std::unique_ptr<LandmarkMapRenderer> landmark_renderer_;
     std::unique_ptr<DebugHud> debug_hud_;
-    std::unique_ptr<DepthMapper> depth_mapper_;
     std::unique_ptr<PlaneRenderer> plane_renderer_;
     std::unique_ptr<VoxelMapRenderer> voxel_map_renderer_;
+    // Stage timings from this thread and the worker; outlives the pipeline.
+    FrameProfiler profiler_;
+    // Tracking and fusion worker; owns the landmark, voxel and mesh state.
+    std::unique_ptr<FramePipeline> frame_pipeline_;
     
     // JNI cached (attach once, not per-frame)
     JNIEnv* env_ = nullptr;
@@ -130,6 +141,7 @@ private:
     
     // Stats tracking
     int current_point_count_ = 0;
+    int current_landmark_count_ = 0;
     int current_feature_count_ = 0;
     int current_stable_track_count_ = 0;
     float current_avg_track_age_ = 0.0f;
@@ -143,8 +155,10 @@ private:
     int current_voxels_used_ = 0;
     int current_points_fused_per_second_ = 0;
     int points_fused_accumulator_ = 0;
+    int64_t last_total_points_fused_ = 0;
     double points_fused_last_time_ = 0.0;
     bool map_enabled_ = true;
+    DepthMapper::FusionMode map_fusion_mode_ = DepthMapper::FusionMode::OCCUPANCY;
     bool debug_overlay_enabled_ = false;
     ArCoreSlam::DepthSource depth_source_ = ArCoreSlam::DepthSource::DEPTH;
     bool planes_enabled_ = true;
@@ -153,14 +167,6 @@ private:
     int depth_mesh_width_ = 0;
     int depth_mesh_height_ = 0;
     float depth_mesh_valid_ratio_ = 0.0f;
-
-    // CPU image buffer (Y plane)
-    uint8_t* camera_image_buffer_ = nullptr;
-    int camera_image_capacity_ = 0;
-    int camera_image_stride_ = 0;
-
-    // Depth debug buffer (grayscale)
-    std::vector<uint8_t> depth_debug_buffer_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
@@ -0,0 +1,367 @@
+#include "SessionRecording.h"
+#include "Log.h"
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef SLAMTORCH_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+constexpr char kMagic[8] = {'S', 'T', 'S', 'E', 'S', 'S', '\0', '\0'};
+constexpr uint32_t kFrameTag = 0x4D415246u; // "FRAM"
+constexpr uint32_t kChunkCompressed = 1u << 0;
+
+constexpr uint32_t kSectionImage = 1u << 0;
+constexpr uint32_t kSectionDepth = 1u << 1;
+constexpr uint32_t kSectionConfidence = 1u << 2;
+constexpr uint32_t kSectionPoints = 1u << 3;
+
+// Sanity limits for reading; anything larger is treated as a corrupt frame.
+constexpr int32_t kMaxDimension = 8192;
+constexpr int32_t kMaxPointCount = 1 << 20;
+constexpr uint32_t kMaxRawSize = 1u << 28;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct ChunkHeader {
+    uint32_t tag;
+    uint32_t flags;
+    uint32_t raw_size;
+    uint32_t stored_size;
+};
+
+struct FrameHeader {
+    int64_t timestamp_ns;
+    float world_from_camera[16];
+    float fx;
+    float fy;
+    float cx;
+    float cy;
+    int32_t image_width;
+    int32_t image_height;
+    int32_t y_width;
+    int32_t y_height;
+    int32_t depth_width;
+    int32_t depth_height;
+    int32_t point_count;
+    uint32_t sections;
+    uint32_t settings;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FileHeader) == 16, "FileHeader layout");
+static_assert(sizeof(ChunkHeader) == 16, "ChunkHeader layout");
+static_assert(sizeof(FrameHeader) == 128, "FrameHeader layout");
+
+// Sections start 8-byte aligned so mapped frames can be read in place.
+size_t Align8(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+void AppendSection(std::vector<uint8_t>* payload, const void* data, size_t size) {
+    const size_t offset = payload->size();
+    payload->resize(offset + Align8(size), 0);
+    memcpy(payload->data() + offset, data, size);
+}
+
+// a * b, false on overflow.
+bool MultiplySize(size_t a, size_t b, size_t* out) {
+    if (b != 0 && a > SIZE_MAX / b) return false;
+    *out = a * b;
+    return true;
+}
+
+bool IsValidDimension(int32_t value) {
+    return value > 0 && value <= kMaxDimension;
+}
+
+// Walks one section; false when it does not fit the payload.
+bool TakeSection(const uint8_t* payload, size_t payload_size, size_t size, size_t* offset, const uint8_t** out) {
+    if (*offset > payload_size || size > payload_size - *offset) return false;
+    *out = payload + *offset;
+    *offset += Align8(size);
+    return true;
+}
+}
+
+bool SessionRecording::HasCompression() {
+#ifdef SLAMTORCH_HAVE_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+SessionWriter::~SessionWriter() {
+    Close();
+}
+
+bool SessionWriter::Open(const std::string& path, bool compress) {
+    Close();
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        LogPrint(LogLevel::ERROR, "SessionWriter: cannot open %s", path.c_str());
+        return false;
+    }
+    FileHeader header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = SessionRecording::kVersion;
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+        Close();
+        return false;
+    }
+    compress_ = compress && SessionRecording::HasCompression();
+    frame_count_ = 0;
+    LogPrint(LogLevel::INFO, "SessionWriter: recording to %s%s", path.c_str(), compress_ ? " (lz4)" : "");
+    return true;
+}
+
+bool SessionWriter::WriteFrame(const SessionFrame& frame) {
+    if (!file_) return false;
+
+    FrameHeader header = {};
+    header.timestamp_ns = frame.timestamp_ns;
+    memcpy(header.world_from_camera, frame.world_from_camera, sizeof(header.world_from_camera));
+    header.fx = frame.fx;
+    header.fy = frame.fy;
+    header.cx = frame.cx;
+    header.cy = frame.cy;
+    header.image_width = frame.image_width;
+    header.image_height = frame.image_height;
+    header.settings = frame.flags;
+    if (frame.image && frame.y_width > 0 && frame.y_height > 0) {
+        header.sections |= kSectionImage;
+        header.y_width = frame.y_width;
+        header.y_height = frame.y_height;
+    }
+    if (frame.depth && frame.depth_width > 0 && frame.depth_height > 0) {
+        header.sections |= kSectionDepth;
+        header.depth_width = frame.depth_width;
+        header.depth_height = frame.depth_height;
+        if (frame.confidence) {
+            header.sections |= kSectionConfidence;
+        }
+    }
+    if (frame.points && frame.point_count > 0) {
+        header.sections |= kSectionPoints;
+        header.point_count = frame.point_count;
+    }
+
+    const size_t depth_pixels = static_cast<size_t>(header.depth_width) * header.depth_height;
+    payload_.clear();
+    AppendSection(&payload_, &header, sizeof(header));
+    if (header.sections & kSectionImage) {
+        AppendSection(&payload_, frame.image, static_cast<size_t>(header.y_width) * header.y_height);
+    }
+    if (header.sections & kSectionDepth) {
+        AppendSection(&payload_, frame.depth, depth_pixels * sizeof(uint16_t));
+    }
+    if (header.sections & kSectionConfidence) {
+        AppendSection(&payload_, frame.confidence, depth_pixels);
+    }
+    if (header.sections & kSectionPoints) {
+        AppendSection(&payload_, frame.points, static_cast<size_t>(header.point_count) * 4 * sizeof(float));
+    }
+
+    ChunkHeader chunk = {};
+    chunk.tag = kFrameTag;
+    chunk.raw_size = static_cast<uint32_t>(payload_.size());
+    const uint8_t* stored = payload_.data();
+    size_t stored_size = payload_.size();
+#ifdef SLAMTORCH_HAVE_LZ4
+    if (compress_) {
+        compressed_.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(payload_.size()))));
+        const int size = LZ4_compress_default(reinterpret_cast<const char*>(payload_.data()),
+                                              reinterpret_cast<char*>(compressed_.data()),
+                                              static_cast<int>(payload_.size()),
+                                              static_cast<int>(compressed_.size()));
+        // Incompressible chunks are stored raw.
+        if (size > 0 && static_cast<size_t>(size) < payload_.size()) {
+            chunk.flags |= kChunkCompressed;
+            stored = compressed_.data();
+            stored_size = static_cast<size_t>(size);
+        }
+    }
+#endif
+    chunk.stored_size = static_cast<uint32_t>(stored_size);
+
+    static const uint8_t kPadding[8] = {};
+    const size_t padding = Align8(stored_size) - stored_size;
+    if (fwrite(&chunk, sizeof(chunk), 1, file_) != 1 ||
+        fwrite(stored, 1, stored_size, file_) != stored_size ||
+        (padding > 0 && fwrite(kPadding, 1, padding, file_) != padding)) {
+        LogPrint(LogLevel::ERROR, "SessionWriter: write failed after %d frames", frame_count_);
+        Close();
+        return false;
+    }
+    frame_count_++;
+    return true;
+}
+
+void SessionWriter::Close() {
+    if (!file_) return;
+    fclose(file_);
+    file_ = nullptr;
+    LogPrint(LogLevel::INFO, "SessionWriter: closed after %d frames", frame_count_);
+}
+
+SessionReader::~SessionReader() {
+    Close();
+}
+
+bool SessionReader::Open(const std::string& path) {
+    Close();
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LogPrint(LogLevel::ERROR, "SessionReader: cannot open %s", path.c_str());
+        return false;
+    }
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        LogPrint(LogLevel::ERROR, "SessionReader: %s is not a session", path.c_str());
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LogPrint(LogLevel::ERROR, "SessionReader: cannot map %s", path.c_str());
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(mapped);
+    size_ = static_cast<size_t>(st.st_size);
+
+    FileHeader header;
+    memcpy(&header, data_, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != SessionRecording::kVersion) {
+        LogPrint(LogLevel::ERROR, "SessionReader: %s has an unknown format", path.c_str());
+        Close();
+        return false;
+    }
+
+    size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(ChunkHeader) <= size_) {
+        ChunkHeader chunk;
+        memcpy(&chunk, data_ + offset, sizeof(chunk));
+        const size_t payload_offset = offset + sizeof(ChunkHeader);
+        if (chunk.stored_size > size_ - payload_offset) break;
+        if (chunk.tag == kFrameTag) {
+            ChunkInfo info;
+            info.offset = payload_offset;
+            info.stored_size = chunk.stored_size;
+            info.raw_size = chunk.raw_size;
+            info.compressed = (chunk.flags & kChunkCompressed) != 0;
+            chunks_.push_back(info);
+        }
+        offset = payload_offset + Align8(chunk.stored_size);
+    }
+    LogPrint(LogLevel::INFO, "SessionReader: %s has %d frames", path.c_str(), GetFrameCount());
+    return true;
+}
+
+void SessionReader::Close() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    chunks_.clear();
+}
+
+bool SessionReader::ReadFrame(int index, SessionFrame* out) {
+    if (!data_ || !out || index < 0 || index >= GetFrameCount()) return false;
+    const ChunkInfo& chunk = chunks_[static_cast<size_t>(index)];
+
+    const uint8_t* payload = data_ + chunk.offset;
+    size_t payload_size = chunk.stored_size;
+    if (chunk.compressed) {
+#ifdef SLAMTORCH_HAVE_LZ4
+        // Chunks are only stored compressed when that made them smaller.
+        if (chunk.raw_size > kMaxRawSize || chunk.stored_size >= chunk.raw_size) return false;
+        decompressed_.resize(chunk.raw_size);
+        const int size = LZ4_decompress_safe(reinterpret_cast<const char*>(payload),
+                                             reinterpret_cast<char*>(decompressed_.data()),
+                                             static_cast<int>(chunk.stored_size),
+                                             static_cast<int>(chunk.raw_size));
+        if (size != static_cast<int>(chunk.raw_size)) return false;
+        payload = decompressed_.data();
+        payload_size = chunk.raw_size;
+#else
+        LogPrint(LogLevel::ERROR, "SessionReader: frame %d is compressed but LZ4 is unavailable", index);
+        return false;
+#endif
+    }
+
+    if (payload_size < sizeof(FrameHeader)) return false;
+    FrameHeader header;
+    memcpy(&header, payload, sizeof(header));
+
+    if (header.image_width < 0 || header.image_width > kMaxDimension ||
+        header.image_height < 0 || header.image_height > kMaxDimension) {
+        return false;
+    }
+    const bool has_image = (header.sections & kSectionImage) != 0;
+    const bool has_depth = (header.sections & (kSectionDepth | kSectionConfidence)) != 0;
+    const bool has_points = (header.sections & kSectionPoints) != 0;
+    if (has_image && (!IsValidDimension(header.y_width) || !IsValidDimension(header.y_height))) return false;
+    if (has_depth && (!IsValidDimension(header.depth_width) || !IsValidDimension(header.depth_height))) return false;
+    if (has_points && (header.point_count <= 0 || header.point_count > kMaxPointCount)) return false;
+
+    size_t image_size = 0;
+    size_t depth_pixels = 0;
+    size_t depth_size = 0;
+    size_t points_size = 0;
+    if ((has_image && !MultiplySize(static_cast<size_t>(header.y_width), static_cast<size_t>(header.y_height),
+                                    &image_size)) ||
+        (has_depth && (!MultiplySize(static_cast<size_t>(header.depth_width),
+                                     static_cast<size_t>(header.depth_height), &depth_pixels) ||
+                       !MultiplySize(depth_pixels, sizeof(uint16_t), &depth_size))) ||
+        (has_points && !MultiplySize(static_cast<size_t>(header.point_count), 4 * sizeof(float), &points_size))) {
+        return false;
+    }
+
+    *out = SessionFrame{};
+    out->timestamp_ns = header.timestamp_ns;
+    memcpy(out->world_from_camera, header.world_from_camera, sizeof(out->world_from_camera));
+    out->fx = header.fx;
+    out->fy = header.fy;
+    out->cx = header.cx;
+    out->cy = header.cy;
+    out->image_width = header.image_width;
+    out->image_height = header.image_height;
+    out->flags = header.settings;
+
+    size_t offset = Align8(sizeof(FrameHeader));
+    const uint8_t* section = nullptr;
+    if (has_image) {
+        if (!TakeSection(payload, payload_size, image_size, &offset, &section)) return false;
+        out->image = section;
+        out->y_width = header.y_width;
+        out->y_height = header.y_height;
+    }
+    if (header.sections & kSectionDepth) {
+        if (!TakeSection(payload, payload_size, depth_size, &offset, &section)) return false;
+        out->depth = reinterpret_cast<const uint16_t*>(section);
+        out->depth_width = header.depth_width;
+        out->depth_height = header.depth_height;
+    }
+    if (header.sections & kSectionConfidence) {
+        if (!TakeSection(payload, payload_size, depth_pixels, &offset, &section)) return false;
+        out->confidence = section;
+    }
+    if (has_points) {
+        if (!TakeSection(payload, payload_size, points_size, &offset, &section)) return false;
+        out->points = reinterpret_cast<const float*>(section);
+        out->point_count = header.point_count;
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+#ifndef SLAMTORCH_SESSION_RECORDING_H
+#define SLAMTORCH_SESSION_RECORDING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Recorded sessions: everything the tracking and mapping core consumes per
+// frame, so a session can be replayed off-device.
+//
+// File layout (little-endian):
+//   FileHeader
+//   ChunkHeader + payload, one chunk per frame, payload padded to 8 bytes
+// A frame payload is a FrameHeader followed by the Y plane (y_width *
+// y_height bytes), depth (depth_width * depth_height uint16 mm), confidence
+// (depth_width * depth_height bytes) and the point cloud (point_count * 4
+// floats, xyz + confidence), each present only when its flag is set.
+// Payloads may be LZ4-compressed per chunk when built with LZ4 support.
+// A truncated trailing chunk, e.g. from a crash while recording, is ignored.
+
+// One frame; pointers refer to caller- or reader-owned memory.
+struct SessionFrame {
+    int64_t timestamp_ns = 0;
+    float world_from_camera[16] = {};
+    float fx = 0.0f;
+    float fy = 0.0f;
+    float cx = 0.0f;
+    float cy = 0.0f;
+    int image_width = 0;
+    int image_height = 0;
+
+    const uint8_t* image = nullptr;
+    int y_width = 0;
+    int y_height = 0;
+
+    const uint16_t* depth = nullptr;
+    const uint8_t* confidence = nullptr;
+    int depth_width = 0;
+    int depth_height = 0;
+
+    const float* points = nullptr;
+    int point_count = 0;
+
+    // Settings active while recording, see the kFlag* bits.
+    uint32_t flags = 0;
+};
+
+class SessionRecording {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    static constexpr uint32_t kFlagMapEnabled = 1u << 0;
+    static constexpr uint32_t kFlagTsdf = 1u << 1;
+    static constexpr uint32_t kFlagDepthMesh = 1u << 2;
+
+    // True when this build can write compressed chunks.
+    static bool HasCompression();
+};
+
+class SessionWriter {
+public:
+    SessionWriter() = default;
+    ~SessionWriter();
+    SessionWriter(const SessionWriter&) = delete;
+    SessionWriter& operator=(const SessionWriter&) = delete;
+
+    // compress is ignored without LZ4 support.
+    bool Open(const std::string& path, bool compress);
+    bool WriteFrame(const SessionFrame& frame);
+    void Close();
+
+    bool IsOpen() const { return file_ != nullptr; }
+    int GetFrameCount() const { return frame_count_; }
+
+private:
+    FILE* file_ = nullptr;
+    bool compress_ = false;
+    int frame_count_ = 0;
+    std::vector<uint8_t> payload_;
+    std::vector<uint8_t> compressed_;
+};
+
+class SessionReader {
+public:
+    SessionReader() = default;
+    ~SessionReader();
+    SessionReader(const SessionReader&) = delete;
+    SessionReader& operator=(const SessionReader&) = delete;
+
+    // Maps the file and indexes its chunks.
+    bool Open(const std::string& path);
+    void Close();
+
+    int GetFrameCount() const { return static_cast<int>(chunks_.size()); }
+    // Uncompressed frames point straight into the mapping; compressed ones
+    // into a buffer that the next ReadFrame call reuses. Frames with
+    // implausible sizes or sections that overrun the payload are rejected.
+    bool ReadFrame(int index, SessionFrame* out);
+
+private:
+    struct ChunkInfo {
+        size_t offset = 0;
+        uint32_t stored_size = 0;
+        uint32_t raw_size = 0;
+        bool compressed = false;
+    };
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<ChunkInfo> chunks_;
+    std::vector<uint8_t> decompressed_;
+};
+
+#endif // SLAMTORCH_SESSION_RECORDING_H
@@ -0,0 +1,114 @@
+#include "SessionReplay.h"
+#include "Log.h"
+#include <chrono>
+
+namespace {
+constexpr uint64_t kFnvOffset = 1469598103934665603ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+// World-space ARCore points go into the map untransformed.
+constexpr float kIdentity[16] = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+};
+
+void HashBytes(uint64_t* hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        *hash = (*hash ^ bytes[i]) * kFnvPrime;
+    }
+}
+
+template <typename T>
+void HashValue(uint64_t* hash, const T& value) {
+    HashBytes(hash, &value, sizeof(value));
+}
+}
+
+SessionReplay::SessionReplay(const Options& options)
+    : options_(options),
+      pipeline_(options.depth_mesh_width, options.depth_mesh_height, false, options.profiler) {
+}
+
+SessionReplay::Summary SessionReplay::Run(SessionReader* reader) {
+    Summary summary;
+    summary.checksum = kFnvOffset;
+
+    int frame_count = reader->GetFrameCount();
+    if (options_.max_frames > 0 && options_.max_frames < frame_count) {
+        frame_count = options_.max_frames;
+    }
+
+    int64_t first_timestamp = 0;
+    int64_t last_timestamp = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frame_count; ++i) {
+        SessionFrame frame;
+        if (!reader->ReadFrame(i, &frame)) {
+            summary.frames_failed++;
+            continue;
+        }
+        if (summary.frames == 0) {
+            first_timestamp = frame.timestamp_ns;
+        }
+        last_timestamp = frame.timestamp_ns;
+        Step(frame, &summary);
+        summary.frames++;
+    }
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    summary.session_seconds = static_cast<double>(last_timestamp - first_timestamp) * 1e-9;
+    summary.persistent_points = point_map_.GetPointCount();
+
+    if (summary.frames_failed > 0) {
+        LogPrint(LogLevel::WARN, "SessionReplay: %d frames could not be read", summary.frames_failed);
+    }
+    return summary;
+}
+
+void SessionReplay::Step(const SessionFrame& frame, Summary* summary) {
+    FramePipeline::Packet& packet = pipeline_.GetPacket();
+    packet.FromSessionFrame(frame);
+    if (options_.override_settings) {
+        packet.settings = options_.settings;
+    }
+    pipeline_.SubmitPacket();
+
+    if (frame.points && frame.point_count > 0) {
+        point_map_.AddPoints(kIdentity, frame.points, frame.point_count);
+    }
+
+    const FramePipeline::Result* result = pipeline_.AcquireResult();
+    if (!result) return;
+
+    if (result->tracking_updated) {
+        summary->feature_count = result->feature_count;
+        summary->metric_landmarks = result->metric_landmarks;
+    }
+    summary->landmark_count = result->landmark_count;
+    if (result->map_updated) {
+        summary->voxels_used = result->voxels_used;
+    }
+    summary->total_points_fused = result->total_points_fused;
+    summary->map_point_count = result->map_point_count;
+    summary->map_mesh_vertex_count = result->map_mesh_vertex_count;
+
+    uint64_t* hash = &summary->checksum;
+    HashValue(hash, result->feature_count);
+    HashValue(hash, result->stable_tracks);
+    HashValue(hash, result->landmark_count);
+    HashBytes(hash, result->landmark_ranges.data(),
+              result->landmark_ranges.size() * sizeof(SlotRange));
+    HashBytes(hash, result->landmark_vertices.data(),
+              result->landmark_vertices.size() * sizeof(LandmarkMap::Vertex));
+    HashValue(hash, result->voxels_used);
+    HashValue(hash, result->total_points_fused);
+    HashValue(hash, result->map_point_count);
+    if (result->map_points_dirty) {
+        HashBytes(hash, result->map_point_ranges.data(),
+                  result->map_point_ranges.size() * sizeof(SlotRange));
+        HashBytes(hash, result->map_points.data(), result->map_points.size() * sizeof(float));
+    }
+    HashValue(hash, result->map_mesh_vertex_count);
+}
@@ -0,0 +1,58 @@
+#ifndef SLAMTORCH_SESSION_REPLAY_H
+#define SLAMTORCH_SESSION_REPLAY_H
+
+#include <cstdint>
+
+#include "FramePipeline.h"
+#include "PersistentPointMap.h"
+#include "SessionRecording.h"
+
+// Feeds a recorded session through a synchronous FramePipeline (optical flow,
+// landmarks, depth preprocessing and mapping) plus the persistent point map,
+// one frame after another with no pacing. Identical inputs give identical
+// summaries, including the checksum.
+class SessionReplay {
+public:
+    struct Options {
+        // Replace the recorded per-frame settings with these.
+        bool override_settings = false;
+        FramePipeline::Settings settings;
+        // 0 replays every frame.
+        int max_frames = 0;
+        int depth_mesh_width = 160;
+        int depth_mesh_height = 120;
+        // Receives the pipeline's stage timings when set.
+        FrameProfiler* profiler = nullptr;
+    };
+
+    struct Summary {
+        int frames = 0;
+        int frames_failed = 0;
+        double seconds = 0.0;
+        // Recorded time span, for comparing against real time.
+        double session_seconds = 0.0;
+        int feature_count = 0;
+        int landmark_count = 0;
+        int metric_landmarks = 0;
+        int voxels_used = 0;
+        int64_t total_points_fused = 0;
+        int map_point_count = 0;
+        int map_mesh_vertex_count = 0;
+        int persistent_points = 0;
+        // FNV-1a over every frame's result; equal across deterministic runs.
+        uint64_t checksum = 0;
+    };
+
+    explicit SessionReplay(const Options& options);
+
+    Summary Run(SessionReader* reader);
+
+private:
+    void Step(const SessionFrame& frame, Summary* summary);
+
+    Options options_;
+    FramePipeline pipeline_;
+    PersistentPointMap point_map_;
+};
+
+#endif // SLAMTORCH_SESSION_REPLAY_H
@@ -0,0 +1,22 @@
+#include "SlotRange.h"
+#include <algorithm>
+
+void MergeRanges(std::vector<SlotRange>* ranges, int gap, int max_ranges) {
+    if (ranges->empty()) return;
+    std::sort(ranges->begin(), ranges->end(),
+              [](const SlotRange& a, const SlotRange& b) { return a.begin < b.begin; });
+    for (;; gap *= 2) {
+        size_t merged = 0;
+        for (size_t k = 1; k < ranges->size(); ++k) {
+            SlotRange& last = (*ranges)[merged];
+            const SlotRange& next = (*ranges)[k];
+            if (next.begin - last.end <= gap) {
+                last.end = std::max(last.end, next.end);
+            } else {
+                (*ranges)[++merged] = next;
+            }
+        }
+        ranges->resize(merged + 1);
+        if (static_cast<int>(ranges->size()) <= max_ranges) break;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef SLAMTORCH_SLOT_RANGE_H
+#define SLAMTORCH_SLOT_RANGE_H
+
+#include <vector>
+
+// Half-open range of buffer slots, the unit in which maps report changes and
+// renderers re-upload them.
+struct SlotRange {
+    int begin = 0;
+    int end = 0;
+};
+
+// Sorts ranges and merges those at most gap apart, doubling the gap until at
+// most max_ranges are left, so a few clean slots ride along instead of
+// costing another upload.
+void MergeRanges(std::vector<SlotRange>* ranges, int gap, int max_ranges);
+
+#endif // SLAMTORCH_SLOT_RANGE_H
@@ -0,0 +1,76 @@
+#include "SpatialHashGrid.h"
+#include <algorithm>
+
+SpatialHashGrid::SpatialHashGrid(int capacity, float cell_size)
+    : inv_cell_size_(1.0f / cell_size) {
+    // About two buckets per item keeps chains short at full capacity.
+    uint32_t bucket_count = 64;
+    while (bucket_count < static_cast<uint32_t>(capacity) * 2) {
+        bucket_count <<= 1;
+    }
+    bucket_mask_ = bucket_count - 1;
+    heads_.assign(bucket_count, -1);
+    next_.assign(static_cast<size_t>(capacity), -1);
+    prev_.assign(static_cast<size_t>(capacity), -1);
+    item_bucket_.assign(static_cast<size_t>(capacity), -1);
+}
+
+void SpatialHashGrid::Link(int item, int bucket) {
+    const int head = heads_[bucket];
+    next_[item] = head;
+    prev_[item] = -1;
+    if (head >= 0) {
+        prev_[head] = item;
+    }
+    heads_[bucket] = item;
+    item_bucket_[item] = bucket;
+}
+
+void SpatialHashGrid::Unlink(int item) {
+    const int bucket = item_bucket_[item];
+    if (prev_[item] >= 0) {
+        next_[prev_[item]] = next_[item];
+    } else {
+        heads_[bucket] = next_[item];
+    }
+    if (next_[item] >= 0) {
+        prev_[next_[item]] = prev_[item];
+    }
+    next_[item] = -1;
+    prev_[item] = -1;
+    item_bucket_[item] = -1;
+}
+
+void SpatialHashGrid::Insert(int item, const float* pos) {
+    if (Contains(item)) {
+        Move(item, pos);
+        return;
+    }
+    Link(item, BucketForPos(pos));
+    count_++;
+}
+
+void SpatialHashGrid::Remove(int item) {
+    if (!Contains(item)) return;
+    Unlink(item);
+    count_--;
+}
+
+void SpatialHashGrid::Move(int item, const float* pos) {
+    if (!Contains(item)) {
+        Insert(item, pos);
+        return;
+    }
+    const int bucket = BucketForPos(pos);
+    if (bucket == item_bucket_[item]) return;
+    Unlink(item);
+    Link(item, bucket);
+}
+
+void SpatialHashGrid::Clear() {
+    std::fill(heads_.begin(), heads_.end(), -1);
+    std::fill(next_.begin(), next_.end(), -1);
+    std::fill(prev_.begin(), prev_.end(), -1);
+    std::fill(item_bucket_.begin(), item_bucket_.end(), -1);
+    count_ = 0;
+}
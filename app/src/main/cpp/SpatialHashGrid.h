@@ -0,0 +1,78 @@
+#ifndef SLAMTORCH_SPATIAL_HASH_GRID_H
+#define SLAMTORCH_SPATIAL_HASH_GRID_H
+
+#include "OpenAddressing.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Uniform 3D grid hashed into a fixed bucket table. Items are the indices
+// 0..capacity-1 of some external array; each bucket chains its items through
+// intrusive prev/next links so insert, remove and move are O(1) and nothing
+// allocates after construction. Cells that collide share a bucket, so callers
+// still distance-check what ForEachNear visits.
+class SpatialHashGrid {
+public:
+    SpatialHashGrid(int capacity, float cell_size);
+
+    void Insert(int item, const float* pos);
+    void Remove(int item);
+    // Re-buckets an item after its position changed; inserts it if needed.
+    void Move(int item, const float* pos);
+    bool Contains(int item) const { return item_bucket_[item] >= 0; }
+    int GetCount() const { return count_; }
+    void Clear();
+
+    // Visits every item in the 27 cells around pos, i.e. at least everything
+    // within one cell size of it. Each item is visited once.
+    template <typename Fn>
+    void ForEachNear(const float* pos, Fn&& fn) const {
+        const int cx = CellCoord(pos[0]);
+        const int cy = CellCoord(pos[1]);
+        const int cz = CellCoord(pos[2]);
+        int buckets[27];
+        int bucket_count = 0;
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int bucket = BucketFor(cx + dx, cy + dy, cz + dz);
+                    if (heads_[bucket] < 0) continue;
+                    bool seen = false;
+                    for (int i = 0; i < bucket_count; ++i) {
+                        if (buckets[i] == bucket) {
+                            seen = true;
+                            break;
+                        }
+                    }
+                    if (seen) continue;
+                    buckets[bucket_count++] = bucket;
+                    for (int item = heads_[bucket]; item >= 0; item = next_[item]) {
+                        fn(item);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    int CellCoord(float v) const { return static_cast<int>(std::floor(v * inv_cell_size_)); }
+    int BucketFor(int cx, int cy, int cz) const {
+        return static_cast<int>(HashCell(cx, cy, cz) & bucket_mask_);
+    }
+    int BucketForPos(const float* pos) const {
+        return BucketFor(CellCoord(pos[0]), CellCoord(pos[1]), CellCoord(pos[2]));
+    }
+    void Link(int item, int bucket);
+    void Unlink(int item);
+
+    float inv_cell_size_ = 1.0f;
+    uint32_t bucket_mask_ = 0;
+    int count_ = 0;
+    std::vector<int> heads_;
+    std::vector<int> next_;
+    std::vector<int> prev_;
+    // -1 when the item is not indexed.
+    std::vector<int> item_bucket_;
+};
+
+#endif // SLAMTORCH_SPATIAL_HASH_GRID_H
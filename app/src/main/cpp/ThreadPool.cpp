@@ -0,0 +1,124 @@
+#include "ThreadPool.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+ThreadPool::ThreadPool(int worker_count, bool big_cores_only) {
+    std::vector<int> cpus;
+    if (big_cores_only) {
+        cpus = FindBigCores();
+    }
+    workers_.reserve(static_cast<size_t>(std::max(worker_count, 0)));
+    for (int i = 0; i < worker_count; ++i) {
+        workers_.emplace_back(&ThreadPool::Run, this, cpus);
+    }
+    LogPrint(LogLevel::INFO, "ThreadPool started: %d workers, %zu pinned cpus", worker_count, cpus.size());
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::vector<int> ThreadPool::FindBigCores() {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    const int cpu_count = static_cast<int>(std::thread::hardware_concurrency());
+    std::vector<long> max_freq(static_cast<size_t>(cpu_count), 0);
+    long best = 0;
+    for (int cpu = 0; cpu < cpu_count; ++cpu) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        FILE* file = fopen(path, "r");
+        if (!file) continue;
+        if (fscanf(file, "%ld", &max_freq[cpu]) != 1) {
+            max_freq[cpu] = 0;
+        }
+        fclose(file);
+        best = std::max(best, max_freq[cpu]);
+    }
+    if (best <= 0) return cpus;
+    for (int cpu = 0; cpu < cpu_count; ++cpu) {
+        if (max_freq[cpu] == best) {
+            cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+void ThreadPool::Dispatch(int count, int chunk_size, JobFn fn, void* context) {
+    if (count <= 0) return;
+    chunk_size = std::max(chunk_size, 1);
+    if (workers_.empty() || count <= chunk_size) {
+        fn(context, 0, count);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_fn_ = fn;
+        job_context_ = context;
+        job_count_ = count;
+        job_chunk_ = chunk_size;
+        next_index_.store(0, std::memory_order_relaxed);
+        busy_workers_ = static_cast<int>(workers_.size());
+        generation_++;
+    }
+    wake_.notify_all();
+    RunChunks();
+    // Workers finish their last chunk before checking out, so once all of
+    // them have, every chunk is done and its writes are visible here.
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_workers_ == 0; });
+}
+
+void ThreadPool::Run(const std::vector<int>& cpus) {
+#if defined(__linux__)
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            LogPrint(LogLevel::WARN, "ThreadPool: could not pin worker to big cores");
+        }
+    }
+#else
+    (void)cpus;
+#endif
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+        }
+        RunChunks();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_workers_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::RunChunks() {
+    while (true) {
+        const int begin = next_index_.fetch_add(job_chunk_, std::memory_order_relaxed);
+        if (begin >= job_count_) return;
+        job_fn_(job_context_, begin, std::min(begin + job_chunk_, job_count_));
+    }
+}
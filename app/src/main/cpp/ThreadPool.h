@@ -0,0 +1,65 @@
+#ifndef SLAMTORCH_THREAD_POOL_H
+#define SLAMTORCH_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. The thread calling
+// ParallelFor works through the loop too, so a pool of N workers runs on up
+// to N + 1 threads and a pool of 0 runs everything inline.
+class ThreadPool {
+public:
+    // With big_cores_only, workers are pinned to the fastest cluster of a
+    // big.LITTLE CPU; ignored where core speeds cannot be read.
+    explicit ThreadPool(int worker_count, bool big_cores_only = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int GetWorkerCount() const { return static_cast<int>(workers_.size()); }
+
+    // Calls fn(begin, end) for chunks of chunk_size covering [0, count) and
+    // returns once all of them are done. Threads claim chunks as they go, so
+    // fn must give the same result whichever thread runs a chunk.
+    template <typename Fn>
+    void ParallelFor(int count, int chunk_size, Fn&& fn) {
+        using Callable = std::remove_reference_t<Fn>;
+        Dispatch(count, chunk_size,
+                 [](void* context, int begin, int end) { (*static_cast<Callable*>(context))(begin, end); },
+                 const_cast<void*>(static_cast<const void*>(&fn)));
+    }
+
+    // CPUs with the highest maximum frequency, or empty if unknown.
+    static std::vector<int> FindBigCores();
+
+private:
+    using JobFn = void (*)(void* context, int begin, int end);
+
+    void Dispatch(int count, int chunk_size, JobFn fn, void* context);
+    void Run(const std::vector<int>& cpus);
+    void RunChunks();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    bool stop_ = false;
+    // Bumped per job; workers run each generation once.
+    uint64_t generation_ = 0;
+    int busy_workers_ = 0;
+
+    // Current job; written under mutex_ before the generation bump.
+    JobFn job_fn_ = nullptr;
+    void* job_context_ = nullptr;
+    int job_count_ = 0;
+    int job_chunk_ = 1;
+    std::atomic<int> next_index_{0};
+};
+
+#endif // SLAMTORCH_THREAD_POOL_H
@@ -0,0 +1,42 @@
+#ifndef SLAMTORCH_TRIPLE_BUFFER_H
+#define SLAMTORCH_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free hand-off of the latest value from one producer thread to one
+// consumer thread. Each side owns one of the three buffers; the third sits in
+// the middle and is swapped atomically. Neither side ever waits, and a value
+// published before the consumer got to the previous one replaces it.
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer side.
+    T& GetWriteBuffer() { return buffers_[write_index_]; }
+    void Publish() {
+        const int previous = middle_.exchange(write_index_ | kFreshBit, std::memory_order_acq_rel);
+        write_index_ = previous & kIndexMask;
+    }
+
+    // True while the last published value has not been acquired.
+    bool HasUnread() const { return (middle_.load(std::memory_order_acquire) & kFreshBit) != 0; }
+
+    // Consumer side. Returns the newest value published since the last call,
+    // or nullptr. The value stays valid until the next successful Acquire().
+    T* Acquire() {
+        if (!HasUnread()) return nullptr;
+        const int previous = middle_.exchange(read_index_, std::memory_order_acq_rel);
+        read_index_ = previous & kIndexMask;
+        return &buffers_[read_index_];
+    }
+
+private:
+    static constexpr int kIndexMask = 3;
+    static constexpr int kFreshBit = 4;
+
+    T buffers_[3];
+    int write_index_ = 0;
+    int read_index_ = 1;
+    std::atomic<int> middle_{2};
+};
+
+#endif // SLAMTORCH_TRIPLE_BUFFER_H
@@ -1,8 +1,32 @@
 #include "VoxelMapRenderer.h"
 #include <android/log.h>
+#include <algorithm>
 #include <cstring>
 
 namespace {
+constexpr GLsizei kPointStride = 3 * sizeof(float);
+constexpr GLsizei kMeshStride = 6 * sizeof(float);
+
+// Grows vbo to capacity items first; the data for ranges is back to back.
+void UploadRanges(GLuint vbo, GLsizei stride, int capacity, int* allocated,
+                  const SlotRange* ranges, int range_count, const float* data) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (capacity > *allocated) {
+        *allocated = capacity;
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity) * stride, nullptr, GL_DYNAMIC_DRAW);
+    }
+    const size_t floats_per_item = stride / sizeof(float);
+    for (int r = 0; r < range_count && data; ++r) {
+        const int end = std::min(ranges[r].end, *allocated);
+        if (end > ranges[r].begin) {
+            glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(ranges[r].begin) * stride,
+                            static_cast<GLsizeiptr>(end - ranges[r].begin) * stride, data);
+        }
+        data += static_cast<size_t>(ranges[r].end - ranges[r].begin) * floats_per_item;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 const char* kVertexShader = R"(
     #version 300 es
     precision highp float;
@@ -26,6 +50,50 @@ const char* kFragmentShader = R"(
     }
 )";
 
+const char* kMeshVertexShader = R"(
+    #version 300 es
+    precision highp float;
+    uniform mat4 u_MVP;
+    uniform mat4 u_View;
+    layout(location = 0) in vec3 a_Position;
+    layout(location = 1) in vec3 a_Normal;
+    out vec3 v_ViewNormal;
+    void main() {
+        gl_Position = u_MVP * vec4(a_Position, 1.0);
+        v_ViewNormal = mat3(u_View) * a_Normal;
+    }
+)";
+
+const char* kMeshFragmentShader = R"(
+    #version 300 es
+    precision mediump float;
+    in vec3 v_ViewNormal;
+    out vec4 FragColor;
+    void main() {
+        float lambert = abs(normalize(v_ViewNormal).z);
+        FragColor = vec4(vec3(0.2, 0.8, 1.0) * (0.25 + 0.75 * lambert), 0.85);
+    }
+)";
+
+GLuint CreateProgram(const char* vertex_source, const char* fragment_source) {
+    GLuint vert = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vert, 1, &vertex_source, nullptr);
+    glCompileShader(vert);
+
+    GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(frag, 1, &fragment_source, nullptr);
+    glCompileShader(frag);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vert);
+    glAttachShader(program, frag);
+    glLinkProgram(program);
+
+    glDeleteShader(vert);
+    glDeleteShader(frag);
+    return program;
+}
+
 void Multiply4x4(const float* a, const float* b, float* out) {
     for (int i = 0; i < 16; ++i) out[i] = 0.0f;
     for (int col = 0; col < 4; ++col) {
@@ -41,22 +109,7 @@ void Multiply4x4(const float* a, const float* b, float* out) {
 }
 
 void VoxelMapRenderer::Initialize() {
-    GLuint vert = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert, 1, &kVertexShader, nullptr);
-    glCompileShader(vert);
-
-    GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag, 1, &kFragmentShader, nullptr);
-    glCompileShader(frag);
-
-    program_ = glCreateProgram();
-    glAttachShader(program_, vert);
-    glAttachShader(program_, frag);
-    glLinkProgram(program_);
-
-    glDeleteShader(vert);
-    glDeleteShader(frag);
-
+    program_ = CreateProgram(kVertexShader, kFragmentShader);
     mvp_uniform_ = glGetUniformLocation(program_, "u_MVP");
     point_size_uniform_ = glGetUniformLocation(program_, "u_PointSize");
 
@@ -69,18 +122,29 @@ void VoxelMapRenderer::Initialize() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
-}
 
-void VoxelMapRenderer::UpdatePoints(const float* points, int point_count) {
-    if (!points || point_count <= 0) {
-        point_count_ = 0;
-        return;
-    }
-    point_count_ = point_count;
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, point_count_ * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, point_count_ * 3 * sizeof(float), points);
+    mesh_program_ = CreateProgram(kMeshVertexShader, kMeshFragmentShader);
+    mesh_mvp_uniform_ = glGetUniformLocation(mesh_program_, "u_MVP");
+    mesh_view_uniform_ = glGetUniformLocation(mesh_program_, "u_View");
+
+    glGenVertexArrays(1, &mesh_vao_);
+    glGenBuffers(1, &mesh_vbo_);
+    glBindVertexArray(mesh_vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kMeshStride, nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, kMeshStride,
+                          reinterpret_cast<const void*>(3 * sizeof(float)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void VoxelMapRenderer::UpdatePoints(const SlotRange* ranges, int range_count,
+                                    const float* points, int point_count, int capacity) {
+    UploadRanges(vbo_, kPointStride, capacity, &capacity_, ranges, range_count, points);
+    point_count_ = std::min(point_count, capacity_);
 }
 
 void VoxelMapRenderer::Draw(const float* view, const float* proj) {
@@ -99,3 +163,31 @@ void VoxelMapRenderer::Draw(const float* view, const float* proj) {
     glBindVertexArray(0);
     glUseProgram(0);
 }
+
+void VoxelMapRenderer::UpdateMesh(const SlotRange* ranges, int range_count,
+                                  const float* vertices, int vertex_count, int capacity) {
+    UploadRanges(mesh_vbo_, kMeshStride, capacity, &mesh_capacity_, ranges, range_count, vertices);
+    mesh_vertex_count_ = std::min(vertex_count, mesh_capacity_);
+}
+
+void VoxelMapRenderer::Clear() {
+    point_count_ = 0;
+    mesh_vertex_count_ = 0;
+}
+
+void VoxelMapRenderer::DrawMesh(const float* view, const float* proj) {
+    if (!view || !proj || mesh_vertex_count_ <= 0) return;
+
+    float mvp[16];
+    Multiply4x4(proj, view, mvp);
+
+    glUseProgram(mesh_program_);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glUniformMatrix4fv(mesh_mvp_uniform_, 1, GL_FALSE, mvp);
+    glUniformMatrix4fv(mesh_view_uniform_, 1, GL_FALSE, view);
+    glBindVertexArray(mesh_vao_);
+    glDrawArrays(GL_TRIANGLES, 0, mesh_vertex_count_);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
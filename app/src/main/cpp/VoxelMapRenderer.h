@@ -2,14 +2,28 @@
 #define SLAMTORCH_VOXEL_MAP_RENDERER_H
 
 #include <GLES3/gl3.h>
+#include "SlotRange.h"
 
 class VoxelMapRenderer {
 public:
     void Initialize();
-    void UpdatePoints(const float* points, int point_count);
+    // Applies one FramePipeline result: points holds the points of ranges
+    // back to back. The buffer is reallocated when capacity grows, and the
+    // ranges then cover every point.
+    void UpdatePoints(const SlotRange* ranges, int range_count, const float* points,
+                      int point_count, int capacity);
     void Draw(const float* view, const float* proj);
     int GetPointCount() const { return point_count_; }
 
+    // Triangle mesh from DepthMapper::GetMeshVertices (position + normal per
+    // vertex), drawn with simple headlight shading. Patched like the points.
+    void UpdateMesh(const SlotRange* ranges, int range_count, const float* vertices,
+                    int vertex_count, int capacity);
+    void DrawMesh(const float* view, const float* proj);
+    // Drops points and mesh until the next update; buffers are kept.
+    void Clear();
+    int GetMeshVertexCount() const { return mesh_vertex_count_; }
+
 private:
     GLuint program_ = 0;
     GLuint vao_ = 0;
@@ -17,6 +31,15 @@ private:
     GLint mvp_uniform_ = -1;
     GLint point_size_uniform_ = -1;
     int point_count_ = 0;
+    int capacity_ = 0;
+
+    GLuint mesh_program_ = 0;
+    GLuint mesh_vao_ = 0;
+    GLuint mesh_vbo_ = 0;
+    GLint mesh_mvp_uniform_ = -1;
+    GLint mesh_view_uniform_ = -1;
+    int mesh_vertex_count_ = 0;
+    int mesh_capacity_ = 0;
 };
 
 #endif // SLAMTORCH_VOXEL_MAP_RENDERER_H
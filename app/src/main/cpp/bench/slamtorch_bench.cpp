@@ -0,0 +1,565 @@
+// Microbenchmarks for the per-frame hot paths of the SLAM core.
+//
+// Inputs are a synthetic textured scene moving past the camera, or the first
+// frames of a recorded session when SLAMTORCH_BENCH_SESSION names one. The
+// bench target writes bench.json to the build directory:
+//
+//   cmake --build build --target bench
+//
+// Items and bytes processed are reported per benchmark, so ns/frame and
+// throughput can be compared across commits.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "DepthMapper.h"
+#include "DepthMeshBuilder.h"
+#include "DepthPreprocessor.h"
+#include "DepthRayCache.h"
+#include "FramePipeline.h"
+#include "LandmarkMap.h"
+#include "Log.h"
+#include "OpticalFlowKernels.h"
+#include "OpticalFlowTracker.h"
+#include "PersistentPointMap.h"
+#include "PolygonTriangulator.h"
+#include "SessionRecording.h"
+
+namespace {
+constexpr int kImageWidth = 640;
+constexpr int kImageHeight = 480;
+constexpr int kDepthWidth = 160;
+constexpr int kDepthHeight = 120;
+constexpr int kFrameCount = 16;
+constexpr int kMaxTracks = 800;
+constexpr int kPyramidLevels = 3;
+
+void SilentSink(LogLevel, const char*) {}
+
+// Pyramid and gradients built the way OpticalFlowTracker builds them, so its
+// kernels can be timed stage by stage.
+class FlowPyramid {
+public:
+    FlowPyramid(int width, int height) {
+        for (int level = 0; level < kPyramidLevels; ++level) {
+            widths_[level] = width;
+            heights_[level] = height;
+            levels_[level].assign(static_cast<size_t>(width * height), 0);
+            gradients_[level].assign(static_cast<size_t>(2 * width * height), 0);
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+        }
+        filter_row_.resize(static_cast<size_t>(widths_[0] + 4));
+    }
+
+    void Build(const uint8_t* image, bool gaussian, bool zero_copy) {
+        if (zero_copy) {
+            base_ = image;
+        } else {
+            memcpy(levels_[0].data(), image, levels_[0].size());
+            base_ = levels_[0].data();
+        }
+        for (int level = 1; level < kPyramidLevels; ++level) {
+            if (gaussian) {
+                OpticalFlowKernels::DownsampleGaussian(Level(level - 1), widths_[level - 1], heights_[level - 1],
+                                                       levels_[level].data(), widths_[level], heights_[level],
+                                                       filter_row_.data());
+            } else {
+                OpticalFlowKernels::DownsampleBox(Level(level - 1), widths_[level - 1], heights_[level - 1],
+                                                  levels_[level].data(), widths_[level], heights_[level]);
+            }
+        }
+    }
+
+    void BuildGradients() {
+        for (int level = 0; level < kPyramidLevels; ++level) {
+            OpticalFlowKernels::ScharrGradients(Level(level), widths_[level], heights_[level],
+                                                gradients_[level].data());
+        }
+    }
+
+    const uint8_t* Level(int level) const { return level == 0 ? base_ : levels_[level].data(); }
+    const int16_t* Gradient(int level) const { return gradients_[level].data(); }
+    int Width(int level) const { return widths_[level]; }
+    int Height(int level) const { return heights_[level]; }
+
+private:
+    std::vector<uint8_t> levels_[kPyramidLevels];
+    std::vector<int16_t> gradients_[kPyramidLevels];
+    int widths_[kPyramidLevels] = {};
+    int heights_[kPyramidLevels] = {};
+    std::vector<uint16_t> filter_row_;
+    const uint8_t* base_ = nullptr;
+};
+
+DepthFrame ToDepthFrame(const FramePipeline::Packet& packet) {
+    DepthFrame frame;
+    frame.depth_data = packet.depth.data();
+    frame.width = packet.depth_width;
+    frame.height = packet.depth_height;
+    frame.row_stride = packet.depth_width * static_cast<int>(sizeof(uint16_t));
+    frame.pixel_stride = sizeof(uint16_t);
+    if (packet.has_confidence) {
+        frame.confidence_data = packet.confidence.data();
+        frame.confidence_row_stride = packet.depth_width;
+        frame.confidence_pixel_stride = 1;
+    }
+    return frame;
+}
+
+// A textured wall with a few boxes in front of it, seen by a camera sliding
+// sideways and slowly turning.
+void MakeSyntheticFrame(int index, FramePipeline::Packet* packet) {
+    const float t = static_cast<float>(index);
+    const float yaw = 0.004f * t;
+    const float c = std::cos(yaw);
+    const float s = std::sin(yaw);
+    const float pose[16] = {
+        c, 0.0f, -s, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        s, 0.0f, c, 0.0f,
+        0.01f * t, 0.0f, 0.0f, 1.0f
+    };
+    memcpy(packet->world_from_camera, pose, sizeof(pose));
+    packet->timestamp_ns = static_cast<int64_t>(index) * 33333333;
+    packet->fx = 500.0f;
+    packet->fy = 500.0f;
+    packet->cx = kImageWidth * 0.5f;
+    packet->cy = kImageHeight * 0.5f;
+    packet->image_width = kImageWidth;
+    packet->image_height = kImageHeight;
+
+    packet->y_width = kImageWidth;
+    packet->y_height = kImageHeight;
+    packet->image.resize(static_cast<size_t>(kImageWidth) * kImageHeight);
+    const int shift = index * 3;
+    for (int y = 0; y < kImageHeight; ++y) {
+        for (int x = 0; x < kImageWidth; ++x) {
+            const int u = x + shift;
+            const float texture = 60.0f * std::sin(u * 0.13f) * std::cos(y * 0.11f);
+            const int checker = ((u / 16) + (y / 16)) & 1;
+            packet->image[static_cast<size_t>(y) * kImageWidth + x] =
+                static_cast<uint8_t>(120.0f + texture + 40.0f * checker);
+        }
+    }
+    packet->has_image = true;
+
+    packet->depth_width = kDepthWidth;
+    packet->depth_height = kDepthHeight;
+    packet->depth.resize(static_cast<size_t>(kDepthWidth) * kDepthHeight);
+    packet->confidence.resize(packet->depth.size());
+    for (int y = 0; y < kDepthHeight; ++y) {
+        for (int x = 0; x < kDepthWidth; ++x) {
+            const int u = x + index;
+            float depth_mm = 3000.0f + 4.0f * (x - kDepthWidth / 2);
+            if (((u / 24) & 1) && y > kDepthHeight / 3 && y < 2 * kDepthHeight / 3) {
+                depth_mm = 1500.0f + 200.0f * std::sin(u * 0.2f);
+            }
+            const size_t i = static_cast<size_t>(y) * kDepthWidth + x;
+            // A sprinkle of holes, as real depth has.
+            const bool hole = ((x * 7 + y * 13 + index) % 97) == 0;
+            packet->depth[i] = hole ? 0 : static_cast<uint16_t>(depth_mm);
+            packet->confidence[i] = 255;
+        }
+    }
+    packet->has_depth = true;
+    packet->has_confidence = true;
+
+    std::vector<float> points(256 * 4);
+    for (int i = 0; i < 256; ++i) {
+        points[i * 4 + 0] = 0.02f * (i % 32) - 0.3f + 0.01f * t;
+        points[i * 4 + 1] = 0.02f * (i / 32) - 0.1f;
+        points[i * 4 + 2] = -1.5f - 0.01f * (i % 7);
+        points[i * 4 + 3] = 0.8f;
+    }
+    packet->SetPoints(points.data(), 256);
+    packet->settings = FramePipeline::Settings{};
+}
+
+struct Inputs {
+    std::vector<FramePipeline::Packet> frames;
+    // One preprocessed depth image per frame, so mapping benchmarks time only
+    // the mapper.
+    std::vector<std::unique_ptr<DepthPreprocessor>> depth;
+    DepthRayCache rays;
+};
+
+const Inputs& GetInputs() {
+    static const Inputs* inputs = [] {
+        SetLogSink(SilentSink);
+        auto* result = new Inputs;
+        result->frames.resize(kFrameCount);
+
+        int frame_count = 0;
+        const char* session_path = getenv("SLAMTORCH_BENCH_SESSION");
+        SessionReader reader;
+        if (session_path && reader.Open(session_path)) {
+            SessionFrame frame;
+            for (int i = 0; i < reader.GetFrameCount() && frame_count < kFrameCount; ++i) {
+                if (!reader.ReadFrame(i, &frame) || !frame.image || !frame.depth) continue;
+                result->frames[frame_count++].FromSessionFrame(frame);
+            }
+        }
+        if (frame_count == 0) {
+            for (int i = 0; i < kFrameCount; ++i) {
+                MakeSyntheticFrame(i, &result->frames[i]);
+            }
+            frame_count = kFrameCount;
+        }
+        result->frames.resize(frame_count);
+
+        for (const FramePipeline::Packet& packet : result->frames) {
+            auto depth = std::make_unique<DepthPreprocessor>();
+            depth->Process(ToDepthFrame(packet), false);
+            result->depth.push_back(std::move(depth));
+        }
+        const FramePipeline::Packet& first = result->frames[0];
+        result->rays.Update(first.fx, first.fy, first.cx, first.cy,
+                            first.image_width, first.image_height,
+                            first.depth_width, first.depth_height);
+        return result;
+    }();
+    return *inputs;
+}
+
+void BM_OpticalFlow_BuildPyramid(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    const FramePipeline::Packet& frame = inputs.frames[0];
+    FlowPyramid pyramid(frame.y_width, frame.y_height);
+    size_t index = 0;
+    for (auto _ : state) {
+        pyramid.Build(inputs.frames[index].image.data(), state.range(0) != 0, state.range(1) != 0);
+        index = (index + 1) % inputs.frames.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.y_width) * frame.y_height);
+}
+// Args: filter (0 box, 1 Gaussian), zero-copy level 0.
+BENCHMARK(BM_OpticalFlow_BuildPyramid)->Args({0, 0})->Args({0, 1})->Args({1, 0})->Args({1, 1});
+
+// Shi-Tomasi scores over every detection cell of a frame, as when seeding
+// from scratch.
+void BM_OpticalFlow_CornerScores(benchmark::State& state) {
+    constexpr int kCell = 24;
+    constexpr int kBorder = 6;
+    const Inputs& inputs = GetInputs();
+    const FramePipeline::Packet& frame = inputs.frames[0];
+    FlowPyramid pyramid(frame.y_width, frame.y_height);
+    pyramid.Build(frame.image.data(), false, false);
+    pyramid.BuildGradients();
+    std::vector<float> scratch;
+    int64_t cells = 0;
+    for (auto _ : state) {
+        for (int y = kBorder; y + kCell <= frame.y_height - kBorder; y += kCell) {
+            for (int x = kBorder; x + kCell <= frame.y_width - kBorder; x += kCell) {
+                benchmark::DoNotOptimize(OpticalFlowKernels::MinEigenvalueScores(
+                    pyramid.Gradient(0), frame.y_width, x - 1, y - 1, kCell + 2, kCell + 2, &scratch));
+                cells++;
+            }
+        }
+    }
+    state.SetItemsProcessed(cells);
+}
+BENCHMARK(BM_OpticalFlow_CornerScores);
+
+// Items are tracked features, so items_per_second is features per second.
+void BM_OpticalFlow_TrackFeatureAtLevel(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    const int level = static_cast<int>(state.range(0));
+    const FramePipeline::Packet& frame = inputs.frames[0];
+    const FramePipeline::Packet& next = inputs.frames[1 % inputs.frames.size()];
+    OpticalFlowTracker tracker(kMaxTracks, kPyramidLevels);
+    tracker.Update(frame.image.data(), frame.y_width, frame.y_height);
+    FlowPyramid prev(frame.y_width, frame.y_height);
+    FlowPyramid curr(frame.y_width, frame.y_height);
+    prev.Build(frame.image.data(), false, false);
+    prev.BuildGradients();
+    curr.Build(next.image.data(), false, false);
+    const float scale = 1.0f / static_cast<float>(1 << level);
+    int64_t tracked = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < tracker.GetTrackCount(); ++i) {
+            const OpticalFlowTracker::Track& track = tracker.GetTracks()[i];
+            if (!track.active) continue;
+            const float x = track.x * scale;
+            const float y = track.y * scale;
+            float out_x = 0.0f;
+            float out_y = 0.0f;
+            benchmark::DoNotOptimize(OpticalFlowKernels::TrackLevel(prev.Level(level), prev.Gradient(level),
+                                                                    curr.Level(level), prev.Width(level),
+                                                                    prev.Height(level), x, y, x, y, &out_x,
+                                                                    &out_y));
+            tracked++;
+        }
+    }
+    state.SetItemsProcessed(tracked);
+}
+BENCHMARK(BM_OpticalFlow_TrackFeatureAtLevel)->DenseRange(0, kPyramidLevels - 1);
+
+void BM_OpticalFlow_Update(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    OpticalFlowTracker tracker(kMaxTracks, kPyramidLevels);
+    tracker.SetWorkerCount(static_cast<int>(state.range(0)));
+    tracker.SetForwardBackwardCheck(state.range(1) != 0);
+    size_t index = 0;
+    for (auto _ : state) {
+        const FramePipeline::Packet& frame = inputs.frames[index];
+        tracker.Update(frame.image.data(), frame.y_width, frame.y_height);
+        index = (index + 1) % inputs.frames.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// Arg: flow worker threads besides the caller.
+BENCHMARK(BM_OpticalFlow_Update)->Args({0, 0})->Args({1, 0})->Args({3, 0})->Args({0, 1});
+
+void BM_DepthPreprocessor_Process(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    const bool visualization = state.range(0) != 0;
+    DepthPreprocessor preprocessor;
+    size_t index = 0;
+    for (auto _ : state) {
+        preprocessor.Process(ToDepthFrame(inputs.frames[index]), visualization);
+        index = (index + 1) % inputs.frames.size();
+    }
+    const FramePipeline::Packet& frame = inputs.frames[0];
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.depth.size()) * sizeof(uint16_t));
+}
+BENCHMARK(BM_DepthPreprocessor_Process)->Arg(0)->Arg(1);
+
+// Steady-state fusion: the map is warmed up over every input frame first.
+void BM_DepthMapper_Update(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    DepthMapper mapper;
+    mapper.SetFusionMode(static_cast<DepthMapper::FusionMode>(state.range(0)));
+    for (size_t i = 0; i < inputs.frames.size(); ++i) {
+        mapper.Update(*inputs.depth[i], inputs.rays, inputs.frames[i].world_from_camera);
+    }
+    size_t index = 0;
+    int64_t points = 0;
+    for (auto _ : state) {
+        mapper.Update(*inputs.depth[index], inputs.rays, inputs.frames[index].world_from_camera);
+        points += mapper.GetStats().points_fused_last_frame;
+        index = (index + 1) % inputs.frames.size();
+    }
+    state.SetItemsProcessed(points);
+    state.counters["voxels"] = mapper.GetStats().voxels_used;
+}
+BENCHMARK(BM_DepthMapper_Update)
+    ->Arg(static_cast<int>(DepthMapper::FusionMode::OCCUPANCY))
+    ->Arg(static_cast<int>(DepthMapper::FusionMode::TSDF))
+    ->Unit(benchmark::kMicrosecond);
+
+// What the pipeline pulls after each fused frame: patched render points in
+// occupancy mode, re-meshed dirty blocks in TSDF mode. The untimed fusion
+// dwarfs the timed part, so the iteration count is fixed.
+void BM_DepthMapper_RenderOutput(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    const auto mode = static_cast<DepthMapper::FusionMode>(state.range(0));
+    DepthMapper mapper;
+    mapper.SetFusionMode(mode);
+    std::vector<SlotRange> changed;
+    size_t index = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        mapper.Update(*inputs.depth[index], inputs.rays, inputs.frames[index].world_from_camera);
+        index = (index + 1) % inputs.frames.size();
+        state.ResumeTiming();
+
+        int count = 0;
+        bool dirty = false;
+        if (mode == DepthMapper::FusionMode::TSDF) {
+            benchmark::DoNotOptimize(mapper.GetMeshVertices(&count, &dirty, &changed));
+        } else {
+            benchmark::DoNotOptimize(mapper.GetRenderPoints(&count, &dirty, &changed));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DepthMapper_RenderOutput)
+    ->Arg(static_cast<int>(DepthMapper::FusionMode::OCCUPANCY))
+    ->Arg(static_cast<int>(DepthMapper::FusionMode::TSDF))
+    ->Iterations(kFrameCount * 16)
+    ->Unit(benchmark::kMicrosecond);
+
+// Fills map with map_size random metric landmarks and returns one frame of
+// observations: half re-observe known landmarks, half are new.
+std::vector<LandmarkMap::Observation> SeedLandmarkMap(LandmarkMap* map, int map_size, int observation_count) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(-4.0f, 4.0f);
+    LandmarkMap::Observation seed;
+    seed.confidence = 0.8f;
+    seed.has_metric_depth = true;
+
+    std::vector<float> existing(static_cast<size_t>(map_size) * 3);
+    for (int i = 0; i < map_size; ++i) {
+        float* p = &existing[static_cast<size_t>(i) * 3];
+        p[0] = coord(rng);
+        p[1] = coord(rng);
+        p[2] = coord(rng);
+        map->AddMetricObservation(p, seed.bearing, seed.confidence);
+    }
+    std::vector<LandmarkMap::Observation> observations(static_cast<size_t>(observation_count), seed);
+    for (int i = 0; i < observation_count; ++i) {
+        float* p = observations[static_cast<size_t>(i)].world_pos;
+        if ((i & 1) && map_size > 0) {
+            const float* q = &existing[static_cast<size_t>(rng() % map_size) * 3];
+            p[0] = q[0] + 0.005f;
+            p[1] = q[1];
+            p[2] = q[2];
+        } else {
+            p[0] = coord(rng);
+            p[1] = coord(rng);
+            p[2] = coord(rng);
+        }
+    }
+    return observations;
+}
+
+// One frame's worth of metric observations against a map already holding
+// range(0) landmarks, one call per observation.
+void BM_LandmarkMap_AddMetricObservation(benchmark::State& state) {
+    constexpr int kObservations = 400;
+    LandmarkMap map(FramePipeline::kMaxLandmarks);
+    const std::vector<LandmarkMap::Observation> observations =
+        SeedLandmarkMap(&map, static_cast<int>(state.range(0)), kObservations);
+
+    for (auto _ : state) {
+        map.BeginFrame();
+        for (const LandmarkMap::Observation& observation : observations) {
+            map.AddMetricObservation(observation.world_pos, observation.bearing, observation.confidence);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kObservations);
+    state.counters["landmarks"] = map.GetPointCount();
+}
+BENCHMARK(BM_LandmarkMap_AddMetricObservation)
+    ->Arg(0)->Arg(1000)->Arg(5000)->Arg(FramePipeline::kMaxLandmarks)
+    ->Unit(benchmark::kMicrosecond);
+
+// Same frame through the batched association the pipeline uses.
+void BM_LandmarkMap_AddObservations(benchmark::State& state) {
+    constexpr int kObservations = 400;
+    LandmarkMap map(FramePipeline::kMaxLandmarks);
+    const std::vector<LandmarkMap::Observation> observations =
+        SeedLandmarkMap(&map, static_cast<int>(state.range(0)), kObservations);
+    std::vector<int> landmark_ids(kObservations);
+
+    for (auto _ : state) {
+        map.BeginFrame();
+        map.AddObservations(observations.data(), kObservations, landmark_ids.data());
+        benchmark::DoNotOptimize(landmark_ids.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kObservations);
+    state.counters["landmarks"] = map.GetPointCount();
+}
+BENCHMARK(BM_LandmarkMap_AddObservations)
+    ->Arg(0)->Arg(1000)->Arg(5000)->Arg(FramePipeline::kMaxLandmarks)
+    ->Unit(benchmark::kMicrosecond);
+
+// Same frame from continuing tracks, which update their landmarks directly.
+void BM_LandmarkMap_AddTrackedObservations(benchmark::State& state) {
+    constexpr int kObservations = 400;
+    LandmarkMap map(FramePipeline::kMaxLandmarks);
+    std::vector<LandmarkMap::Observation> observations =
+        SeedLandmarkMap(&map, static_cast<int>(state.range(0)), kObservations);
+    for (int i = 0; i < kObservations; ++i) {
+        observations[static_cast<size_t>(i)].track_id = static_cast<uint32_t>(i + 1);
+    }
+    std::vector<int> landmark_ids(kObservations);
+
+    for (auto _ : state) {
+        map.BeginFrame();
+        map.AddObservations(observations.data(), kObservations, landmark_ids.data());
+        benchmark::DoNotOptimize(landmark_ids.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kObservations);
+    state.counters["landmarks"] = map.GetPointCount();
+}
+BENCHMARK(BM_LandmarkMap_AddTrackedObservations)
+    ->Arg(0)->Arg(1000)->Arg(5000)->Arg(FramePipeline::kMaxLandmarks)
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_PersistentPointMap_AddPoints(benchmark::State& state) {
+    const int count = static_cast<int>(state.range(0));
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> coord(-3.0f, 3.0f);
+    std::vector<float> points(static_cast<size_t>(count) * 4);
+    for (int i = 0; i < count; ++i) {
+        points[i * 4 + 0] = coord(rng);
+        points[i * 4 + 1] = coord(rng);
+        points[i * 4 + 2] = coord(rng);
+        points[i * 4 + 3] = 0.9f;
+    }
+    const float* pose = GetInputs().frames[0].world_from_camera;
+    PersistentPointMap map;
+    for (auto _ : state) {
+        map.AddPoints(pose, points.data(), count);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    // Repeats of the same cloud merge into existing voxels.
+    state.counters["points"] = map.GetPointCount();
+}
+BENCHMARK(BM_PersistentPointMap_AddPoints)->Arg(256)->Arg(4096)->Arg(65536);
+
+void BM_DepthMeshBuilder_Update(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    DepthMeshBuilder builder;
+    builder.Initialize(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    size_t index = 0;
+    for (auto _ : state) {
+        builder.Update(*inputs.depth[index], inputs.rays, inputs.frames[index].world_from_camera, 0.2f, 6.0f);
+        index = (index + 1) % inputs.frames.size();
+    }
+    state.SetItemsProcessed(state.iterations() * builder.GetVertexCount());
+}
+BENCHMARK(BM_DepthMeshBuilder_Update)->Args({160, 120})->Args({80, 60});
+
+// Jittered circles, close to the shape of ARCore plane boundaries.
+void BM_PolygonTriangulator_Triangulate(benchmark::State& state) {
+    const int vertex_count = static_cast<int>(state.range(0));
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> jitter(0.8f, 1.2f);
+    std::vector<float> polygon(static_cast<size_t>(vertex_count) * 2);
+    for (int i = 0; i < vertex_count; ++i) {
+        const float angle = 6.2831853f * static_cast<float>(i) / static_cast<float>(vertex_count);
+        const float radius = jitter(rng);
+        polygon[i * 2 + 0] = radius * std::cos(angle);
+        polygon[i * 2 + 1] = radius * std::sin(angle);
+    }
+    std::vector<uint16_t> indices(static_cast<size_t>(vertex_count - 2) * 3);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(PolygonTriangulator::Triangulate(polygon.data(), vertex_count, 0,
+                                                                  indices.data(),
+                                                                  static_cast<int>(indices.size())));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PolygonTriangulator_Triangulate)->Arg(8)->Arg(32)->Arg(PolygonTriangulator::kMaxVertices);
+
+// Everything the worker does for one packet, for context.
+void BM_FramePipeline_Process(benchmark::State& state) {
+    const Inputs& inputs = GetInputs();
+    FramePipeline pipeline(160, 120, false);
+    size_t index = 0;
+    for (auto _ : state) {
+        FramePipeline::Packet& packet = pipeline.GetPacket();
+        state.PauseTiming();
+        packet = inputs.frames[index];
+        index = (index + 1) % inputs.frames.size();
+        state.ResumeTiming();
+        pipeline.SubmitPacket();
+        benchmark::DoNotOptimize(pipeline.AcquireResult());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FramePipeline_Process)->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_MAIN();
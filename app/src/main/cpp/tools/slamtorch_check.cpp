@@ -0,0 +1,180 @@
+// Host checks of the vectorized kernels against their scalar paths, and of
+// the pooled tracker against the serial one; run by ctest. Exits non-zero on
+// the first failure.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "OpticalFlowKernels.h"
+#include "OpticalFlowTracker.h"
+
+namespace {
+// Whether the vectorized and per-pixel LK mismatch sums agree on a textured
+// window interpolated with the given Q14 weights.
+bool CheckMismatchPaths(int w00, int w01, int w10, int w11) {
+    constexpr int kSize = 16;
+    uint8_t templ[kSize * kSize];
+    uint8_t image[kSize * kSize];
+    int16_t gradient[2 * kSize * kSize];
+    uint32_t state = 1;
+    const auto next = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 16;
+    };
+    for (int i = 0; i < kSize * kSize; ++i) {
+        templ[i] = static_cast<uint8_t>(next());
+        image[i] = static_cast<uint8_t>(next());
+        // Scharr responses span +-16 * 255.
+        gradient[2 * i] = static_cast<int16_t>(static_cast<int>(next() % 8161) - 4080);
+        gradient[2 * i + 1] = static_cast<int16_t>(static_cast<int>(next() % 8161) - 4080);
+    }
+
+    OpticalFlowKernels::Patch patch;
+    OpticalFlowKernels::BuildPatch(templ, gradient, kSize, kSize, 6.5f, 6.5f, &patch);
+    OpticalFlowKernels::BilinearWeights wt;
+    wt.w00 = static_cast<int16_t>(w00);
+    wt.w01 = static_cast<int16_t>(w01);
+    wt.w10 = static_cast<int16_t>(w10);
+    wt.w11 = static_cast<int16_t>(w11);
+    // The window's padded rows fit, so AccumulateMismatchAt vectorizes.
+    int vector_bx = 0;
+    int vector_by = 0;
+    int scalar_bx = 0;
+    int scalar_by = 0;
+    OpticalFlowKernels::AccumulateMismatchAt(image, kSize, kSize, patch, 4, 4, wt, &vector_bx, &vector_by);
+    OpticalFlowKernels::AccumulateMismatchScalar(image, kSize, kSize, patch, 4, 4, wt, &scalar_bx, &scalar_by);
+    return vector_bx == scalar_bx && vector_by == scalar_by;
+}
+
+// Whether the Q14 bilinear weights for fraction (fx, fy) are all
+// non-negative, sum to one and pass CheckMismatchPaths.
+bool CheckBilinearWeights(float fx, float fy) {
+    const OpticalFlowKernels::BilinearWeights wt = OpticalFlowKernels::MakeWeights(fx, fy);
+    if (wt.w00 < 0 || wt.w01 < 0 || wt.w10 < 0 || wt.w11 < 0) return false;
+    if (wt.w00 + wt.w01 + wt.w10 + wt.w11 != (1 << OpticalFlowKernels::kWeightBits)) return false;
+    return CheckMismatchPaths(wt.w00, wt.w01, wt.w10, wt.w11);
+}
+
+bool CheckLucasKanadeKernels() {
+    // What the old weight rounding produced for fx = 0, fy = 0.5 / 16384.
+    if (!CheckMismatchPaths(16383, 0, 2, -1)) {
+        fprintf(stderr, "LK mismatch paths disagree for w11 = -1\n");
+        return false;
+    }
+    if (!CheckMismatchPaths(1 << 14, 0, 0, 0) ||
+        !CheckMismatchPaths(0, 0, 0, 1 << 14) ||
+        !CheckMismatchPaths(1 << 12, 1 << 12, 1 << 12, 1 << 12)) {
+        fprintf(stderr, "LK mismatch paths disagree for corner weights\n");
+        return false;
+    }
+
+    // Fractions on a half-step of the Q14 grid round w11 the worst way.
+    constexpr int kOne = 1 << 14;
+    for (int i = 0; i < kOne; ++i) {
+        const float f = (static_cast<float>(i) + 0.5f) / static_cast<float>(kOne);
+        const float g = 1.0f - f;
+        if (!CheckBilinearWeights(0.0f, f) ||
+            !CheckBilinearWeights(f, 0.0f) ||
+            !CheckBilinearWeights(f, f) ||
+            !CheckBilinearWeights(g, f)) {
+            fprintf(stderr, "bad bilinear weights at fraction %.9g\n", f);
+            return false;
+        }
+    }
+    uint32_t state = 7;
+    for (int i = 0; i < 100000; ++i) {
+        state = state * 1664525u + 1013904223u;
+        const float fx = static_cast<float>(state >> 8) / static_cast<float>(1 << 24);
+        state = state * 1664525u + 1013904223u;
+        const float fy = static_cast<float>(state >> 8) / static_cast<float>(1 << 24);
+        if (!CheckBilinearWeights(fx, fy)) {
+            fprintf(stderr, "bad bilinear weights at (%.9g, %.9g)\n", fx, fy);
+            return false;
+        }
+    }
+    return true;
+}
+
+// A textured plane drifting by a fractional step per frame, so LK has
+// sub-pixel work at every level.
+void MakeFlowFrame(int index, int w, int h, std::vector<uint8_t>* image) {
+    image->resize(static_cast<size_t>(w) * h);
+    const float shift_x = 1.7f * static_cast<float>(index);
+    const float shift_y = 0.6f * static_cast<float>(index);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const float u = static_cast<float>(x) + shift_x;
+            const float v = static_cast<float>(y) + shift_y;
+            const float texture = 60.0f * std::sin(u * 0.13f) * std::cos(v * 0.11f) +
+                                  30.0f * std::sin((u + v) * 0.047f);
+            const int checker = (static_cast<int>(u / 16.0f) + static_cast<int>(v / 16.0f)) & 1;
+            (*image)[static_cast<size_t>(y) * w + x] = static_cast<uint8_t>(120.0f + texture + 40.0f * checker);
+        }
+    }
+}
+
+bool SameTrack(const OpticalFlowTracker::Track& a, const OpticalFlowTracker::Track& b) {
+    // Field by field, since the struct's padding bytes are unspecified.
+    return memcmp(&a.x, &b.x, sizeof(a.x)) == 0 &&
+           memcmp(&a.y, &b.y, sizeof(a.y)) == 0 &&
+           memcmp(&a.prev_x, &b.prev_x, sizeof(a.prev_x)) == 0 &&
+           memcmp(&a.prev_y, &b.prev_y, sizeof(a.prev_y)) == 0 &&
+           memcmp(&a.error, &b.error, sizeof(a.error)) == 0 &&
+           memcmp(&a.quality, &b.quality, sizeof(a.quality)) == 0 &&
+           a.age == b.age && a.stable_count == b.stable_count &&
+           a.active == b.active && a.id == b.id;
+}
+
+// Whether tracking on worker threads gives bit-identical tracks to tracking
+// serially, frame by frame, with and without the forward-backward check.
+bool CheckPooledTracking() {
+    constexpr int kWidth = 320;
+    constexpr int kHeight = 240;
+    constexpr int kFrames = 12;
+    constexpr int kWorkers = 3;
+    std::vector<uint8_t> image;
+    for (int forward_backward = 0; forward_backward < 2; ++forward_backward) {
+        OpticalFlowTracker serial(300, 3);
+        OpticalFlowTracker pooled(300, 3);
+        serial.SetWorkerCount(0);
+        pooled.SetWorkerCount(kWorkers);
+        serial.SetForwardBackwardCheck(forward_backward != 0);
+        pooled.SetForwardBackwardCheck(forward_backward != 0);
+        int tracked = 0;
+        for (int frame = 0; frame < kFrames; ++frame) {
+            MakeFlowFrame(frame, kWidth, kHeight, &image);
+            const bool serial_ok = serial.Update(image.data(), kWidth, kHeight);
+            const bool pooled_ok = pooled.Update(image.data(), kWidth, kHeight);
+            if (serial_ok != pooled_ok || serial.GetTrackCount() != pooled.GetTrackCount()) {
+                fprintf(stderr, "pooled tracker diverged at frame %d\n", frame);
+                return false;
+            }
+            for (int i = 0; i < serial.GetTrackCount(); ++i) {
+                if (!SameTrack(serial.GetTracks()[i], pooled.GetTracks()[i])) {
+                    fprintf(stderr, "pooled track %d differs at frame %d\n", i, frame);
+                    return false;
+                }
+                if (frame > 0 && serial.GetTracks()[i].active && serial.GetTracks()[i].age > 0) {
+                    tracked++;
+                }
+            }
+        }
+        // Guards against a scene that silently stops exercising LK.
+        if (tracked == 0) {
+            fprintf(stderr, "no features tracked on the synthetic frames\n");
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main() {
+    if (!CheckLucasKanadeKernels()) return 1;
+    if (!CheckPooledTracking()) return 1;
+    printf("slamtorch_check: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Replays a recorded session through the SLAM core and prints a summary.
+//
+//   slamtorch_replay <session> [--frames N] [--repeat N] [--occupancy | --tsdf]
+//                    [--no-map] [--depth-mesh] [--trace FILE] [--verbose]
+//
+// Mode flags override the settings recorded with each frame. With --repeat,
+// every run must produce the same checksum or the tool fails. Per-stage
+// timings are printed for the last run, and --trace writes them as Chrome
+// trace JSON.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "FrameProfiler.h"
+#include "Log.h"
+#include "SessionRecording.h"
+#include "SessionReplay.h"
+
+namespace {
+void QuietSink(LogLevel level, const char* message) {
+    if (level >= LogLevel::WARN) {
+        fprintf(stderr, "%s\n", message);
+    }
+}
+
+int Usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s <session> [--frames N] [--repeat N] [--occupancy | --tsdf]\n"
+            "       [--no-map] [--depth-mesh] [--trace FILE] [--verbose]\n",
+            program);
+    return 2;
+}
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) return Usage(argv[0]);
+
+    std::string path;
+    SessionReplay::Options options;
+    int repeat = 1;
+    bool verbose = false;
+    std::string trace_path;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--frames") == 0 && i + 1 < argc) {
+            options.max_frames = atoi(argv[++i]);
+        } else if (strcmp(arg, "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(arg, "--occupancy") == 0) {
+            options.override_settings = true;
+            options.settings.fusion_mode = DepthMapper::FusionMode::OCCUPANCY;
+        } else if (strcmp(arg, "--tsdf") == 0) {
+            options.override_settings = true;
+            options.settings.fusion_mode = DepthMapper::FusionMode::TSDF;
+        } else if (strcmp(arg, "--no-map") == 0) {
+            options.override_settings = true;
+            options.settings.map_enabled = false;
+        } else if (strcmp(arg, "--depth-mesh") == 0) {
+            options.override_settings = true;
+            options.settings.depth_mesh_enabled = true;
+        } else if (strcmp(arg, "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(arg, "--verbose") == 0) {
+            verbose = true;
+        } else if (arg[0] == '-' || !path.empty()) {
+            return Usage(argv[0]);
+        } else {
+            path = arg;
+        }
+    }
+    if (path.empty() || repeat < 1) return Usage(argv[0]);
+    if (!verbose) {
+        SetLogSink(QuietSink);
+    }
+
+    SessionReader reader;
+    if (!reader.Open(path)) {
+        fprintf(stderr, "cannot read session %s\n", path.c_str());
+        return 1;
+    }
+
+    uint64_t first_checksum = 0;
+    for (int run = 0; run < repeat; ++run) {
+        // Each run starts with an empty profiler so only the last one is kept.
+        FrameProfiler profiler;
+        profiler.NameCurrentThread("replay");
+        options.profiler = &profiler;
+        SessionReplay replay(options);
+        const SessionReplay::Summary summary = replay.Run(&reader);
+        const double fps = summary.seconds > 0.0 ? summary.frames / summary.seconds : 0.0;
+        printf("run %d: %d frames in %.3f s (%.1f fps, session %.1f s)\n",
+               run, summary.frames, summary.seconds, fps, summary.session_seconds);
+        printf("  features %d, landmarks %d (%d metric)\n",
+               summary.feature_count, summary.landmark_count, summary.metric_landmarks);
+        printf("  voxels %d, points fused %" PRId64 ", map points %d, mesh vertices %d\n",
+               summary.voxels_used, summary.total_points_fused,
+               summary.map_point_count, summary.map_mesh_vertex_count);
+        printf("  persistent points %d, checksum %016" PRIx64 "\n",
+               summary.persistent_points, summary.checksum);
+        if (summary.frames_failed > 0) {
+            printf("  %d frames failed to read\n", summary.frames_failed);
+        }
+
+        if (run == repeat - 1) {
+            FrameProfiler::StageStats stages[FrameProfiler::kStageCount];
+            profiler.ComputeStats(FrameProfiler::NowNs(), stages);
+            printf("  stage p50/p95/p99 ms (last %d events):\n", FrameProfiler::kCapacity);
+            for (int i = 0; i < FrameProfiler::kStageCount; ++i) {
+                if (stages[i].count == 0) continue;
+                printf("    %-16s %7.3f %7.3f %7.3f\n", FrameProfiler::GetStageName(static_cast<ProfileStage>(i)),
+                       stages[i].p50_ms, stages[i].p95_ms, stages[i].p99_ms);
+            }
+            if (!trace_path.empty() && !profiler.ExportChromeTrace(trace_path)) {
+                fprintf(stderr, "cannot write trace %s\n", trace_path.c_str());
+                return 1;
+            }
+        }
+
+        if (run == 0) {
+            first_checksum = summary.checksum;
+        } else if (summary.checksum != first_checksum) {
+            fprintf(stderr, "run %d diverged from run 0\n", run);
+            return 1;
+        }
+    }
+    return 0;
+}
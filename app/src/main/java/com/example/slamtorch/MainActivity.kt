@@ -10,6 +10,7 @@ import android.view.Surface
 import android.view.View
 import android.view.ViewGroup
 import android.widget.TextView
+import android.widget.Toast
 import androidx.core.content.getSystemService
 import androidx.core.app.ActivityCompat
 import androidx.core.content.ContextCompat
@@ -17,6 +18,7 @@ import android.hardware.display.DisplayManager
 import com.google.android.material.button.MaterialButton
 import com.google.android.material.button.MaterialButtonToggleGroup
 import com.google.androidgamesdk.GameActivity
+import java.io.File
 
 class MainActivity : GameActivity() {
     private lateinit var torchController: TorchController
@@ -27,8 +29,10 @@ class MainActivity : GameActivity() {
     private lateinit var torchToggleGroup: MaterialButtonToggleGroup
     private lateinit var depthMeshToggleGroup: MaterialButtonToggleGroup
     private lateinit var mapToggleButton: MaterialButton
+    private lateinit var mapTsdfToggleButton: MaterialButton
     private lateinit var planeToggleButton: MaterialButton
     private lateinit var wireframeToggleButton: MaterialButton
+    private lateinit var recordToggleButton: MaterialButton
     private var debugEnabled = true
     private var uiCreated = false
     private val uiHandler = Handler(Looper.getMainLooper())
@@ -39,11 +43,14 @@ class MainActivity : GameActivity() {
     private external fun nativeClearMap()
     private external fun nativeSetTorchMode(mode: Int)
     private external fun nativeSetMapEnabled(enabled: Boolean)
+    private external fun nativeSetMapTsdfEnabled(enabled: Boolean)
     private external fun nativeSetDebugEnabled(enabled: Boolean)
     private external fun nativeSetPlanesEnabled(enabled: Boolean)
     private external fun nativeSetDepthMeshMode(mode: Int)
     private external fun nativeSetWireframeEnabled(enabled: Boolean)
     private external fun nativeClearDepthMesh()
+    private external fun nativeSetRecording(path: String?)
+    private external fun nativeExportTrace(path: String): Boolean
     private external fun nativeGetDebugStats(): DebugStats
 
     companion object {
@@ -90,7 +97,8 @@ class MainActivity : GameActivity() {
         val depthMeshWireframe: Boolean,
         val depthMeshWidth: Int,
         val depthMeshHeight: Int,
-        val depthMeshValidRatio: Float
+        val depthMeshValidRatio: Float,
+        val stageTimings: String
     )
 
     override fun onCreate(savedInstanceState: Bundle?) {
@@ -136,8 +144,10 @@ class MainActivity : GameActivity() {
         torchToggleGroup = overlay.findViewById(R.id.torchToggleGroup)
         depthMeshToggleGroup = overlay.findViewById(R.id.depthMeshToggleGroup)
         mapToggleButton = overlay.findViewById(R.id.mapToggleButton)
+        mapTsdfToggleButton = overlay.findViewById(R.id.mapTsdfToggleButton)
         planeToggleButton = overlay.findViewById(R.id.planeToggleButton)
         wireframeToggleButton = overlay.findViewById(R.id.wireframeToggleButton)
+        recordToggleButton = overlay.findViewById(R.id.recordToggleButton)
         
         debugToggleButton.setOnClickListener {
             debugEnabled = debugToggleButton.isChecked
@@ -145,6 +155,14 @@ class MainActivity : GameActivity() {
             nativeSetDebugEnabled(debugEnabled)
             if (debugEnabled) startDebugUpdates()
         }
+        // Long press dumps the recent stage timings for chrome://tracing or Perfetto.
+        debugToggleButton.setOnLongClickListener {
+            val dir = getExternalFilesDir(null) ?: filesDir
+            val trace = File(dir, "trace-${System.currentTimeMillis()}.json")
+            val message = if (nativeExportTrace(trace.absolutePath)) "Trace saved: ${trace.name}" else "Trace export failed"
+            Toast.makeText(this, message, Toast.LENGTH_SHORT).show()
+            true
+        }
         debugToggleButton.isChecked = true
         debugOverlay.visibility = View.VISIBLE
         nativeSetDebugEnabled(true)
@@ -157,6 +175,11 @@ class MainActivity : GameActivity() {
             nativeSetMapEnabled(enabled)
             mapToggleButton.text = if (enabled) "Map ON" else "Map OFF"
         }
+        mapTsdfToggleButton.setOnClickListener {
+            val enabled = mapTsdfToggleButton.isChecked
+            nativeSetMapTsdfEnabled(enabled)
+            mapTsdfToggleButton.text = if (enabled) "TSDF ON" else "TSDF OFF"
+        }
 
         torchToggleGroup.addOnButtonCheckedListener { _, checkedId, isChecked ->
             if (!isChecked) return@addOnButtonCheckedListener
@@ -179,6 +202,8 @@ class MainActivity : GameActivity() {
         nativeSetDepthMeshMode(DEPTH_MODE_OFF)
         mapToggleButton.isChecked = true
         mapToggleButton.text = "Map ON"
+        mapTsdfToggleButton.isChecked = false
+        nativeSetMapTsdfEnabled(false)
 
         planeToggleButton.setOnClickListener {
             val enabled = planeToggleButton.isChecked
@@ -195,6 +220,20 @@ class MainActivity : GameActivity() {
         }
         wireframeToggleButton.isChecked = false
         nativeSetWireframeEnabled(false)
+
+        // Sessions land in app-specific external storage for adb pull and
+        // offline replay with slamtorch_replay.
+        recordToggleButton.setOnClickListener {
+            val enabled = recordToggleButton.isChecked
+            if (enabled) {
+                val dir = getExternalFilesDir(null) ?: filesDir
+                nativeSetRecording(File(dir, "session-${System.currentTimeMillis()}.stsession").absolutePath)
+            } else {
+                nativeSetRecording(null)
+            }
+            recordToggleButton.text = if (enabled) "REC ON" else "REC OFF"
+        }
+        recordToggleButton.isChecked = false
         if (!torchController.isTorchAvailable()) {
             torchToggleGroup.isEnabled = false
             overlay.findViewById<View>(R.id.torchAutoButton).isEnabled = false
@@ -246,7 +285,8 @@ class MainActivity : GameActivity() {
                             FPS: ${"%.1f".format(stats.fps)}
                             Torch: $torchState
                             Map: ${if (stats.mapEnabled) "ON" else "OFF"} / Overlay: ${if (stats.depthOverlayEnabled) "ON" else "OFF"}
-                        """.trimIndent()
+                            Stage p50/p95/p99:
+                        """.trimIndent() + "\n" + stats.stageTimings
                     } catch (e: Exception) {
                         debugOverlay.text = "Stats unavailable"
                     }